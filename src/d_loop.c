@@ -29,6 +29,7 @@
 
 #include "m_argv.h"
 #include "m_fixed.h"
+#include "m_profile.h"
 
 #include "net_client.h"
 #include "net_gui.h"
@@ -213,6 +214,8 @@ void NetUpdate (void)
     if (singletics)
         return;
 
+    M_ProfileStart(PROFILE_NET);
+
     // Run network subsystems
 
     NET_CL_Run();
@@ -244,6 +247,8 @@ void NetUpdate (void)
             break;
         }
     }
+
+    M_ProfileStop(PROFILE_NET);
 }
 
 static void D_Disconnected(void)
@@ -835,12 +840,18 @@ boolean D_NonVanillaRecord(boolean conditional, const char *feature)
 }
 
 // Returns true if the given lump number corresponds to data from a .lmp
-// file, as opposed to a WAD.
+// file, as opposed to a WAD.  A lump number of -1 indicates a demo that
+// was read directly from a .lmp file without being added as a lump.
 static boolean IsDemoFile(int lumpnum)
 {
     char *lower;
     boolean result;
 
+    if (lumpnum < 0)
+    {
+        return true;
+    }
+
     lower = M_StringDuplicate(lumpinfo[lumpnum]->wad_file->path);
     M_ForceLowercase(lower);
     result = M_StringEndsWith(lower, ".lmp");
@@ -0,0 +1,556 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Headless batch demo verification.  The IWAD/PWADs are loaded
+//     and the renderer initialized once, then each demo in a list
+//     file is played back to completion with no screen output.  One
+//     line of results is written per demo.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(__vita__)
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define HAVE_BATCH_WORKERS
+#endif
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "d_loop.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "sha1.h"
+#include "z_zone.h"
+
+#include "g_game.h"
+#include "p_local.h"
+
+#include "batchdemo.h"
+
+extern boolean advancedemo;
+extern int prndindex;
+
+// Ticcmds passed to G_Ticker.  Demo playback overwrites these with the
+// commands read from the demo, so they are never filled in.
+
+static ticcmd_t batch_netcmds[MAXPLAYERS];
+
+// Demos to be played back, read from the list file.
+
+static char **demo_list = NULL;
+static int num_demos = 0;
+static int next_demo = 0;
+
+// Build a SHA1 digest of the parts of the game state that a desync
+// would disturb: the RNG, the players and every map object.
+
+static void HashGameState(sha1_digest_t digest)
+{
+    sha1_context_t context;
+    thinker_t *th;
+    mobj_t *mo;
+    player_t *player;
+    int i;
+
+    SHA1_Init(&context);
+
+    SHA1_UpdateInt32(&context, gameepisode);
+    SHA1_UpdateInt32(&context, gamemap);
+    SHA1_UpdateInt32(&context, gamestate);
+    SHA1_UpdateInt32(&context, leveltime);
+    SHA1_UpdateInt32(&context, prndindex);
+
+    for (i = 0; i < MAXPLAYERS; ++i)
+    {
+        if (!playeringame[i])
+        {
+            continue;
+        }
+
+        player = &players[i];
+
+        SHA1_UpdateInt32(&context, player->playerstate);
+        SHA1_UpdateInt32(&context, player->health);
+        SHA1_UpdateInt32(&context, player->armorpoints);
+        SHA1_UpdateInt32(&context, player->readyweapon);
+        SHA1_UpdateInt32(&context, player->killcount);
+        SHA1_UpdateInt32(&context, player->itemcount);
+        SHA1_UpdateInt32(&context, player->secretcount);
+    }
+
+    if (gamestate == GS_LEVEL)
+    {
+        for (th = thinkercap.next; th != &thinkercap; th = th->next)
+        {
+            if (th->function.acp1 != (actionf_p1) P_MobjThinker)
+            {
+                continue;
+            }
+
+            mo = (mobj_t *) th;
+
+            SHA1_UpdateInt32(&context, mo->type);
+            SHA1_UpdateInt32(&context, mo->x);
+            SHA1_UpdateInt32(&context, mo->y);
+            SHA1_UpdateInt32(&context, mo->z);
+            SHA1_UpdateInt32(&context, mo->angle);
+            SHA1_UpdateInt32(&context, mo->momx);
+            SHA1_UpdateInt32(&context, mo->momy);
+            SHA1_UpdateInt32(&context, mo->momz);
+            SHA1_UpdateInt32(&context, mo->health);
+            SHA1_UpdateInt32(&context, mo->flags);
+        }
+    }
+
+    SHA1_Final(digest, &context);
+}
+
+// Play back a single demo and write a line of results for it.
+
+static void PlayBatchDemo(FILE *results, const char *filename)
+{
+    sha1_digest_t digest;
+    byte *buffer;
+    int starttime, endtime;
+    int tics;
+    int i;
+
+    if (!M_FileExists(filename))
+    {
+        fprintf(results, "%s\tmissing\t0\t0\t-\n", filename);
+        fflush(results);
+        return;
+    }
+
+    starttime = I_GetTimeMS();
+
+    M_ReadFile(filename, &buffer);
+
+    advancedemo = false;
+
+    if (!G_PlayDemoBuffer(buffer))
+    {
+        Z_Free(buffer);
+        fprintf(results, "%s\tbadversion\t0\t0\t-\n", filename);
+        fflush(results);
+        return;
+    }
+
+    // Run the simulation until the end of the demo is reached.  This is
+    // the same sequence that TryRunTics() follows when -timedemo is
+    // used, minus the menus and input events.
+
+    tics = 0;
+
+    while (demoplayback)
+    {
+        netcmds = batch_netcmds;
+        G_Ticker();
+        ++gametic;
+        ++tics;
+    }
+
+    endtime = I_GetTimeMS();
+
+    HashGameState(digest);
+
+    fprintf(results, "%s\tok\t%i\t%i\t", filename, tics, endtime - starttime);
+
+    for (i = 0; i < sizeof(sha1_digest_t); ++i)
+    {
+        fprintf(results, "%02x", digest[i]);
+    }
+
+    fprintf(results, "\n");
+    fflush(results);
+
+    Z_Free(buffer);
+}
+
+// Strip leading and trailing whitespace from a line read from a file.
+
+static char *StripLine(char *line)
+{
+    int len;
+
+    len = strlen(line);
+
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'
+                    || line[len - 1] == ' ' || line[len - 1] == '\t'))
+    {
+        line[--len] = '\0';
+    }
+
+    while (*line == ' ' || *line == '\t')
+    {
+        ++line;
+    }
+
+    return line;
+}
+
+// Read the list of demos to play back, skipping blank lines and
+// comments.
+
+static void ReadDemoList(const char *listfile)
+{
+    FILE *list;
+    char line[512];
+    char *filename;
+
+    list = fopen(listfile, "r");
+
+    if (list == NULL)
+    {
+        I_Error("BatchDemo: Unable to open demo list %s", listfile);
+    }
+
+    while (fgets(line, sizeof(line), list) != NULL)
+    {
+        filename = StripLine(line);
+
+        if (*filename == '\0' || *filename == '#')
+        {
+            continue;
+        }
+
+        demo_list = I_Realloc(demo_list, (num_demos + 1) * sizeof(char *));
+        demo_list[num_demos] = M_StringDuplicate(filename);
+        ++num_demos;
+    }
+
+    fclose(list);
+}
+
+#ifdef HAVE_BATCH_WORKERS
+
+// A worker process, forked after startup so that the loaded WAD
+// directory, textures and lookup tables are shared copy-on-write.
+// Demo filenames are sent down the commands pipe one at a time, and
+// each is answered with a single line on the results pipe.
+
+typedef struct
+{
+    pid_t pid;
+    FILE *commands;
+    FILE *results;
+    int demo;           // Index into demo_list, or -1 if idle
+} batch_worker_t;
+
+static batch_worker_t *workers;
+static int num_workers;
+
+static void WorkerLoop(FILE *commands, FILE *results)
+{
+    char line[512];
+
+    while (fgets(line, sizeof(line), commands) != NULL)
+    {
+        PlayBatchDemo(results, StripLine(line));
+    }
+}
+
+static void StartWorker(batch_worker_t *worker)
+{
+    int command_pipe[2], result_pipe[2];
+    int i;
+
+    if (pipe(command_pipe) != 0 || pipe(result_pipe) != 0)
+    {
+        I_Error("BatchDemo: Failed to create pipes for worker process");
+    }
+
+    // Anything still buffered would otherwise be written twice.
+
+    fflush(stdout);
+    fflush(stderr);
+
+    worker->pid = fork();
+
+    if (worker->pid < 0)
+    {
+        I_Error("BatchDemo: Failed to fork worker process");
+    }
+
+    if (worker->pid == 0)
+    {
+        // Close our copies of the pipes belonging to other workers, so
+        // that they see end-of-file when the supervisor closes them.
+
+        for (i = 0; i < num_workers; ++i)
+        {
+            if (&workers[i] != worker && workers[i].commands != NULL)
+            {
+                fclose(workers[i].commands);
+                fclose(workers[i].results);
+            }
+        }
+
+        close(command_pipe[1]);
+        close(result_pipe[0]);
+
+        WorkerLoop(fdopen(command_pipe[0], "r"), fdopen(result_pipe[1], "w"));
+
+        // Exit without running the exit functions; in particular we
+        // must not save the configuration file from every worker.
+
+        fflush(stdout);
+        _exit(0);
+    }
+
+    close(command_pipe[0]);
+    close(result_pipe[1]);
+
+    worker->commands = fdopen(command_pipe[1], "w");
+    worker->results = fdopen(result_pipe[0], "r");
+    worker->demo = -1;
+}
+
+// Give the worker the next demo from the list, or tell it to exit if
+// there are none left.
+
+static void SendNextDemo(batch_worker_t *worker)
+{
+    if (next_demo < num_demos)
+    {
+        worker->demo = next_demo;
+        ++next_demo;
+
+        fprintf(worker->commands, "%s\n", demo_list[worker->demo]);
+        fflush(worker->commands);
+    }
+    else
+    {
+        worker->demo = -1;
+
+        fclose(worker->commands);
+        fclose(worker->results);
+        worker->commands = NULL;
+        worker->results = NULL;
+
+        waitpid(worker->pid, NULL, 0);
+    }
+}
+
+static void CollectResult(FILE *results, batch_worker_t *worker)
+{
+    char line[1024];
+
+    if (fgets(line, sizeof(line), worker->results) != NULL)
+    {
+        fputs(line, results);
+        fflush(results);
+    }
+    else
+    {
+        // The worker died while playing this demo, probably because of
+        // an I_Error.  Record it and start a fresh worker in its place.
+
+        fprintf(results, "%s\tcrashed\t0\t0\t-\n",
+                demo_list[worker->demo]);
+        fflush(results);
+
+        fclose(worker->commands);
+        fclose(worker->results);
+        worker->commands = NULL;
+        worker->results = NULL;
+        waitpid(worker->pid, NULL, 0);
+
+        StartWorker(worker);
+    }
+
+    SendNextDemo(worker);
+}
+
+static void RunWorkers(FILE *results, int jobs)
+{
+    fd_set readfds;
+    int maxfd;
+    int busy;
+    int i;
+
+    // A worker dying must not kill the supervisor when it next writes
+    // to the worker's pipe; it is detected from end-of-file instead.
+
+    signal(SIGPIPE, SIG_IGN);
+
+    num_workers = jobs < num_demos ? jobs : num_demos;
+    workers = calloc(num_workers, sizeof(batch_worker_t));
+
+    for (i = 0; i < num_workers; ++i)
+    {
+        StartWorker(&workers[i]);
+    }
+
+    for (i = 0; i < num_workers; ++i)
+    {
+        SendNextDemo(&workers[i]);
+    }
+
+    printf("BatchDemo: %i worker processes started.\n", num_workers);
+
+    for (;;)
+    {
+        FD_ZERO(&readfds);
+        maxfd = -1;
+        busy = 0;
+
+        for (i = 0; i < num_workers; ++i)
+        {
+            if (workers[i].demo >= 0)
+            {
+                FD_SET(fileno(workers[i].results), &readfds);
+                ++busy;
+
+                if (fileno(workers[i].results) > maxfd)
+                {
+                    maxfd = fileno(workers[i].results);
+                }
+            }
+        }
+
+        if (busy == 0)
+        {
+            break;
+        }
+
+        if (select(maxfd + 1, &readfds, NULL, NULL, NULL) < 0)
+        {
+            continue;
+        }
+
+        for (i = 0; i < num_workers; ++i)
+        {
+            if (workers[i].demo >= 0
+             && FD_ISSET(fileno(workers[i].results), &readfds))
+            {
+                CollectResult(results, &workers[i]);
+            }
+        }
+    }
+
+    free(workers);
+}
+
+#endif // #ifdef HAVE_BATCH_WORKERS
+
+// Get the number of worker processes to use.
+
+static int BatchJobs(void)
+{
+    int jobs = 1;
+    int p;
+
+    //!
+    // @arg <n>
+    // @category demo
+    // @platform unix
+    //
+    // When used with -batchdemo, play back demos in n worker processes
+    // in parallel.  If n is zero, one worker is started per CPU.
+    //
+
+    p = M_CheckParmWithArgs("-batchjobs", 1);
+
+    if (p > 0)
+    {
+#ifdef HAVE_BATCH_WORKERS
+        jobs = atoi(myargv[p + 1]);
+
+        if (jobs <= 0)
+        {
+            jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        }
+#else
+        printf("BatchDemo: -batchjobs is not supported on this platform.\n");
+#endif
+    }
+
+    return jobs < 1 ? 1 : jobs;
+}
+
+void BatchDemo(const char *listfile)
+{
+    FILE *results;
+    int jobs;
+    int p;
+
+    ReadDemoList(listfile);
+
+    //!
+    // @arg <filename>
+    // @category demo
+    //
+    // When used with -batchdemo, write the results to the specified
+    // file instead of to stdout.
+    //
+
+    p = M_CheckParmWithArgs("-batchresults", 1);
+
+    if (p > 0 && strcmp(myargv[p + 1], "-") != 0)
+    {
+        results = fopen(myargv[p + 1], "w");
+
+        if (results == NULL)
+        {
+            I_Error("BatchDemo: Unable to open %s for writing",
+                    myargv[p + 1]);
+        }
+    }
+    else
+    {
+        results = stdout;
+    }
+
+    // Demos are never drawn, and never stop the program when they end.
+
+    nodrawers = true;
+    singledemo = false;
+    singletics = true;
+
+    jobs = BatchJobs();
+
+#ifdef HAVE_BATCH_WORKERS
+    if (jobs > 1)
+    {
+        RunWorkers(results, jobs);
+    }
+    else
+#endif
+    {
+        for (next_demo = 0; next_demo < num_demos; ++next_demo)
+        {
+            PlayBatchDemo(results, demo_list[next_demo]);
+        }
+    }
+
+    if (results != stdout)
+    {
+        fclose(results);
+    }
+
+    printf("BatchDemo: played back %i demo(s).\n", num_demos);
+
+    I_Quit();
+}
+
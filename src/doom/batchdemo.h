@@ -0,0 +1,27 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Headless batch demo verification.
+//
+
+#ifndef __BATCHDEMO__
+#define __BATCHDEMO__
+
+// Play back every demo listed in the given file, writing one line of
+// results per demo, then quit.  Never returns.
+
+void BatchDemo(const char *listfile);
+
+#endif
+
@@ -37,6 +37,7 @@
 
 #include "z_zone.h"
 #include "w_main.h"
+#include "w_prefetch.h"
 #include "w_wad.h"
 #include "s_sound.h"
 #include "v_diskicon.h"
@@ -50,6 +51,7 @@
 #include "m_controls.h"
 #include "m_misc.h"
 #include "m_menu.h"
+#include "m_profile.h"
 #include "p_saveg.h"
 
 #include "i_endoom.h"
@@ -72,6 +74,8 @@
 #include "p_setup.h"
 #include "r_local.h"
 #include "statdump.h"
+#include "batchdemo.h"
+#include "statetrace.h"
 
 
 #include "d_main.h"
@@ -432,7 +436,10 @@ void D_RunFrame()
                                , 0, 0, SCREENWIDTH, SCREENHEIGHT, tics);
         I_UpdateNoBlit ();
         M_Drawer ();                            // menu is drawn even on top of wipes
+        M_ProfileStart(PROFILE_BLIT);
         I_FinishUpdate ();                      // page flip or blit buffer
+        M_ProfileStop(PROFILE_BLIT);
+        M_ProfileFrame();
         return;
     }
 
@@ -441,7 +448,9 @@ void D_RunFrame()
 
     TryRunTics (); // will run at least one tic
 
+    M_ProfileStart(PROFILE_SOUND);
     S_UpdateSounds (players[consoleplayer].mo);// move positional sounds
+    M_ProfileStop(PROFILE_SOUND);
 
     // Update display, next frame, with current state if no profiling is on
     if (screenvisible && !nodrawers)
@@ -454,9 +463,13 @@ void D_RunFrame()
             wipestart = I_GetTime () - 1;
         } else {
             // normal update
+            M_ProfileStart(PROFILE_BLIT);
             I_FinishUpdate ();              // page flip or blit buffer
+            M_ProfileStop(PROFILE_BLIT);
         }
     }
+
+    M_ProfileFrame();
 }
 
 //
@@ -1256,6 +1269,7 @@ void D_DoomMain (void)
     char file[256];
     char demolumpname[9];
     int numiwadlumps;
+    int batchdemo;
 
     I_AtExit(D_Endoom, false);
 
@@ -1322,6 +1336,21 @@ void D_DoomMain (void)
         exit(0);
     }
 
+    //!
+    // @arg <trace1> <trace2>
+    // @category demo
+    //
+    // Compare two state traces recorded with -statetrace, and report
+    // the first tic and field at which they diverge.
+    //
+
+    p = M_CheckParmWithArgs("-statediff", 2);
+
+    if (p)
+    {
+        exit(StateTraceDiff(myargv[p + 1], myargv[p + 2]) ? 0 : 1);
+    }
+
     //!
     // @category game
     // @vanilla
@@ -1651,6 +1680,8 @@ void D_DoomMain (void)
     // Generate the WAD hash table.  Speed things up a bit.
     W_GenerateHashTable();
 
+    W_InitPrefetch();
+
     // Load DEHACKED lumps from WAD files - but only if we give the right
     // command line parameter.
 
@@ -1719,12 +1750,30 @@ void D_DoomMain (void)
     I_PrintStartupBanner(gamedescription);
     PrintDehackedBanners();
 
+    //!
+    // @arg <listfile>
+    // @category demo
+    //
+    // Play back every demo named in the given list file (one filename
+    // per line) without opening a window, writing the number of tics,
+    // wall time and a hash of the final game state for each demo.
+    // The WAD files are loaded only once for the whole batch.
+    //
+
+    batchdemo = M_CheckParmWithArgs("-batchdemo", 1);
+
     DEH_printf("I_Init: Setting up machine state.\n");
     I_CheckIsScreensaver();
     I_InitTimer();
-    I_InitJoystick();
-    I_InitSound(true);
-    I_InitMusic();
+
+    // Batch demo playback is headless; don't open any devices.
+
+    if (!batchdemo)
+    {
+        I_InitJoystick();
+        I_InitSound(true);
+        I_InitMusic();
+    }
 
     printf ("NET_Init: Init network subsystem.\n");
     NET_Init ();
@@ -1894,6 +1943,8 @@ void D_DoomMain (void)
     DEH_printf("ST_Init: Init status bar.\n");
     ST_Init ();
 
+    W_EndStartup();
+
     // If Doom II without a MAP01 lump, this is a store demo.
     // Moved this here so that MAP01 isn't constantly looked up
     // in the main loop.
@@ -1907,6 +1958,14 @@ void D_DoomMain (void)
         DEH_printf("External statistics registered.\n");
     }
 
+    StateTraceInit();
+    M_InitProfiler();
+
+    if (batchdemo)
+    {
+        BatchDemo(myargv[batchdemo + 1]);  // never returns
+    }
+
     //!
     // @arg <x>
     // @category demo
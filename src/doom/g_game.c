@@ -34,6 +34,7 @@
 #include "m_controls.h"
 #include "m_misc.h"
 #include "m_menu.h"
+#include "m_profile.h"
 #include "m_random.h"
 #include "i_system.h"
 #include "i_timer.h"
@@ -52,6 +53,7 @@
 #include "st_stuff.h"
 #include "am_map.h"
 #include "statdump.h"
+#include "statetrace.h"
 
 // Needs access to LFB.
 #include "v_video.h"
@@ -1007,7 +1009,9 @@ void G_Ticker (void)
     switch (gamestate) 
     { 
       case GS_LEVEL: 
+	M_ProfileStart(PROFILE_TICKER);
 	P_Ticker (); 
+	M_ProfileStop(PROFILE_TICKER);
 	ST_Ticker (); 
 	AM_Ticker (); 
 	HU_Ticker ();            
@@ -1025,6 +1029,8 @@ void G_Ticker (void)
 	D_PageTicker (); 
 	break;
     }        
+
+    StateTraceTic();
 } 
  
  
@@ -2165,16 +2171,19 @@ static const char *DemoVersionDescription(int version)
     }
 }
 
-void G_DoPlayDemo (void)
+// Parse the demo header at the start of demobuffer and start the game
+// it describes.  lumpnum is the lump the demo was loaded from, or -1
+// if it was read directly from a .lmp file.  If fatal is false, a
+// demo from the wrong game version is reported on the console and
+// false is returned, rather than exiting with an error.
+
+static boolean StartDemoPlayback(int lumpnum, boolean fatal)
 {
     skill_t skill;
-    int i, lumpnum, episode, map;
+    int i, episode, map;
     int demoversion;
     boolean olddemo = false;
 
-    lumpnum = W_GetNumForName(defdemoname);
-    gameaction = ga_nothing;
-    demobuffer = W_CacheLumpNum(lumpnum, PU_STATIC);
     demo_p = demobuffer;
 
     demoversion = *demo_p++;
@@ -2206,6 +2215,15 @@ void G_DoPlayDemo (void)
                                         "/info/patches.php\n"
                               "    This appears to be %s.";
 
+        if (!fatal)
+        {
+            printf("Demo is from a different game version "
+                   "(read %i, should be %i): %s\n", demoversion,
+                   G_VanillaVersionCode(),
+                   DemoVersionDescription(demoversion));
+            return false;
+        }
+
         I_Error(message, demoversion, G_VanillaVersionCode(),
                          DemoVersionDescription(demoversion));
     }
@@ -2249,8 +2267,36 @@ void G_DoPlayDemo (void)
 
     usergame = false; 
     demoplayback = true; 
+
+    return true;
 } 
 
+void G_DoPlayDemo (void)
+{
+    int lumpnum;
+
+    lumpnum = W_GetNumForName(defdemoname);
+    gameaction = ga_nothing;
+    demobuffer = W_CacheLumpNum(lumpnum, PU_STATIC);
+
+    StartDemoPlayback(lumpnum, true);
+}
+
+//
+// G_PlayDemoBuffer
+// Start playing back a demo that has already been read into memory,
+// rather than one from a WAD lump.  Used by the -batchdemo mode.
+// The caller retains ownership of the buffer.
+//
+boolean G_PlayDemoBuffer(byte *buffer)
+{
+    defdemoname = NULL;
+    gameaction = ga_nothing;
+    demobuffer = buffer;
+
+    return StartDemoPlayback(-1, false);
+}
+
 //
 // G_TimeDemo 
 //
@@ -2306,7 +2352,10 @@ boolean G_CheckDemoStatus (void)
 	 
     if (demoplayback) 
     { 
-        W_ReleaseLumpName(defdemoname);
+        if (defdemoname != NULL)
+        {
+            W_ReleaseLumpName(defdemoname);
+        }
 	demoplayback = false; 
 	netdemo = false;
 	netgame = false;
@@ -264,7 +264,7 @@ EV_DoDoor
 	
 	// new door thinker
 	rtn = 1;
-	door = Z_Malloc (sizeof(*door), PU_LEVSPEC, 0);
+	door = P_AllocThinker (sizeof(*door), PU_LEVSPEC);
 	P_AddThinker (&door->thinker);
 	sec->specialdata = door;
 
@@ -471,7 +471,7 @@ EV_VerticalDoor
 	
     
     // new door thinker
-    door = Z_Malloc (sizeof(*door), PU_LEVSPEC, 0);
+    door = P_AllocThinker (sizeof(*door), PU_LEVSPEC);
     P_AddThinker (&door->thinker);
     sec->specialdata = door;
     door->thinker.function.acp1 = (actionf_p1) T_VerticalDoor;
@@ -521,7 +521,7 @@ void P_SpawnDoorCloseIn30 (sector_t* sec)
 {
     vldoor_t*	door;
 	
-    door = Z_Malloc ( sizeof(*door), PU_LEVSPEC, 0);
+    door = P_AllocThinker ( sizeof(*door), PU_LEVSPEC);
 
     P_AddThinker (&door->thinker);
 
@@ -546,7 +546,7 @@ P_SpawnDoorRaiseIn5Mins
 {
     vldoor_t*	door;
 	
-    door = Z_Malloc ( sizeof(*door), PU_LEVSPEC, 0);
+    door = P_AllocThinker ( sizeof(*door), PU_LEVSPEC);
     
     P_AddThinker (&door->thinker);
 
@@ -757,7 +757,7 @@ EV_SlidingDoor
     // Init sliding door vars
     if (!door)
     {
-	door = Z_Malloc (sizeof(*door), PU_LEVSPEC, 0);
+	door = P_AllocThinker (sizeof(*door), PU_LEVSPEC);
 	P_AddThinker (&door->thinker);
 	sec->specialdata = door;
 		
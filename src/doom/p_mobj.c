@@ -525,8 +525,7 @@ P_SpawnMobj
     state_t*	st;
     mobjinfo_t*	info;
 	
-    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
-    memset (mobj, 0, sizeof (*mobj));
+    mobj = P_AllocThinker (sizeof(*mobj), PU_LEVEL);
     info = &mobjinfo[type];
 	
     mobj->type = type;
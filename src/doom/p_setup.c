@@ -32,6 +32,7 @@
 #include "g_game.h"
 
 #include "i_system.h"
+#include "w_prefetch.h"
 #include "w_wad.h"
 
 #include "doomdef.h"
@@ -863,6 +864,10 @@ P_SetupLevel
     // build subsector connect matrix
     //	UNUSED P_ConnectSubsectors ();
 
+    // The map's lumps have been read, so anything still waiting in
+    // the prefetch buffers was for a map that was not loaded.
+    W_CancelPrefetch ();
+
     // preload graphics
     if (precache)
 	R_PrecacheLevel ();
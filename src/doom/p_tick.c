@@ -18,6 +18,9 @@
 //
 
 
+#include <string.h>
+
+#include "m_argv.h"
 #include "z_zone.h"
 #include "p_local.h"
 
@@ -28,7 +31,7 @@ int	leveltime;
 
 //
 // THINKERS
-// All thinkers should be allocated by Z_Malloc
+// All thinkers should be allocated by P_AllocThinker
 // so they can be operated on uniformly.
 // The actual structures will vary in size,
 // but the first element must be thinker_t.
@@ -88,6 +91,146 @@ void P_AllocateThinker (thinker_t*	thinker)
 
 
 
+//
+// THINKER POOLS
+// Thinkers are allocated from pools of slots that are a whole number
+// of cache lines long and start on a cache line, one pool for each
+// slot size, so that thinkers of the same kind are packed together
+// rather than scattered around the zone.
+// The pools take slabs of level memory from the zone.  When the level
+// is freed, the zone clears the pointer to the current slab, and the
+// pool starts again.
+// Freed slots are reused in the order they were freed, and not before
+// the next tic, so that a stale pointer to a removed mobj (such as a
+// monster's target) still finds its old contents for a while, as it
+// would in a freed zone block.  While a slot is free, its pool field
+// holds the leveltime it was freed on.
+// The zone reuses a freed block much later than that, and demos
+// depend on what stale pointers read, so the pools are only used with
+// -thinkerpools.  Otherwise each thinker is a zone block, as in
+// vanilla.
+//
+
+#define CACHE_LINE	64
+#define SLAB_SIZE	16384
+#define NUMPOOLS	8
+
+typedef struct
+{
+    void*	slab;		// current slab; NULL once freed
+    byte*	pos;		// unused part of the slab
+    byte*	end;
+    thinker_t*	free;		// freed slots, oldest first, linked by next
+    thinker_t*	lastfree;
+} thinkerpool_t;
+
+static thinkerpool_t	pools[NUMPOOLS];
+static int		use_pools = -1;
+
+
+//
+// P_AllocThinker
+// Returns a cleared thinker of the given size, in level memory.
+// Without pools, it is a zone block with the given tag.
+//
+void* P_AllocThinker (int size, int tag)
+{
+    thinkerpool_t*	pool;
+    thinker_t*		thinker;
+    int			slotsize;
+    int			i;
+
+    if (use_pools < 0)
+    {
+	//!
+	// @category game
+	//
+	// Allocate thinkers from pools of cache line aligned slots.
+	// Freed thinkers are reused sooner than in vanilla, which
+	// can break demo sync.
+	//
+
+	use_pools = M_ParmExists("-thinkerpools");
+    }
+
+    i = (size - 1) / CACHE_LINE;
+
+    if (!use_pools || i >= NUMPOOLS)
+    {
+	thinker = Z_Malloc (size, tag, NULL);
+	memset (thinker, 0, size);
+	thinker->pool = -1;
+	return thinker;
+    }
+
+    pool = &pools[i];
+    slotsize = (i + 1) * CACHE_LINE;
+
+    if (pool->slab == NULL)
+    {
+	// the level has been freed, and the free slots with it
+	pool->pos = pool->end = NULL;
+	pool->free = pool->lastfree = NULL;
+    }
+
+    if (pool->free != NULL && pool->free->pool < leveltime)
+    {
+	thinker = pool->free;
+	pool->free = thinker->next;
+
+	if (pool->free == NULL)
+	    pool->lastfree = NULL;
+    }
+    else
+    {
+	if (pool->end - pool->pos < slotsize)
+	{
+	    // The old slab is left to be freed with the level.
+	    Z_Malloc (SLAB_SIZE + CACHE_LINE - 1, PU_LEVEL, &pool->slab);
+	    pool->pos = (byte *) (((uintptr_t) pool->slab + CACHE_LINE - 1)
+				  & ~(uintptr_t) (CACHE_LINE - 1));
+	    pool->end = pool->pos + SLAB_SIZE;
+	}
+
+	thinker = (thinker_t *) pool->pos;
+	pool->pos += slotsize;
+    }
+
+    memset (thinker, 0, size);
+    thinker->pool = i;
+
+    return thinker;
+}
+
+
+//
+// P_FreeThinker
+// Returns a thinker from P_AllocThinker to its pool.
+//
+void P_FreeThinker (thinker_t* thinker)
+{
+    thinkerpool_t*	pool;
+
+    if (thinker->pool < 0)
+    {
+	Z_Free (thinker);
+	return;
+    }
+
+    pool = &pools[thinker->pool];
+    thinker->pool = leveltime;
+    thinker->next = NULL;
+
+    if (pool->lastfree != NULL)
+	pool->lastfree->next = thinker;
+    else
+	pool->free = thinker;
+
+    pool->lastfree = thinker;
+}
+
+
+
 //
 // P_RunThinkers
 //
@@ -104,7 +247,7 @@ void P_RunThinkers (void)
             nextthinker = currentthinker->next;
 	    currentthinker->next->prev = currentthinker->prev;
 	    currentthinker->prev->next = currentthinker->next;
-	    Z_Free(currentthinker);
+	    P_FreeThinker(currentthinker);
 	}
 	else
 	{
@@ -37,14 +37,15 @@
 
 
 
-seg_t*		curline;
-side_t*		sidedef;
-line_t*		linedef;
-sector_t*	frontsector;
-sector_t*	backsector;
+THREADLOCAL seg_t*		curline;
+THREADLOCAL side_t*		sidedef;
+THREADLOCAL line_t*		linedef;
+THREADLOCAL sector_t*	frontsector;
+THREADLOCAL sector_t*	backsector;
 
-drawseg_t	drawsegs[MAXDRAWSEGS];
-drawseg_t*	ds_p;
+THREADLOCAL drawseg_t*	drawsegs;
+THREADLOCAL drawseg_t*	ds_p;
+THREADLOCAL int		numdrawsegs;
 
 
 void
@@ -55,6 +56,17 @@ R_StoreWallRange
 
 
 
+//
+// R_InitDrawSegs
+// Called at program start.
+//
+void R_InitDrawSegs (void)
+{
+    numdrawsegs = MAXDRAWSEGS;
+    drawsegs = I_Realloc(NULL, numdrawsegs * sizeof(*drawsegs));
+}
+
+
 //
 // R_ClearDrawSegs
 //
@@ -64,6 +76,21 @@ void R_ClearDrawSegs (void)
 }
 
 
+//
+// R_GrowDrawSegs
+// Only used with -nolimits, when drawsegs is full.
+//
+void R_GrowDrawSegs (void)
+{
+    int		count;
+
+    count = ds_p - drawsegs;
+    numdrawsegs *= 2;
+    drawsegs = I_Realloc(drawsegs, numdrawsegs * sizeof(*drawsegs));
+    ds_p = drawsegs + count;
+}
+
+
 
 //
 // ClipWallSegment
@@ -87,8 +114,8 @@ typedef	struct
 #define MAXSEGS (SCREENWIDTH / 2 + 1)
 
 // newend is one past the last valid seg
-cliprange_t*	newend;
-cliprange_t	solidsegs[MAXSEGS];
+THREADLOCAL cliprange_t*	newend;
+THREADLOCAL cliprange_t	solidsegs[MAXSEGS];
 
 
 
@@ -22,25 +22,26 @@
 
 
 
-extern seg_t*		curline;
-extern side_t*		sidedef;
-extern line_t*		linedef;
-extern sector_t*	frontsector;
-extern sector_t*	backsector;
+extern THREADLOCAL seg_t*		curline;
+extern THREADLOCAL side_t*		sidedef;
+extern THREADLOCAL line_t*		linedef;
+extern THREADLOCAL sector_t*	frontsector;
+extern THREADLOCAL sector_t*	backsector;
 
-extern int		rw_x;
-extern int		rw_stopx;
+extern THREADLOCAL int		rw_x;
+extern THREADLOCAL int		rw_stopx;
 
-extern boolean		segtextured;
+extern THREADLOCAL boolean		segtextured;
 
 // false if the back side is the same plane
-extern boolean		markfloor;		
-extern boolean		markceiling;
+extern THREADLOCAL boolean		markfloor;		
+extern THREADLOCAL boolean		markceiling;
 
 extern boolean		skymap;
 
-extern drawseg_t	drawsegs[MAXDRAWSEGS];
-extern drawseg_t*	ds_p;
+extern THREADLOCAL drawseg_t*	drawsegs;
+extern THREADLOCAL drawseg_t*	ds_p;
+extern THREADLOCAL int		numdrawsegs;
 
 extern lighttable_t**	hscalelight;
 extern lighttable_t**	vscalelight;
@@ -52,7 +53,9 @@ typedef void (*drawfunc_t) (int start, int stop);
 
 // BSP?
 void R_ClearClipSegs (void);
+void R_InitDrawSegs (void);
 void R_ClearDrawSegs (void);
+void R_GrowDrawSegs (void);
 
 
 void R_RenderBSPNode (int bspnum);
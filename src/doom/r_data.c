@@ -22,9 +22,12 @@
 #include "deh_main.h"
 #include "i_swap.h"
 #include "i_system.h"
+#include "i_thread.h"
 #include "z_zone.h"
 
 
+#include "sha1.h"
+#include "w_startup.h"
 #include "w_wad.h"
 
 #include "doomdef.h"
@@ -125,6 +128,19 @@ struct texture_s
 };
 
 
+// A texture in the startup cache, followed by its patches[patchcount],
+//  then its column lumps and offsets[width], padded to 4 bytes.
+typedef struct
+{
+    char	name[8];
+    short	width;
+    short	height;
+    short	patchcount;
+    short	pad;
+    int		compositesize;
+} cachedtexture_t;
+
+
 
 int		firstflat;
 int		lastflat;
@@ -239,9 +255,12 @@ void R_GenerateComposite (int texnum)
 	
     texture = textures[texnum];
 
+    // texturecomposite[texnum] is only set once the texture has been
+    // built, after a release barrier, as R_GetColumn looks at it
+    // without locking.
     block = Z_Malloc (texturecompositesize[texnum],
 		      PU_STATIC, 
-		      &texturecomposite[texnum]);	
+		      &block);	
 
     collump = texturecolumnlump[texnum];
     colofs = texturecolumnofs[texnum];
@@ -279,6 +298,9 @@ void R_GenerateComposite (int texnum)
 						
     }
 
+    I_MemoryBarrierRelease ();
+    Z_ChangeUser (block, (void **) &texturecomposite[texnum]);
+
     // Now that the texture has been built in column cache,
     //  it is purgable from zone memory.
     Z_ChangeTag (block, PU_CACHE);
@@ -373,6 +395,25 @@ void R_GenerateLookup (int texnum)
 
 
 
+//
+// R_CachedLump
+// Returns a lump that is already in memory, or NULL.  This does
+//  not take the cache lock, so that drawing threads do not wait
+//  on each other for data they already have: nothing is purged
+//  while they draw, and a lump's cache pointer is only set once
+//  it has been read in, after a release barrier.
+//
+byte* R_CachedLump (int lump)
+{
+    lumpinfo_t*	l = lumpinfo[lump];
+
+    if (l->wad_file->mapped != NULL)
+	return l->wad_file->mapped + l->position;
+
+    return I_AtomicGetPtr (&l->cache);
+}
+
+
 //
 // R_GetColumn
 //
@@ -383,18 +424,248 @@ R_GetColumn
 {
     int		lump;
     int		ofs;
+    byte*	result;
 	
     col &= texturewidthmask[tex];
     lump = texturecolumnlump[tex][col];
     ofs = texturecolumnofs[tex][col];
+
+    // Only lock the cache if the column has to be loaded or built.
+    if (lump > 0)
+	result = R_CachedLump (lump);
+    else
+	result = I_AtomicGetPtr ((void **) &texturecomposite[tex]);
+
+    if (result != NULL)
+	return result + ofs;
+
+    R_LockCache ();
     
     if (lump > 0)
-	return (byte *)W_CacheLumpNum(lump,PU_CACHE)+ofs;
+	result = (byte *)W_CacheLumpNum(lump,PU_CACHE)+ofs;
+    else
+    {
+	if (!texturecomposite[tex])
+	    R_GenerateComposite (tex);
+
+	result = texturecomposite[tex] + ofs;
+    }
+
+    R_UnlockCache ();
+
+    return result;
+}
+
+
+//
+// R_StartCacheKey
+// Starts a key for the renderer's startup cache sections,
+//  covering the lump directory and the marker and table
+//  names that dehacked can change.
+// The directory is only hashed once, as the renderer is
+//  set up once, before any WAD can be reloaded.
+//
+void R_StartCacheKey (sha1_context_t* context)
+{
+    static boolean	dirkeyvalid = false;
+    static sha1_digest_t	dirkey;
+
+    if (!dirkeyvalid)
+    {
+	SHA1_Init (context);
+	W_StartupKeyLumps (context);
+	SHA1_Final (dirkey, context);
+	dirkeyvalid = true;
+    }
+
+    SHA1_Init (context);
+    SHA1_Update (context, dirkey, sizeof(dirkey));
+    SHA1_UpdateString (context, DEH_String("PNAMES"));
+    SHA1_UpdateString (context, DEH_String("TEXTURE1"));
+    SHA1_UpdateString (context, DEH_String("TEXTURE2"));
+    SHA1_UpdateString (context, DEH_String("S_START"));
+    SHA1_UpdateString (context, DEH_String("S_END"));
+}
+
+
+static void AllocTextureTables(void)
+{
+    textures = Z_Malloc (numtextures * sizeof(*textures), PU_STATIC, 0);
+    texturecolumnlump = Z_Malloc (numtextures * sizeof(*texturecolumnlump), PU_STATIC, 0);
+    texturecolumnofs = Z_Malloc (numtextures * sizeof(*texturecolumnofs), PU_STATIC, 0);
+    texturecomposite = Z_Malloc (numtextures * sizeof(*texturecomposite), PU_STATIC, 0);
+    texturecompositesize = Z_Malloc (numtextures * sizeof(*texturecompositesize), PU_STATIC, 0);
+    texturewidthmask = Z_Malloc (numtextures * sizeof(*texturewidthmask), PU_STATIC, 0);
+    textureheight = Z_Malloc (numtextures * sizeof(*textureheight), PU_STATIC, 0);
+}
+
+
+static int CachedTextureSize(int width, int patchcount)
+{
+    int size;
+
+    size = sizeof(cachedtexture_t) + patchcount * sizeof(texpatch_t)
+         + width * (sizeof(short) + sizeof(unsigned short));
+
+    return (size + 3) & ~3;
+}
+
+
+//
+// Saves the texture list and column lookups worked out by
+//  R_InitTextures, so that the next start with the same WADs
+//  does not have to read the definitions or any of the patches.
+//
+static void SaveCachedTextures(sha1_digest_t key)
+{
+    cachedtexture_t*	cached;
+    texture_t*		texture;
+    byte*		buf;
+    byte*		p;
+    int			size;
+    int			i;
+
+    size = sizeof(int);
+
+    for (i=0 ; i<numtextures ; i++)
+	size += CachedTextureSize(textures[i]->width, textures[i]->patchcount);
+
+    buf = Z_Malloc (size, PU_STATIC, NULL);
+    memset (buf, 0, size);
+    memcpy (buf, &numtextures, sizeof(int));
+    p = buf + sizeof(int);
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	texture = textures[i];
+	cached = (cachedtexture_t *) p;
+	memcpy (cached->name, texture->name, sizeof(cached->name));
+	cached->width = texture->width;
+	cached->height = texture->height;
+	cached->patchcount = texture->patchcount;
+	cached->compositesize = texturecompositesize[i];
+
+	p += sizeof(cachedtexture_t);
+	memcpy (p, texture->patches, texture->patchcount * sizeof(texpatch_t));
+	p += texture->patchcount * sizeof(texpatch_t);
+	memcpy (p, texturecolumnlump[i], texture->width * sizeof(short));
+	p += texture->width * sizeof(short);
+	memcpy (p, texturecolumnofs[i], texture->width * sizeof(unsigned short));
+
+	p = (byte *) cached
+	  + CachedTextureSize(texture->width, texture->patchcount);
+    }
+
+    W_AddStartupCache ("TEXTURES", key, buf, size);
+    Z_Free (buf);
+}
+
+
+//
+// Works out how long a cached texture section should be
+//  from the entries in it, without reading past the
+//  length it has.  Returns -1 if the entries do not fit.
+//
+static int CachedTexturesLength(const byte* data, int length)
+{
+    const cachedtexture_t*	cached;
+    int				count;
+    int				size;
+    int				i;
 
-    if (!texturecomposite[tex])
-	R_GenerateComposite (tex);
+    if (length < (int) sizeof(int))
+	return -1;
 
-    return texturecomposite[tex] + ofs;
+    memcpy (&count, data, sizeof(int));
+
+    if (count <= 0)
+	return -1;
+
+    size = sizeof(int);
+
+    for (i=0 ; i<count ; i++)
+    {
+	if (length - size < (int) sizeof(cachedtexture_t))
+	    return -1;
+
+	cached = (const cachedtexture_t *) (data + size);
+
+	if (cached->width < 0 || cached->patchcount < 0)
+	    return -1;
+
+	size += CachedTextureSize(cached->width, cached->patchcount);
+
+	if (size > length)
+	    return -1;
+    }
+
+    return size;
+}
+
+
+//
+// Sets up the texture tables from the startup cache.
+// Returns false if they are not there, or the section is
+//  not the length its entries say, in which case they are
+//  worked out again from the WADs.
+//
+static boolean LoadCachedTextures(sha1_digest_t key)
+{
+    const cachedtexture_t*	cached;
+    const byte*			data;
+    const byte*			p;
+    texture_t*			texture;
+    int				length;
+    int				i;
+    int				j;
+
+    data = W_GetStartupCache ("TEXTURES", key, &length);
+
+    if (data == NULL || CachedTexturesLength(data, length) != length)
+	return false;
+
+    memcpy (&numtextures, data, sizeof(int));
+    AllocTextureTables ();
+    p = data + sizeof(int);
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	cached = (const cachedtexture_t *) p;
+
+	texture = textures[i] =
+	    Z_Malloc (sizeof(texture_t)
+		      + sizeof(texpatch_t)*(cached->patchcount-1),
+		      PU_STATIC, 0);
+	memcpy (texture->name, cached->name, sizeof(texture->name));
+	texture->width = cached->width;
+	texture->height = cached->height;
+	texture->patchcount = cached->patchcount;
+
+	p += sizeof(cachedtexture_t);
+	memcpy (texture->patches, p, texture->patchcount * sizeof(texpatch_t));
+	p += texture->patchcount * sizeof(texpatch_t);
+
+	texturecolumnlump[i] = Z_Malloc (texture->width*sizeof(**texturecolumnlump), PU_STATIC,0);
+	texturecolumnofs[i] = Z_Malloc (texture->width*sizeof(**texturecolumnofs), PU_STATIC,0);
+	memcpy (texturecolumnlump[i], p, texture->width * sizeof(short));
+	p += texture->width * sizeof(short);
+	memcpy (texturecolumnofs[i], p, texture->width * sizeof(unsigned short));
+
+	texturecomposite[i] = 0;
+	texturecompositesize[i] = cached->compositesize;
+
+	j = 1;
+	while (j*2 <= texture->width)
+	    j<<=1;
+
+	texturewidthmask[i] = j-1;
+	textureheight[i] = texture->height<<FRACBITS;
+
+	p = (const byte *) cached
+	  + CachedTextureSize(texture->width, texture->patchcount);
+    }
+
+    return true;
 }
 
 
@@ -479,6 +750,22 @@ void R_InitTextures (void)
     int			temp2;
     int			temp3;
 
+    sha1_context_t	context;
+    sha1_digest_t	cachekey;
+
+    R_StartCacheKey (&context);
+    SHA1_Final (cachekey, &context);
+
+    if (LoadCachedTextures (cachekey))
+    {
+	texturetranslation = Z_Malloc ((numtextures+1)*sizeof(*texturetranslation), PU_STATIC, 0);
+
+	for (i=0 ; i<numtextures ; i++)
+	    texturetranslation[i] = i;
+
+	GenerateTextureHashTable();
+	return;
+    }
     
     // Load the patch names from pnames.lmp.
     name[8] = 0;
@@ -516,13 +803,7 @@ void R_InitTextures (void)
     }
     numtextures = numtextures1 + numtextures2;
 	
-    textures = Z_Malloc (numtextures * sizeof(*textures), PU_STATIC, 0);
-    texturecolumnlump = Z_Malloc (numtextures * sizeof(*texturecolumnlump), PU_STATIC, 0);
-    texturecolumnofs = Z_Malloc (numtextures * sizeof(*texturecolumnofs), PU_STATIC, 0);
-    texturecomposite = Z_Malloc (numtextures * sizeof(*texturecomposite), PU_STATIC, 0);
-    texturecompositesize = Z_Malloc (numtextures * sizeof(*texturecompositesize), PU_STATIC, 0);
-    texturewidthmask = Z_Malloc (numtextures * sizeof(*texturewidthmask), PU_STATIC, 0);
-    textureheight = Z_Malloc (numtextures * sizeof(*textureheight), PU_STATIC, 0);
+    AllocTextureTables ();
 
     totalwidth = 0;
     
@@ -620,6 +901,8 @@ void R_InitTextures (void)
 	texturetranslation[i] = i;
 
     GenerateTextureHashTable();
+
+    SaveCachedTextures (cachekey);
 }
 
 
@@ -652,26 +935,54 @@ void R_InitFlats (void)
 void R_InitSpriteLumps (void)
 {
     int		i;
-    patch_t	*patch;
+    const patch_t	*patch;
+    const fixed_t	*cached;
+    fixed_t	*buf;
+    int		size;
+    int		length;
+    sha1_context_t	context;
+    sha1_digest_t	cachekey;
 	
     firstspritelump = W_GetNumForName (DEH_String("S_START")) + 1;
     lastspritelump = W_GetNumForName (DEH_String("S_END")) - 1;
     
     numspritelumps = lastspritelump - firstspritelump + 1;
-    spritewidth = Z_Malloc (numspritelumps*sizeof(*spritewidth), PU_STATIC, 0);
-    spriteoffset = Z_Malloc (numspritelumps*sizeof(*spriteoffset), PU_STATIC, 0);
-    spritetopoffset = Z_Malloc (numspritelumps*sizeof(*spritetopoffset), PU_STATIC, 0);
+    size = numspritelumps*sizeof(fixed_t);
+    spritewidth = Z_Malloc (size, PU_STATIC, 0);
+    spriteoffset = Z_Malloc (size, PU_STATIC, 0);
+    spritetopoffset = Z_Malloc (size, PU_STATIC, 0);
+
+    // The widths and offsets are kept in the startup cache,
+    //  so that the sprites need not all be read each time.
+    R_StartCacheKey (&context);
+    SHA1_Final (cachekey, &context);
+    cached = W_GetStartupCache ("SPRLUMPS", cachekey, &length);
+
+    if (cached != NULL && length == size * 3)
+    {
+	memcpy (spritewidth, cached, size);
+	memcpy (spriteoffset, cached + numspritelumps, size);
+	memcpy (spritetopoffset, cached + numspritelumps*2, size);
+	return;
+    }
 	
     for (i=0 ; i< numspritelumps ; i++)
     {
 	if (!(i&63))
 	    printf (".");
 
-	patch = W_CacheLumpNum (firstspritelump+i, PU_CACHE);
+	patch = W_CacheLumpNumConst (firstspritelump+i, PU_CACHE);
 	spritewidth[i] = SHORT(patch->width)<<FRACBITS;
 	spriteoffset[i] = SHORT(patch->leftoffset)<<FRACBITS;
 	spritetopoffset[i] = SHORT(patch->topoffset)<<FRACBITS;
     }
+
+    buf = Z_Malloc (size * 3, PU_STATIC, NULL);
+    memcpy (buf, spritewidth, size);
+    memcpy (buf + numspritelumps, spriteoffset, size);
+    memcpy (buf + numspritelumps*2, spritetopoffset, size);
+    W_AddStartupCache ("SPRLUMPS", cachekey, buf, size * 3);
+    Z_Free (buf);
 }
 
 
@@ -23,8 +23,12 @@
 
 #include "r_defs.h"
 #include "r_state.h"
+#include "sha1.h"
 
 
+// A lump that is already in memory, or NULL.
+byte* R_CachedLump (int lump);
+
 // Retrieve column data for span blitting.
 byte*
 R_GetColumn
@@ -34,6 +38,7 @@ R_GetColumn
 
 // I/O, setting up the stuff.
 void R_InitData (void);
+void R_StartCacheKey (sha1_context_t* context);
 void R_PrecacheLevel (void);
 
 
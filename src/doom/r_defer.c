@@ -0,0 +1,285 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Deferred drawing of columns and spans.  With -deferdraw, the
+//	column and span drawers are not called while the view is
+//	walked; instead the dc_* and ds_* variables are recorded into
+//	a buffer for each thread, and drawn at the end of the frame.
+//
+//	Walls, floors, ceilings and sky never cover the same pixel,
+//	so they are sorted by the texture or flat they are drawn
+//	from before drawing.  Sprites and masked mid textures are
+//	drawn over them, and over each other, in the order they were
+//	recorded.  Fuzz columns also read back the screen and step
+//	fuzzpos, so their order must not change either.
+//
+
+#include <stdlib.h>
+
+#include "doomdef.h"
+
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+
+#include "r_local.h"
+
+#define INITIALCOMMANDS 1024
+
+typedef struct
+{
+    void	(*func) (void);
+    const byte*	source;
+    lighttable_t* colormap;
+    byte*	translation;
+    fixed_t	iscale;
+    fixed_t	texturemid;
+    short	x;
+    short	yl;
+    short	yh;
+} columncmd_t;
+
+typedef struct
+{
+    void	(*func) (void);
+    const byte*	source;
+    lighttable_t* colormap;
+    fixed_t	xfrac;
+    fixed_t	yfrac;
+    fixed_t	xstep;
+    fixed_t	ystep;
+    short	y;
+    short	x1;
+    short	x2;
+} spancmd_t;
+
+// A growable array of commands, one of each per thread.
+
+typedef struct
+{
+    void*	cmds;
+    int		num;
+    int		max;
+} cmdbuffer_t;
+
+boolean			deferdraw;
+
+THREADLOCAL int		numcolumncmds;
+THREADLOCAL int		numspancmds;
+THREADLOCAL uint64_t	rastertime;
+
+static THREADLOCAL cmdbuffer_t	wallcolumns;
+static THREADLOCAL cmdbuffer_t	planespans;
+static THREADLOCAL cmdbuffer_t	maskedcolumns;
+
+// Either wallcolumns or maskedcolumns.
+static THREADLOCAL cmdbuffer_t*	columnbuffer;
+
+
+void R_InitDeferredDraw (void)
+{
+    //!
+    // @category video
+    //
+    // Record the columns and spans of each frame and draw them
+    // once the whole view has been walked, with walls and floors
+    // sorted by texture.  With -rendstats, the time spent drawing
+    // them is printed apart from the rest.
+    //
+
+    deferdraw = M_ParmExists("-deferdraw");
+}
+
+
+//
+// NewCommand
+// Returns space for one more command in the buffer.
+//
+static void* NewCommand (cmdbuffer_t* buffer, size_t size)
+{
+    if (buffer->num == buffer->max)
+    {
+	if (buffer->max == 0)
+	    buffer->max = INITIALCOMMANDS;
+	else
+	    buffer->max *= 2;
+
+	buffer->cmds = I_Realloc(buffer->cmds, buffer->max * size);
+    }
+
+    return (byte *) buffer->cmds + (buffer->num++) * size;
+}
+
+
+void R_ColumnCommand (void (*func) (void))
+{
+    columncmd_t*	cmd;
+
+    if (!deferdraw)
+    {
+	func ();
+	return;
+    }
+
+    cmd = NewCommand(columnbuffer, sizeof(columncmd_t));
+    cmd->func = func;
+    cmd->source = dc_source;
+    cmd->colormap = dc_colormap;
+    cmd->translation = dc_translation;
+    cmd->iscale = dc_iscale;
+    cmd->texturemid = dc_texturemid;
+    cmd->x = dc_x;
+    cmd->yl = dc_yl;
+    cmd->yh = dc_yh;
+}
+
+
+void R_SpanCommand (void (*func) (void))
+{
+    spancmd_t*	cmd;
+
+    if (!deferdraw)
+    {
+	func ();
+	return;
+    }
+
+    cmd = NewCommand(&planespans, sizeof(spancmd_t));
+    cmd->func = func;
+    cmd->source = ds_source;
+    cmd->colormap = ds_colormap;
+    cmd->xfrac = ds_xfrac;
+    cmd->yfrac = ds_yfrac;
+    cmd->xstep = ds_xstep;
+    cmd->ystep = ds_ystep;
+    cmd->y = ds_y;
+    cmd->x1 = ds_x1;
+    cmd->x2 = ds_x2;
+}
+
+
+void R_ClearCommands (void)
+{
+    wallcolumns.num = 0;
+    planespans.num = 0;
+    maskedcolumns.num = 0;
+    columnbuffer = &wallcolumns;
+}
+
+
+void R_StartMaskedCommands (void)
+{
+    columnbuffer = &maskedcolumns;
+}
+
+
+//
+// Sort order for walls and floors: by texture, then across
+// the screen.
+//
+static int CompareColumns (const void* a, const void* b)
+{
+    const columncmd_t*	ca = a;
+    const columncmd_t*	cb = b;
+
+    if (ca->source != cb->source)
+	return ca->source < cb->source ? -1 : 1;
+
+    return ca->x - cb->x;
+}
+
+static int CompareSpans (const void* a, const void* b)
+{
+    const spancmd_t*	sa = a;
+    const spancmd_t*	sb = b;
+
+    if (sa->source != sb->source)
+	return sa->source < sb->source ? -1 : 1;
+
+    if (sa->y != sb->y)
+	return sa->y - sb->y;
+
+    return sa->x1 - sb->x1;
+}
+
+
+static void ExecuteColumns (cmdbuffer_t* buffer)
+{
+    columncmd_t*	cmd;
+    columncmd_t*	end;
+
+    cmd = buffer->cmds;
+    end = cmd + buffer->num;
+
+    for ( ; cmd < end ; cmd++)
+    {
+	dc_source = cmd->source;
+	dc_colormap = cmd->colormap;
+	dc_translation = cmd->translation;
+	dc_iscale = cmd->iscale;
+	dc_texturemid = cmd->texturemid;
+	dc_x = cmd->x;
+	dc_yl = cmd->yl;
+	dc_yh = cmd->yh;
+	cmd->func ();
+    }
+}
+
+
+static void ExecuteSpans (cmdbuffer_t* buffer)
+{
+    spancmd_t*	cmd;
+    spancmd_t*	end;
+
+    cmd = buffer->cmds;
+    end = cmd + buffer->num;
+
+    for ( ; cmd < end ; cmd++)
+    {
+	ds_source = cmd->source;
+	ds_colormap = cmd->colormap;
+	ds_xfrac = cmd->xfrac;
+	ds_yfrac = cmd->yfrac;
+	ds_xstep = cmd->xstep;
+	ds_ystep = cmd->ystep;
+	ds_y = cmd->y;
+	ds_x1 = cmd->x1;
+	ds_x2 = cmd->x2;
+	cmd->func ();
+    }
+}
+
+
+void R_ExecuteCommands (void)
+{
+    uint64_t	starttime;
+
+    if (!deferdraw)
+	return;
+
+    starttime = I_GetTimeUS();
+
+    qsort(wallcolumns.cmds, wallcolumns.num,
+	  sizeof(columncmd_t), CompareColumns);
+    qsort(planespans.cmds, planespans.num,
+	  sizeof(spancmd_t), CompareSpans);
+
+    ExecuteColumns (&wallcolumns);
+    ExecuteSpans (&planespans);
+    ExecuteColumns (&maskedcolumns);
+
+    numcolumncmds = wallcolumns.num + maskedcolumns.num;
+    numspancmds = planespans.num;
+    rastertime = I_GetTimeUS() - starttime;
+}
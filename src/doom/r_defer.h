@@ -0,0 +1,55 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Deferred drawing of columns and spans.
+//
+
+
+#ifndef __R_DEFER__
+#define __R_DEFER__
+
+#include "doomtype.h"
+
+// If true, columns and spans are recorded while the view is walked,
+// and drawn afterwards by R_ExecuteCommands.
+extern boolean		deferdraw;
+
+// Commands executed by the last R_ExecuteCommands in this thread,
+// and the time it took.
+extern THREADLOCAL int		numcolumncmds;
+extern THREADLOCAL int		numspancmds;
+extern THREADLOCAL uint64_t	rastertime;
+
+// Called by R_Init.
+void R_InitDeferredDraw (void);
+
+// Draw the column set up in the dc_* variables with func, or
+// record it to be drawn later.
+void R_ColumnCommand (void (*func) (void));
+
+// Draw the span set up in the ds_* variables with func, or
+// record it to be drawn later.
+void R_SpanCommand (void (*func) (void));
+
+// Start recording a new view, with walls and floors first.
+void R_ClearCommands (void);
+
+// Called before drawing sprites and masked mid textures, which
+// overlap each other and so must be drawn in order.
+void R_StartMaskedCommands (void);
+
+// Draw everything recorded since R_ClearCommands.
+void R_ExecuteCommands (void);
+
+#endif
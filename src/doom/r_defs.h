@@ -427,6 +427,9 @@ typedef struct
   int			lightlevel;
   int			minx;
   int			maxx;
+
+  // next visplane in the same R_FindPlane hash chain, or -1
+  int			hashnext;
   
   // leave pads for [minx-1]/[maxx+1]
   
@@ -21,10 +21,13 @@
 
 
 
+#include <string.h>
+
 #include "doomdef.h"
 #include "deh_main.h"
 
 #include "i_system.h"
+#include "m_argv.h"
 #include "z_zone.h"
 #include "w_wad.h"
 
@@ -37,6 +40,13 @@
 #include "doomstat.h"
 
 
+// SSE2 and AVX2 span drawers are built for x86 with GCC or Clang,
+// and chosen at run time if the CPU supports them.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define HAVE_SIMD_SPANS
+#include <immintrin.h>
+#endif
+
 // ?
 #define MAXWIDTH			1120
 #define MAXHEIGHT			832
@@ -79,18 +89,18 @@ static pixel_t *background_buffer = NULL;
 // R_DrawColumn
 // Source is the top of the column to scale.
 //
-lighttable_t*		dc_colormap; 
-int			dc_x; 
-int			dc_yl; 
-int			dc_yh; 
-fixed_t			dc_iscale; 
-fixed_t			dc_texturemid;
+THREADLOCAL lighttable_t*		dc_colormap; 
+THREADLOCAL int			dc_x; 
+THREADLOCAL int			dc_yl; 
+THREADLOCAL int			dc_yh; 
+THREADLOCAL fixed_t			dc_iscale; 
+THREADLOCAL fixed_t			dc_texturemid;
 
 // first pixel in a column (possibly virtual) 
-byte*			dc_source;		
+THREADLOCAL const byte*			dc_source;		
 
 // just for profiling 
-int			dccount;
+THREADLOCAL int			dccount;
 
 //
 // A column is a vertical slice/span from a wall texture that,
@@ -152,7 +162,7 @@ void R_DrawColumn (void)
 void R_DrawColumn (void) 
 { 
     int			count; 
-    byte*		source;
+    const byte*		source;
     byte*		dest;
     byte*		colormap;
     
@@ -269,7 +279,7 @@ int	fuzzoffset[FUZZTABLE] =
     FUZZOFF,FUZZOFF,-FUZZOFF,FUZZOFF,FUZZOFF,-FUZZOFF,FUZZOFF 
 }; 
 
-int	fuzzpos = 0; 
+THREADLOCAL int	fuzzpos = 0; 
 
 
 //
@@ -337,6 +347,25 @@ void R_DrawFuzzColumn (void)
     } while (count--); 
 } 
 
+//
+// R_SkipFuzzColumn
+// Steps the fuzz effect past a column that is not drawn by this
+// thread, so that the columns it does draw get the same pattern.
+//
+void R_SkipFuzzColumn (void)
+{
+    int			yl;
+    int			yh;
+
+    yl = dc_yl ? dc_yl : 1;
+    yh = dc_yh == viewheight-1 ? viewheight - 2 : dc_yh;
+
+    if (yh < yl)
+	return;
+
+    fuzzpos = (fuzzpos + yh - yl + 1) % FUZZTABLE;
+}
+
 // low detail mode version
  
 void R_DrawFuzzColumnLow (void) 
@@ -418,7 +447,7 @@ void R_DrawFuzzColumnLow (void)
 //  of the BaronOfHell, the HellKnight, uses
 //  identical sprites, kinda brightened up.
 //
-byte*	dc_translation;
+THREADLOCAL byte*	dc_translation;
 byte*	translationtables;
 
 void R_DrawTranslatedColumn (void) 
@@ -567,22 +596,22 @@ void R_InitTranslationTables (void)
 // In consequence, flats are not stored by column (like walls),
 //  and the inner loop has to step in texture space u and v.
 //
-int			ds_y; 
-int			ds_x1; 
-int			ds_x2;
+THREADLOCAL int			ds_y; 
+THREADLOCAL int			ds_x1; 
+THREADLOCAL int			ds_x2;
 
-lighttable_t*		ds_colormap; 
+THREADLOCAL lighttable_t*		ds_colormap; 
 
-fixed_t			ds_xfrac; 
-fixed_t			ds_yfrac; 
-fixed_t			ds_xstep; 
-fixed_t			ds_ystep;
+THREADLOCAL fixed_t			ds_xfrac; 
+THREADLOCAL fixed_t			ds_yfrac; 
+THREADLOCAL fixed_t			ds_xstep; 
+THREADLOCAL fixed_t			ds_ystep;
 
 // start of a 64*64 tile image 
-byte*			ds_source;	
+THREADLOCAL const byte*			ds_source;	
 
 // just for profiling
-int			dscount;
+THREADLOCAL int			dscount;
 
 
 //
@@ -640,6 +669,209 @@ void R_DrawSpan (void)
 
 
 
+//
+// R_StepSpan
+// Moves the start of the span along by count pixels.  The span
+// drawers step a packed position in which y carries into x, so
+// this steps the packed position as they would and unpacks it,
+// rather than adding count steps to ds_xfrac and ds_yfrac.
+//
+void R_StepSpan (int count)
+{
+    unsigned int position, step;
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    position += step * count;
+
+    ds_xfrac = (position & 0xffff0000) >> 10;
+    ds_yfrac = (position & 0x0000ffff) << 6;
+}
+
+
+// Span drawer for high detail mode: R_DrawSpan, or one of the
+// vectorized versions below.
+void (*highspanfunc) (void) = R_DrawSpan;
+
+#ifdef HAVE_SIMD_SPANS
+
+//
+// R_DrawSpanSSE2
+// Works out the texture index of four pixels at a time from the
+// same packed position as R_DrawSpan.  SSE2 has no gather, so the
+// texels and colormap entries are still looked up one by one.
+//
+__attribute__((target("sse2")))
+static void R_DrawSpanSSE2 (void)
+{
+    unsigned int position, step;
+    unsigned int spots[4];
+    __m128i pos, step4, ymask;
+    pixel_t *dest;
+    int count;
+    int spot;
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    count = ds_x2 - ds_x1 + 1;
+
+    pos = _mm_setr_epi32(position, position + step,
+                         position + step * 2, position + step * 3);
+    step4 = _mm_set1_epi32(step * 4);
+    ymask = _mm_set1_epi32(0x0fc0);
+
+    while (count >= 4)
+    {
+        _mm_storeu_si128((__m128i *) spots,
+                         _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pos, 4),
+                                                    ymask),
+                                      _mm_srli_epi32(pos, 26)));
+
+        dest[0] = ds_colormap[ds_source[spots[0]]];
+        dest[1] = ds_colormap[ds_source[spots[1]]];
+        dest[2] = ds_colormap[ds_source[spots[2]]];
+        dest[3] = ds_colormap[ds_source[spots[3]]];
+
+        pos = _mm_add_epi32(pos, step4);
+        position += step * 4;
+        dest += 4;
+        count -= 4;
+    }
+
+    while (count > 0)
+    {
+        spot = ((position >> 4) & 0x0fc0) | (position >> 26);
+        *dest++ = ds_colormap[ds_source[spot]];
+        position += step;
+        count--;
+    }
+}
+
+//
+// R_DrawSpanAVX2
+// Eight pixels at a time, with the texels and then the colormap
+// entries fetched by gathers.  Gathers load 32 bits, so each byte
+// is loaded as the top byte of the word that ends at it: this only
+// reads the three bytes before the flat or colormap, which always
+// lie in the same zone block header or WAD.
+//
+__attribute__((target("avx2")))
+static void R_DrawSpanAVX2 (void)
+{
+    unsigned int position, step;
+    __m256i pos, step8, ymask, texels, pixels;
+    __m128i low, high;
+    const int *source, *colormap;
+    pixel_t *dest;
+    int count;
+    int spot;
+    uint32_t packed;
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    count = ds_x2 - ds_x1 + 1;
+
+    source = (const int *) (ds_source - 3);
+    colormap = (const int *) (ds_colormap - 3);
+
+    pos = _mm256_setr_epi32(position, position + step,
+                            position + step * 2, position + step * 3,
+                            position + step * 4, position + step * 5,
+                            position + step * 6, position + step * 7);
+    step8 = _mm256_set1_epi32(step * 8);
+    ymask = _mm256_set1_epi32(0x0fc0);
+
+    while (count >= 8)
+    {
+        texels = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(pos, 4),
+                                                  ymask),
+                                 _mm256_srli_epi32(pos, 26));
+        texels = _mm256_srli_epi32(_mm256_i32gather_epi32(source, texels, 1),
+                                   24);
+        pixels = _mm256_srli_epi32(_mm256_i32gather_epi32(colormap, texels, 1),
+                                   24);
+
+        // Narrow the eight 32-bit results down to bytes.  The packs
+        // work within each 128-bit half, so each half holds four of
+        // the pixels in its low 32 bits.
+        pixels = _mm256_packus_epi32(pixels, pixels);
+        pixels = _mm256_packus_epi16(pixels, pixels);
+        low = _mm256_castsi256_si128(pixels);
+        high = _mm256_extracti128_si256(pixels, 1);
+
+        packed = _mm_cvtsi128_si32(low);
+        memcpy(dest, &packed, 4);
+        packed = _mm_cvtsi128_si32(high);
+        memcpy(dest + 4, &packed, 4);
+
+        pos = _mm256_add_epi32(pos, step8);
+        dest += 8;
+        count -= 8;
+    }
+
+    // The rest of the span, from the first position not yet drawn.
+    position = _mm_cvtsi128_si32(_mm256_castsi256_si128(pos));
+
+    while (count > 0)
+    {
+        spot = ((position >> 4) & 0x0fc0) | (position >> 26);
+        *dest++ = ds_colormap[ds_source[spot]];
+        position += step;
+        count--;
+    }
+}
+
+#endif
+
+//
+// R_InitSpanDrawer
+// Picks the fastest span drawer the CPU supports.  They all draw
+// exactly the same pixels.
+//
+void R_InitSpanDrawer (void)
+{
+    highspanfunc = R_DrawSpan;
+
+#ifdef HAVE_SIMD_SPANS
+    //!
+    // @category video
+    //
+    // Don't use the SSE2 or AVX2 versions of the floor and ceiling
+    // drawer, or of the palette conversion in the video code, even if
+    // the CPU supports them.
+    //
+
+    if (M_ParmExists("-nosimd"))
+    {
+        return;
+    }
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        highspanfunc = R_DrawSpanAVX2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        highspanfunc = R_DrawSpanSSE2;
+    }
+#endif
+}
+
+
+
 // UNUSED.
 // Loop unrolled by 4.
 #if 0
@@ -647,7 +879,7 @@ void R_DrawSpan (void)
 { 
     unsigned	position, step;
 
-    byte*	source;
+    const byte*	source;
     byte*	colormap;
     pixel_t*	dest;
     
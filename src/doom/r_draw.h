@@ -23,15 +23,15 @@
 
 
 
-extern lighttable_t*	dc_colormap;
-extern int		dc_x;
-extern int		dc_yl;
-extern int		dc_yh;
-extern fixed_t		dc_iscale;
-extern fixed_t		dc_texturemid;
+extern THREADLOCAL lighttable_t*	dc_colormap;
+extern THREADLOCAL int		dc_x;
+extern THREADLOCAL int		dc_yl;
+extern THREADLOCAL int		dc_yh;
+extern THREADLOCAL fixed_t		dc_iscale;
+extern THREADLOCAL fixed_t		dc_texturemid;
 
 // first pixel in a column
-extern byte*		dc_source;		
+extern THREADLOCAL const byte*		dc_source;		
 
 
 // The span blitting interface.
@@ -41,8 +41,11 @@ void 	R_DrawColumn (void);
 void 	R_DrawColumnLow (void);
 
 // The Spectre/Invisibility effect.
+extern THREADLOCAL int	fuzzpos;
+
 void 	R_DrawFuzzColumn (void);
 void 	R_DrawFuzzColumnLow (void);
+void	R_SkipFuzzColumn (void);
 
 // Draw with color translation tables,
 //  for player sprite rendering,
@@ -55,27 +58,32 @@ R_VideoErase
 ( unsigned	ofs,
   int		count );
 
-extern int		ds_y;
-extern int		ds_x1;
-extern int		ds_x2;
+extern THREADLOCAL int		ds_y;
+extern THREADLOCAL int		ds_x1;
+extern THREADLOCAL int		ds_x2;
 
-extern lighttable_t*	ds_colormap;
+extern THREADLOCAL lighttable_t*	ds_colormap;
 
-extern fixed_t		ds_xfrac;
-extern fixed_t		ds_yfrac;
-extern fixed_t		ds_xstep;
-extern fixed_t		ds_ystep;
+extern THREADLOCAL fixed_t		ds_xfrac;
+extern THREADLOCAL fixed_t		ds_yfrac;
+extern THREADLOCAL fixed_t		ds_xstep;
+extern THREADLOCAL fixed_t		ds_ystep;
 
 // start of a 64*64 tile image
-extern byte*		ds_source;		
+extern THREADLOCAL const byte*		ds_source;		
 
 extern byte*		translationtables;
-extern byte*		dc_translation;
+extern THREADLOCAL byte*		dc_translation;
 
 
 // Span blitting for rows, floor/ceiling.
 // No Sepctre effect needed.
 void 	R_DrawSpan (void);
+void	R_StepSpan (int count);
+
+// R_DrawSpan, or a faster version of it if the CPU supports one.
+extern void	(*highspanfunc) (void);
+void	R_InitSpanDrawer (void);
 
 // Low resolution mode, 160x200?
 void 	R_DrawSpanLow (void);
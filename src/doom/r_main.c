@@ -27,10 +27,17 @@
 
 
 #include "doomdef.h"
+#include "doomstat.h"
 #include "d_loop.h"
+#include "i_system.h"
+#include "i_timer.h"
 
+#include "m_argv.h"
 #include "m_bbox.h"
 #include "m_menu.h"
+#include "m_misc.h"
+#include "m_profile.h"
+#include "z_zone.h"
 
 #include "r_local.h"
 #include "r_sky.h"
@@ -50,8 +57,8 @@ int			viewangleoffset;
 int			validcount = 1;		
 
 
-lighttable_t*		fixedcolormap;
-extern lighttable_t**	walllights;
+THREADLOCAL lighttable_t*		fixedcolormap;
+extern THREADLOCAL lighttable_t**	walllights;
 
 int			centerx;
 int			centery;
@@ -63,24 +70,53 @@ fixed_t			projection;
 // just for profiling purposes
 int			framecount;	
 
-int			sscount;
+THREADLOCAL int			sscount;
 int			linecount;
 int			loopcount;
 
-fixed_t			viewx;
-fixed_t			viewy;
-fixed_t			viewz;
+THREADLOCAL fixed_t			viewx;
+THREADLOCAL fixed_t			viewy;
+THREADLOCAL fixed_t			viewz;
 
-angle_t			viewangle;
+THREADLOCAL angle_t			viewangle;
 
-fixed_t			viewcos;
-fixed_t			viewsin;
+THREADLOCAL fixed_t			viewcos;
+THREADLOCAL fixed_t			viewsin;
 
-player_t*		viewplayer;
+THREADLOCAL player_t*		viewplayer;
 
 // 0 = high, 1 = low
 int			detailshift;	
 
+// If true, the renderer's fixed size arrays grow when they fill up
+// instead of dropping geometry or exiting with an error.
+boolean			nolimits;
+
+// Columns of the view drawn by this thread: the whole view, unless
+// it is split between several threads with -renderthreads.
+THREADLOCAL int		stripx1;
+THREADLOCAL int		stripx2;
+
+// If true, renderer statistics are printed for each level.
+static boolean		rendstats;
+
+// Peak usage of those arrays on the current level, the visplane
+// lookups made by R_FindPlane, and the time spent drawing the view.
+static int		peakvissprites;
+static int		peakdrawsegs;
+static int		peakvisplanes;
+static int		peakopenings;
+static int		peakepisode;
+static int		peakmap;
+static int		statframes;
+static uint64_t		totalplaneprobes;
+static uint64_t		totalplanescans;
+static uint64_t		rendertime;
+static uint64_t		totalrendertime;
+static uint64_t		totalrastertime;
+static uint64_t		totalcolumncmds;
+static uint64_t		totalspancmds;
+
 //
 // precalculated math tables
 //
@@ -98,15 +134,15 @@ int			viewangletox[FINEANGLES/2];
 angle_t			xtoviewangle[SCREENWIDTH+1];
 
 lighttable_t*		scalelight[LIGHTLEVELS][MAXLIGHTSCALE];
-lighttable_t*		scalelightfixed[MAXLIGHTSCALE];
+THREADLOCAL lighttable_t*		scalelightfixed[MAXLIGHTSCALE];
 lighttable_t*		zlight[LIGHTLEVELS][MAXLIGHTZ];
 
 // bumped light from gun blasts
-int			extralight;			
+THREADLOCAL int			extralight;			
 
 
 
-void (*colfunc) (void);
+THREADLOCAL void (*colfunc) (void);
 void (*basecolfunc) (void);
 void (*fuzzcolfunc) (void);
 void (*transcolfunc) (void);
@@ -700,7 +736,7 @@ void R_ExecuteSetViewSize (void)
 	colfunc = basecolfunc = R_DrawColumn;
 	fuzzcolfunc = R_DrawFuzzColumn;
 	transcolfunc = R_DrawTranslatedColumn;
-	spanfunc = R_DrawSpan;
+	spanfunc = highspanfunc;
     }
     else
     {
@@ -758,6 +794,86 @@ void R_ExecuteSetViewSize (void)
 
 
 
+//
+// R_PrintRenderStats
+// Report the peak usage of the growable renderer arrays on the
+// level that was last drawn, and the average time per frame.
+//
+static void R_PrintRenderStats (void)
+{
+    char	level[9];
+
+    if (peakmap == 0)
+	return;
+
+    if (gamemode == commercial)
+	M_snprintf(level, sizeof(level), "MAP%02i", peakmap);
+    else
+	M_snprintf(level, sizeof(level), "E%iM%i", peakepisode, peakmap);
+
+    printf("R_PrintRenderStats: %s: %i vissprites, %i drawsegs, "
+           "%i visplanes, %i openings\n", level, peakvissprites,
+           peakdrawsegs, peakvisplanes, peakopenings);
+    printf("R_PrintRenderStats: %s: %i visplane probes per frame "
+           "(%i with a linear search)\n", level,
+           (int) (totalplaneprobes / statframes),
+           (int) (totalplanescans / statframes));
+    printf("R_PrintRenderStats: %s: %i us per frame drawing the view\n",
+           level, (int) (totalrendertime / statframes));
+
+    if (deferdraw)
+    {
+        printf("R_PrintRenderStats: %s: %i us per frame rasterizing "
+               "%i columns and %i spans\n", level,
+               (int) (totalrastertime / statframes),
+               (int) (totalcolumncmds / statframes),
+               (int) (totalspancmds / statframes));
+    }
+
+    peakvissprites = peakdrawsegs = peakvisplanes = peakopenings = 0;
+    peakmap = 0;
+    statframes = 0;
+    totalplaneprobes = totalplanescans = 0;
+    totalrendertime = totalrastertime = 0;
+    totalcolumncmds = totalspancmds = 0;
+}
+
+
+//
+// R_UpdateRenderStats
+// At the end of each frame, with -nolimits or -rendstats.
+//
+static void R_UpdateRenderStats (void)
+{
+    if (gamemap != peakmap || gameepisode != peakepisode)
+    {
+	R_PrintRenderStats ();
+	peakepisode = gameepisode;
+	peakmap = gamemap;
+    }
+
+    if (vissprite_p - vissprites > peakvissprites)
+	peakvissprites = vissprite_p - vissprites;
+
+    if (ds_p - drawsegs > peakdrawsegs)
+	peakdrawsegs = ds_p - drawsegs;
+
+    if (lastvisplane - visplanes > peakvisplanes)
+	peakvisplanes = lastvisplane - visplanes;
+
+    if (lastopening - openings > peakopenings)
+	peakopenings = lastopening - openings;
+
+    statframes++;
+    totalplaneprobes += visplaneprobes;
+    totalplanescans += visplanescans;
+    totalrendertime += I_GetTimeUS() - rendertime;
+    totalrastertime += rastertime;
+    totalcolumncmds += numcolumncmds;
+    totalspancmds += numspancmds;
+}
+
+
 //
 // R_Init
 //
@@ -766,6 +882,32 @@ void R_ExecuteSetViewSize (void)
 
 void R_Init (void)
 {
+    //!
+    // @category video
+    //
+    // Remove the vanilla limits on visible sprites, drawsegs, visplanes
+    // and openings: the arrays are grown as needed.  The peak usage for
+    // each level is printed when the level changes.
+    //
+
+    nolimits = M_ParmExists("-nolimits");
+
+    //!
+    // @category video
+    //
+    // Print renderer statistics for each level when it ends: the peak
+    // usage of the renderer's arrays, the average number of visplanes
+    // compared per frame when looking up floors and ceilings, and the
+    // average time taken to draw each frame.
+    //
+
+    rendstats = nolimits || M_ParmExists("-rendstats");
+
+    if (rendstats)
+    {
+        I_AtExit(R_PrintRenderStats, true);
+    }
+
     R_InitData ();
     printf (".");
     R_InitPointToAngle ();
@@ -776,11 +918,15 @@ void R_Init (void)
 
     R_SetViewSize (screenblocks, detailLevel);
     R_InitPlanes ();
+    R_InitDrawSegs ();
     printf (".");
     R_InitLightTables ();
     printf (".");
     R_InitSkyMap ();
     R_InitTranslationTables ();
+    R_InitSpanDrawer ();
+    R_InitRenderThreads ();
+    R_InitDeferredDraw ();
     printf (".");
 	
     framecount = 0;
@@ -818,9 +964,10 @@ R_PointInSubsector
 
 
 //
-// R_SetupFrame
+// R_SetupView
+// Sets up this thread's view of the player.
 //
-void R_SetupFrame (player_t* player)
+void R_SetupView (player_t* player)
 {		
     int		i;
     
@@ -850,41 +997,132 @@ void R_SetupFrame (player_t* player)
     }
     else
 	fixedcolormap = 0;
-		
+}
+
+
+//
+// R_SetupFrame
+//
+void R_SetupFrame (player_t* player)
+{
+    R_SetupView (player);
+
     framecount++;
     validcount++;
 }
 
 
+//
+// R_RenderViewStrip
+// Draws columns x1 to x2 of the view.  The visibility passes
+// still cover the whole view, so that walls and floors are
+// stepped across the strip exactly as when drawing it all.
+//
+void R_RenderViewStrip (int x1, int x2)
+{
+    // Only the main thread, which draws the first strip, is profiled.
+    boolean	profile = (x1 == 0);
+
+    stripx1 = x1;
+    stripx2 = x2;
+
+    R_ClearClipSegs ();
+    R_ClearDrawSegs ();
+    R_ClearPlanes ();
+    R_ClearSprites ();
+    R_ClearCommands ();
+
+    if (profile)
+	M_ProfileStart(PROFILE_BSP);
+    R_RenderBSPNode (numnodes-1);
+    if (profile)
+    {
+	M_ProfileStop(PROFILE_BSP);
+	M_ProfileStart(PROFILE_PLANES);
+    }
+    R_DrawPlanes ();
+    if (profile)
+    {
+	M_ProfileStop(PROFILE_PLANES);
+	M_ProfileStart(PROFILE_MASKED);
+    }
+    R_StartMaskedCommands ();
+    R_DrawMasked ();
+    R_ExecuteCommands ();
+    if (profile)
+	M_ProfileStop(PROFILE_MASKED);
+}
+
+
 
 //
 // R_RenderView
 //
 void R_RenderPlayerView (player_t* player)
 {	
+    if (rendstats)
+	rendertime = I_GetTimeUS();
+
     R_SetupFrame (player);
 
+    if (numrenderthreads > 1)
+    {
+	// Console commands are not checked while other threads
+	// are drawing, as they may load from the zone.
+	NetUpdate ();
+	R_RenderThreaded (player);
+
+	if (rendstats)
+	    R_UpdateRenderStats ();
+
+	NetUpdate ();
+	return;
+    }
+
+    stripx1 = 0;
+    stripx2 = viewwidth - 1;
+
     // Clear buffers.
     R_ClearClipSegs ();
     R_ClearDrawSegs ();
     R_ClearPlanes ();
     R_ClearSprites ();
+    R_ClearCommands ();
+
+    // Recorded commands draw from cached textures and sprites,
+    // which must not be purged before the end of the frame.
+    if (deferdraw)
+	Z_EnablePurging(false);
     
     // check for new console commands.
     NetUpdate ();
 
     // The head node is the last node output.
+    M_ProfileStart(PROFILE_BSP);
     R_RenderBSPNode (numnodes-1);
+    M_ProfileStop(PROFILE_BSP);
     
     // Check for new console commands.
     NetUpdate ();
     
+    M_ProfileStart(PROFILE_PLANES);
     R_DrawPlanes ();
+    M_ProfileStop(PROFILE_PLANES);
     
     // Check for new console commands.
     NetUpdate ();
     
+    M_ProfileStart(PROFILE_MASKED);
+    R_StartMaskedCommands ();
     R_DrawMasked ();
+    R_ExecuteCommands ();
+    M_ProfileStop(PROFILE_MASKED);
+
+    if (deferdraw)
+	Z_EnablePurging(true);
+
+    if (rendstats)
+	R_UpdateRenderStats ();
 
     // Check for new console commands.
     NetUpdate ();				
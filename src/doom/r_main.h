@@ -29,12 +29,15 @@
 //
 // POV related.
 //
-extern fixed_t		viewcos;
-extern fixed_t		viewsin;
+extern THREADLOCAL fixed_t		viewcos;
+extern THREADLOCAL fixed_t		viewsin;
 
 extern int		viewwindowx;
 extern int		viewwindowy;
 
+extern THREADLOCAL int	stripx1;
+extern THREADLOCAL int	stripx2;
+
 
 
 extern int		centerx;
@@ -67,11 +70,11 @@ extern int		loopcount;
 #define LIGHTZSHIFT		20
 
 extern lighttable_t*	scalelight[LIGHTLEVELS][MAXLIGHTSCALE];
-extern lighttable_t*	scalelightfixed[MAXLIGHTSCALE];
+extern THREADLOCAL lighttable_t*	scalelightfixed[MAXLIGHTSCALE];
 extern lighttable_t*	zlight[LIGHTLEVELS][MAXLIGHTZ];
 
-extern int		extralight;
-extern lighttable_t*	fixedcolormap;
+extern THREADLOCAL int		extralight;
+extern THREADLOCAL lighttable_t*	fixedcolormap;
 
 
 // Number of diminishing brightness levels.
@@ -84,12 +87,15 @@ extern lighttable_t*	fixedcolormap;
 //  0 = high, 1 = low
 extern	int		detailshift;	
 
+// Grow renderer arrays instead of enforcing the vanilla limits.
+extern	boolean		nolimits;
+
 
 //
 // Function pointers to switch refresh/drawing functions.
 // Used to select shadow mode etc.
 //
-extern void		(*colfunc) (void);
+extern THREADLOCAL void	(*colfunc) (void);
 extern void		(*transcolfunc) (void);
 extern void		(*basecolfunc) (void);
 extern void		(*fuzzcolfunc) (void);
@@ -151,6 +157,10 @@ R_AddPointToBox
 // Called by G_Drawer.
 void R_RenderPlayerView (player_t *player);
 
+// Used by the rendering threads.
+void R_SetupView (player_t *player);
+void R_RenderViewStrip (int x1, int x2);
+
 // Called by startup code.
 void R_Init (void);
 
@@ -42,16 +42,37 @@ planefunction_t		ceilingfunc;
 //
 
 // Here comes the obnoxious "visplane".
+// With -nolimits, the visplane and openings arrays are grown
+// on demand instead.
 #define MAXVISPLANES	512
-visplane_t		visplanes[MAXVISPLANES];
-visplane_t*		lastvisplane;
-visplane_t*		floorplane;
-visplane_t*		ceilingplane;
+THREADLOCAL visplane_t*		visplanes;
+THREADLOCAL visplane_t*		lastvisplane;
+THREADLOCAL visplane_t*		floorplane;
+THREADLOCAL visplane_t*		ceilingplane;
+THREADLOCAL int			numvisplanes;
 
 // ?
 #define MAXOPENINGS	SCREENWIDTH*64
-short			openings[MAXOPENINGS];
-short*			lastopening;
+THREADLOCAL short*			openings;
+THREADLOCAL short*			lastopening;
+THREADLOCAL int			numopenings;
+
+// R_FindPlane looks up visplanes in a hash table, which only holds the
+// first visplane for each height/picnum/lightlevel.  That is the one a
+// linear search from the start of visplanes would have found, so the
+// same visplanes are used.  Chains hold indexes rather than pointers,
+// as visplanes may move when it grows.
+#define VISPLANEHASHSIZE	128
+static THREADLOCAL int		visplanehash[VISPLANEHASHSIZE];
+
+#define VisplaneHash(height, picnum, lightlevel) \
+    ((((unsigned int) (height) >> FRACBITS) * 7 + (picnum) * 3 \
+      + (lightlevel)) & (VISPLANEHASHSIZE - 1))
+
+// Number of visplanes compared by R_FindPlane this frame, and the
+// number the old linear search would have compared.
+THREADLOCAL int			visplaneprobes;
+THREADLOCAL int			visplanescans;
 
 
 //
@@ -59,31 +80,31 @@ short*			lastopening;
 //  floorclip starts out SCREENHEIGHT
 //  ceilingclip starts out -1
 //
-short			floorclip[SCREENWIDTH];
-short			ceilingclip[SCREENWIDTH];
+THREADLOCAL short			floorclip[SCREENWIDTH];
+THREADLOCAL short			ceilingclip[SCREENWIDTH];
 
 //
 // spanstart holds the start of a plane span
 // initialized to 0 at start
 //
-int			spanstart[SCREENHEIGHT];
-int			spanstop[SCREENHEIGHT];
+THREADLOCAL int			spanstart[SCREENHEIGHT];
+THREADLOCAL int			spanstop[SCREENHEIGHT];
 
 //
 // texture mapping
 //
-lighttable_t**		planezlight;
-fixed_t			planeheight;
+THREADLOCAL lighttable_t**		planezlight;
+THREADLOCAL fixed_t			planeheight;
 
 fixed_t			yslope[SCREENHEIGHT];
 fixed_t			distscale[SCREENWIDTH];
-fixed_t			basexscale;
-fixed_t			baseyscale;
+THREADLOCAL fixed_t			basexscale;
+THREADLOCAL fixed_t			baseyscale;
 
-fixed_t			cachedheight[SCREENHEIGHT];
-fixed_t			cacheddistance[SCREENHEIGHT];
-fixed_t			cachedxstep[SCREENHEIGHT];
-fixed_t			cachedystep[SCREENHEIGHT];
+THREADLOCAL fixed_t			cachedheight[SCREENHEIGHT];
+THREADLOCAL fixed_t			cacheddistance[SCREENHEIGHT];
+THREADLOCAL fixed_t			cachedxstep[SCREENHEIGHT];
+THREADLOCAL fixed_t			cachedystep[SCREENHEIGHT];
 
 
 
@@ -93,7 +114,85 @@ fixed_t			cachedystep[SCREENHEIGHT];
 //
 void R_InitPlanes (void)
 {
-  // Doh!
+    // R_MakeSpans relies on the unused parts of the bottom arrays
+    // being clear, as they were when this was a static array.
+    numvisplanes = MAXVISPLANES;
+    visplanes = I_Realloc(NULL, numvisplanes * sizeof(*visplanes));
+    memset(visplanes, 0, numvisplanes * sizeof(*visplanes));
+
+    numopenings = MAXOPENINGS;
+    openings = I_Realloc(NULL, numopenings * sizeof(*openings));
+}
+
+
+//
+// R_GrowVisplanes
+// Only used with -nolimits, when visplanes is full.
+// Pointers into the array are moved to the new one.
+//
+static void R_GrowVisplanes (void)
+{
+    int		last;
+    int		floor;
+    int		ceiling;
+
+    last = lastvisplane - visplanes;
+    floor = floorplane != NULL ? floorplane - visplanes : -1;
+    ceiling = ceilingplane != NULL ? ceilingplane - visplanes : -1;
+
+    visplanes = I_Realloc(visplanes, 2 * numvisplanes * sizeof(*visplanes));
+    memset(visplanes + numvisplanes, 0, numvisplanes * sizeof(*visplanes));
+    numvisplanes *= 2;
+
+    lastvisplane = visplanes + last;
+    floorplane = floor >= 0 ? visplanes + floor : NULL;
+    ceilingplane = ceiling >= 0 ? visplanes + ceiling : NULL;
+}
+
+
+//
+// R_CheckOpenings
+// Only used with -nolimits.  Makes sure there is room for another
+// count entries in openings, growing the array if necessary.  The
+// drawsegs already stored point into it and must be moved over.
+//
+void R_CheckOpenings (int count)
+{
+    short*	newopenings;
+    drawseg_t*	ds;
+    int		used;
+    int		newsize;
+
+    used = lastopening - openings;
+
+    if (used + count <= numopenings)
+	return;
+
+    newsize = numopenings;
+
+    while (used + count > newsize)
+	newsize *= 2;
+
+    newopenings = I_Realloc(NULL, newsize * sizeof(*openings));
+    memcpy(newopenings, openings, used * sizeof(*openings));
+
+    for (ds = drawsegs ; ds < ds_p ; ds++)
+    {
+	if (ds->maskedtexturecol != NULL)
+	    ds->maskedtexturecol = newopenings + (ds->maskedtexturecol - openings);
+
+	if (ds->sprtopclip != NULL && ds->sprtopclip != screenheightarray)
+	    ds->sprtopclip = newopenings + (ds->sprtopclip - openings);
+
+	if (ds->sprbottomclip != NULL && ds->sprbottomclip != negonearray)
+	    ds->sprbottomclip = newopenings + (ds->sprbottomclip - openings);
+    }
+
+    free(openings);
+
+    openings = newopenings;
+    lastopening = openings + used;
+    numopenings = newsize;
 }
 
 
@@ -131,6 +230,9 @@ R_MapPlane
     }
 #endif
 
+    if (x2 < stripx1 || x1 > stripx2)
+	return;
+
     if (planeheight != cachedheight[y])
     {
 	cachedheight[y] = planeheight;
@@ -162,12 +264,22 @@ R_MapPlane
 	ds_colormap = planezlight[index];
     }
 	
+    // clip to this thread's strip
+    if (x1 < stripx1)
+    {
+	R_StepSpan (stripx1 - x1);
+	x1 = stripx1;
+    }
+
+    if (x2 > stripx2)
+	x2 = stripx2;
+
     ds_y = y;
     ds_x1 = x1;
     ds_x2 = x2;
 
     // high or low detail
-    spanfunc ();	
+    R_SpanCommand (spanfunc);
 }
 
 
@@ -189,6 +301,12 @@ void R_ClearPlanes (void)
 
     lastvisplane = visplanes;
     lastopening = openings;
+
+    for (i=0 ; i<VISPLANEHASHSIZE ; i++)
+	visplanehash[i] = -1;
+
+    visplaneprobes = 0;
+    visplanescans = 0;
     
     // texture calculation
     memset (cachedheight, 0, sizeof(cachedheight));
@@ -214,35 +332,48 @@ R_FindPlane
   int		lightlevel )
 {
     visplane_t*	check;
+    int		hash;
+    int		i;
 	
     if (picnum == skyflatnum)
     {
 	height = 0;			// all skys map together
 	lightlevel = 0;
     }
+
+    hash = VisplaneHash (height, picnum, lightlevel);
 	
-    for (check=visplanes; check<lastvisplane; check++)
+    for (i=visplanehash[hash]; i != -1; i=check->hashnext)
     {
+	check = &visplanes[i];
+	visplaneprobes++;
+
 	if (height == check->height
 	    && picnum == check->picnum
 	    && lightlevel == check->lightlevel)
 	{
-	    break;
+	    visplanescans += i + 1;
+	    return check;
 	}
     }
-    
-			
-    if (check < lastvisplane)
-	return check;
+
+    visplanescans += lastvisplane - visplanes;
 		
-    if (lastvisplane - visplanes == MAXVISPLANES)
-	I_Error ("R_FindPlane: no more visplanes");
+    if (lastvisplane - visplanes == numvisplanes)
+    {
+	if (!nolimits)
+	    I_Error ("R_FindPlane: no more visplanes");
+
+	R_GrowVisplanes ();
+    }
 		
-    lastvisplane++;
+    check = lastvisplane++;
 
     check->height = height;
     check->picnum = picnum;
     check->lightlevel = lightlevel;
+    check->hashnext = visplanehash[hash];
+    visplanehash[hash] = check - visplanes;
     check->minx = SCREENWIDTH;
     check->maxx = -1;
     
@@ -303,12 +434,22 @@ R_CheckPlane
     }
 	
     // make a new visplane
+    if (nolimits && lastvisplane - visplanes == numvisplanes)
+    {
+	x = pl - visplanes;
+	R_GrowVisplanes ();
+	pl = visplanes + x;
+    }
+
+    // Checked before anything is written to the new plane, as
+    // visplanes is a heap block of exactly numvisplanes entries.
+    if (lastvisplane - visplanes == numvisplanes)
+	I_Error ("R_CheckPlane: no more visplanes");
+
     lastvisplane->height = pl->height;
     lastvisplane->picnum = pl->picnum;
     lastvisplane->lightlevel = pl->lightlevel;
-    
-    if (lastvisplane - visplanes == MAXVISPLANES)
-	I_Error ("R_CheckPlane: no more visplanes");
+    lastvisplane->hashnext = -1;
 
     pl = lastvisplane++;
     pl->minx = start;
@@ -370,15 +511,15 @@ void R_DrawPlanes (void)
     int                 lumpnum;
 				
 #ifdef RANGECHECK
-    if (ds_p - drawsegs > MAXDRAWSEGS)
+    if (ds_p - drawsegs > numdrawsegs)
 	I_Error ("R_DrawPlanes: drawsegs overflow (%" PRIiPTR ")",
 		 ds_p - drawsegs);
     
-    if (lastvisplane - visplanes > MAXVISPLANES)
+    if (lastvisplane - visplanes > numvisplanes)
 	I_Error ("R_DrawPlanes: visplane overflow (%" PRIiPTR ")",
 		 lastvisplane - visplanes);
     
-    if (lastopening - openings > MAXOPENINGS)
+    if (lastopening - openings > numopenings)
 	I_Error ("R_DrawPlanes: opening overflow (%" PRIiPTR ")",
 		 lastopening - openings);
 #endif
@@ -388,6 +529,9 @@ void R_DrawPlanes (void)
 	if (pl->minx > pl->maxx)
 	    continue;
 
+	if (pl->maxx < stripx1 || pl->minx > stripx2)
+	    continue;
+
 	
 	// sky flat
 	if (pl->picnum == skyflatnum)
@@ -400,7 +544,9 @@ void R_DrawPlanes (void)
 	    //  by INVUL inverse mapping.
 	    dc_colormap = colormaps;
 	    dc_texturemid = skytexturemid;
-	    for (x=pl->minx ; x <= pl->maxx ; x++)
+	    x = pl->minx < stripx1 ? stripx1 : pl->minx;
+	    stop = pl->maxx > stripx2 ? stripx2 : pl->maxx;
+	    for ( ; x <= stop ; x++)
 	    {
 		dc_yl = pl->top[x];
 		dc_yh = pl->bottom[x];
@@ -410,7 +556,7 @@ void R_DrawPlanes (void)
 		    angle = (viewangle + xtoviewangle[x])>>ANGLETOSKYSHIFT;
 		    dc_x = x;
 		    dc_source = R_GetColumn(skytexture, angle);
-		    colfunc ();
+		    R_ColumnCommand (colfunc);
 		}
 	    }
 	    continue;
@@ -418,7 +564,9 @@ void R_DrawPlanes (void)
 	
 	// regular flat
         lumpnum = firstflat + flattranslation[pl->picnum];
-	ds_source = W_CacheLumpNum(lumpnum, PU_STATIC);
+	R_LockCache ();
+	ds_source = W_CacheLumpNumConst(lumpnum, PU_STATIC);
+	R_UnlockCache ();
 	
 	planeheight = abs(pl->height-viewz);
 	light = (pl->lightlevel >> LIGHTSEGSHIFT)+extralight;
@@ -436,14 +584,28 @@ void R_DrawPlanes (void)
 		
 	stop = pl->maxx + 1;
 
-	for (x=pl->minx ; x<= stop ; x++)
+	// Spans are started from the left edge of the plane, even if
+	// that is outside this thread's strip, so that they begin at
+	// the same place.  Those still open at the right edge of the
+	// strip are finished there.
+	if (stop > stripx2 + 1)
+	    stop = stripx2 + 1;
+
+	for (x=pl->minx ; x< stop ; x++)
 	{
 	    R_MakeSpans(x,pl->top[x-1],
 			pl->bottom[x-1],
 			pl->top[x],
 			pl->bottom[x]);
 	}
+
+	R_MakeSpans(stop,pl->top[stop-1],
+		    pl->bottom[stop-1],
+		    stop == pl->maxx + 1 ? pl->top[stop] : 0xff,
+		    pl->bottom[stop]);
 	
+	R_LockCache ();
         W_ReleaseLumpNum(lumpnum);
+	R_UnlockCache ();
     }
 }
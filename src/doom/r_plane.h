@@ -26,7 +26,16 @@
 
 
 // Visplane related.
-extern  short*		lastopening;
+extern THREADLOCAL short*		openings;
+extern THREADLOCAL short*		lastopening;
+extern THREADLOCAL int		numopenings;
+
+extern THREADLOCAL visplane_t*	visplanes;
+extern THREADLOCAL visplane_t*	lastvisplane;
+extern THREADLOCAL int		numvisplanes;
+
+extern THREADLOCAL int		visplaneprobes;
+extern THREADLOCAL int		visplanescans;
 
 
 typedef void (*planefunction_t) (int top, int bottom);
@@ -34,14 +43,15 @@ typedef void (*planefunction_t) (int top, int bottom);
 extern planefunction_t	floorfunc;
 extern planefunction_t	ceilingfunc_t;
 
-extern short		floorclip[SCREENWIDTH];
-extern short		ceilingclip[SCREENWIDTH];
+extern THREADLOCAL short		floorclip[SCREENWIDTH];
+extern THREADLOCAL short		ceilingclip[SCREENWIDTH];
 
 extern fixed_t		yslope[SCREENHEIGHT];
 extern fixed_t		distscale[SCREENWIDTH];
 
 void R_InitPlanes (void);
 void R_ClearPlanes (void);
+void R_CheckOpenings (int count);
 
 void
 R_MapPlane
@@ -36,56 +36,93 @@
 // OPTIMIZE: closed two sided lines as single sided
 
 // True if any of the segs textures might be visible.
-boolean		segtextured;	
+THREADLOCAL boolean		segtextured;	
 
 // False if the back side is the same plane.
-boolean		markfloor;	
-boolean		markceiling;
+THREADLOCAL boolean		markfloor;	
+THREADLOCAL boolean		markceiling;
 
-boolean		maskedtexture;
-int		toptexture;
-int		bottomtexture;
-int		midtexture;
+THREADLOCAL boolean		maskedtexture;
+THREADLOCAL int		toptexture;
+THREADLOCAL int		bottomtexture;
+THREADLOCAL int		midtexture;
 
 
-angle_t		rw_normalangle;
+THREADLOCAL angle_t		rw_normalangle;
 // angle to line origin
-int		rw_angle1;	
+THREADLOCAL int		rw_angle1;	
 
 //
 // regular wall
 //
-int		rw_x;
-int		rw_stopx;
-angle_t		rw_centerangle;
-fixed_t		rw_offset;
-fixed_t		rw_distance;
-fixed_t		rw_scale;
-fixed_t		rw_scalestep;
-fixed_t		rw_midtexturemid;
-fixed_t		rw_toptexturemid;
-fixed_t		rw_bottomtexturemid;
+THREADLOCAL int		rw_x;
+THREADLOCAL int		rw_stopx;
+THREADLOCAL angle_t		rw_centerangle;
+THREADLOCAL fixed_t		rw_offset;
+THREADLOCAL fixed_t		rw_distance;
+THREADLOCAL fixed_t		rw_scale;
+THREADLOCAL fixed_t		rw_scalestep;
+THREADLOCAL fixed_t		rw_midtexturemid;
+THREADLOCAL fixed_t		rw_toptexturemid;
+THREADLOCAL fixed_t		rw_bottomtexturemid;
 
-int		worldtop;
-int		worldbottom;
-int		worldhigh;
-int		worldlow;
+THREADLOCAL int		worldtop;
+THREADLOCAL int		worldbottom;
+THREADLOCAL int		worldhigh;
+THREADLOCAL int		worldlow;
 
-fixed_t		pixhigh;
-fixed_t		pixlow;
-fixed_t		pixhighstep;
-fixed_t		pixlowstep;
+THREADLOCAL fixed_t		pixhigh;
+THREADLOCAL fixed_t		pixlow;
+THREADLOCAL fixed_t		pixhighstep;
+THREADLOCAL fixed_t		pixlowstep;
 
-fixed_t		topfrac;
-fixed_t		topstep;
+THREADLOCAL fixed_t		topfrac;
+THREADLOCAL fixed_t		topstep;
 
-fixed_t		bottomfrac;
-fixed_t		bottomstep;
+THREADLOCAL fixed_t		bottomfrac;
+THREADLOCAL fixed_t		bottomstep;
 
 
-lighttable_t**	walllights;
+THREADLOCAL lighttable_t**	walllights;
 
-short*		maskedtexturecol;
+THREADLOCAL short*		maskedtexturecol;
+
+// Lines seen by the first strip in a threaded frame, to be marked
+// as mapped once all the threads have finished.
+static line_t**		mappedlines;
+static int		nummappedlines;
+static int		maxmappedlines;
+
+
+//
+// R_AddMappedLine
+//
+void R_AddMappedLine (line_t* line)
+{
+    if (nummappedlines == maxmappedlines)
+    {
+	maxmappedlines = maxmappedlines ? maxmappedlines * 2 : 256;
+	mappedlines = I_Realloc (mappedlines,
+				 maxmappedlines * sizeof(*mappedlines));
+    }
+
+    mappedlines[nummappedlines++] = line;
+}
+
+
+//
+// R_MarkMappedLines
+// Called after the threads have finished drawing.
+//
+void R_MarkMappedLines (void)
+{
+    int		i;
+
+    for (i = 0; i < nummappedlines; i++)
+	mappedlines[i]->flags |= ML_MAPPED;
+
+    nummappedlines = 0;
+}
 
 
 
@@ -102,6 +139,14 @@ R_RenderMaskedSegRange
     column_t*	col;
     int		lightnum;
     int		texnum;
+
+    // clip to this thread's strip
+    if (x1 < stripx1)
+	x1 = stripx1;
+    if (x2 > stripx2)
+	x2 = stripx2;
+    if (x1 > x2)
+	return;
     
     // Calculate light table.
     // Use different light tables
@@ -206,9 +251,14 @@ void R_RenderSegLoop (void)
     fixed_t		texturecolumn;
     int			top;
     int			bottom;
+    boolean		drawcolumn;
 
     for ( ; rw_x < rw_stopx ; rw_x++)
     {
+	// columns outside this thread's strip are clipped but not drawn
+	drawcolumn = rw_x >= stripx1 && rw_x <= stripx2;
+
+
 	// mark floor / ceiling areas
 	yl = (topfrac+HEIGHTUNIT-1)>>HEIGHTBITS;
 
@@ -250,7 +300,7 @@ void R_RenderSegLoop (void)
 	}
 	
 	// texturecolumn and lighting are independent of wall tiers
-	if (segtextured)
+	if (segtextured && drawcolumn)
 	{
 	    // calculate texture offset
 	    angle = (rw_centerangle + xtoviewangle[rw_x])>>ANGLETOFINESHIFT;
@@ -280,8 +330,11 @@ void R_RenderSegLoop (void)
 	    dc_yl = yl;
 	    dc_yh = yh;
 	    dc_texturemid = rw_midtexturemid;
-	    dc_source = R_GetColumn(midtexture,texturecolumn);
-	    colfunc ();
+	    if (drawcolumn)
+	    {
+		dc_source = R_GetColumn(midtexture,texturecolumn);
+		R_ColumnCommand (colfunc);
+	    }
 	    ceilingclip[rw_x] = viewheight;
 	    floorclip[rw_x] = -1;
 	}
@@ -302,8 +355,11 @@ void R_RenderSegLoop (void)
 		    dc_yl = yl;
 		    dc_yh = mid;
 		    dc_texturemid = rw_toptexturemid;
-		    dc_source = R_GetColumn(toptexture,texturecolumn);
-		    colfunc ();
+		    if (drawcolumn)
+		    {
+			dc_source = R_GetColumn(toptexture,texturecolumn);
+			R_ColumnCommand (colfunc);
+		    }
 		    ceilingclip[rw_x] = mid;
 		}
 		else
@@ -331,9 +387,12 @@ void R_RenderSegLoop (void)
 		    dc_yl = mid;
 		    dc_yh = yh;
 		    dc_texturemid = rw_bottomtexturemid;
-		    dc_source = R_GetColumn(bottomtexture,
-					    texturecolumn);
-		    colfunc ();
+		    if (drawcolumn)
+		    {
+			dc_source = R_GetColumn(bottomtexture,
+						texturecolumn);
+			R_ColumnCommand (colfunc);
+		    }
 		    floorclip[rw_x] = mid;
 		}
 		else
@@ -380,8 +439,17 @@ R_StoreWallRange
     int			lightnum;
 
     // don't overflow and crash
-    if (ds_p == &drawsegs[MAXDRAWSEGS])
-	return;		
+    if (ds_p == &drawsegs[numdrawsegs])
+    {
+	if (!nolimits)
+	    return;
+
+	R_GrowDrawSegs ();
+    }
+
+    // make sure there is room for this wall's clipping arrays
+    if (nolimits)
+	R_CheckOpenings (3 * (stop - start + 1));
 		
 #ifdef RANGECHECK
     if (start >=viewwidth || start > stop)
@@ -391,8 +459,17 @@ R_StoreWallRange
     sidedef = curline->sidedef;
     linedef = curline->linedef;
 
-    // mark the segment as visible for auto map
-    linedef->flags |= ML_MAPPED;
+    // mark the segment as visible for auto map; every thread
+    // walks the whole view, so only the first strip's does this.
+    // The other threads read the line flags, so while they are
+    // drawing the line is set aside until they have finished.
+    if (stripx1 == 0 && !(linedef->flags & ML_MAPPED))
+    {
+	if (numrenderthreads > 1)
+	    R_AddMappedLine (linedef);
+	else
+	    linedef->flags |= ML_MAPPED;
+    }
     
     // calculate rw_distance for scale calculation
     rw_normalangle = curline->angle + ANG90;
@@ -29,5 +29,9 @@ R_RenderMaskedSegRange
   int		x1,
   int		x2 );
 
+// Lines to mark as mapped once the drawing threads have finished.
+void R_AddMappedLine (line_t* line);
+void R_MarkMappedLines (void);
+
 
 #endif
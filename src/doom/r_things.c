@@ -29,6 +29,7 @@
 #include "i_swap.h"
 #include "i_system.h"
 #include "z_zone.h"
+#include "w_startup.h"
 #include "w_wad.h"
 
 #include "r_local.h"
@@ -68,7 +69,7 @@ typedef struct
 fixed_t		pspritescale;
 fixed_t		pspriteiscale;
 
-lighttable_t**	spritelights;
+THREADLOCAL lighttable_t**	spritelights;
 
 // constant arrays
 //  used for psprite clipping and initializing clipping
@@ -168,6 +169,76 @@ R_InstallSpriteLump
 //  letter/number appended.
 // The rotation character can be 0 to signify no rotations.
 //
+//
+// The frame tables are kept in the startup cache as the number
+//  of sprites, the number of frames of each, then all the frames.
+//
+static boolean R_LoadCachedSpriteDefs(sha1_digest_t key)
+{
+    const int*		numframes;
+    const byte*		data;
+    const byte*		frames;
+    int			length;
+    int			size;
+    int			i;
+
+    data = W_GetStartupCache("SPRDEFS", key, &length);
+
+    if (data == NULL || length < (int) sizeof(int)
+     || *(const int *) data != numsprites)
+	return false;
+
+    numframes = (const int *) data + 1;
+    frames = (const byte *) (numframes + numsprites);
+
+    for (i=0 ; i<numsprites ; i++)
+    {
+	sprites[i].numframes = numframes[i];
+	sprites[i].spriteframes = NULL;
+
+	if (numframes[i] > 0)
+	{
+	    size = numframes[i] * sizeof(spriteframe_t);
+	    sprites[i].spriteframes = Z_Malloc (size, PU_STATIC, NULL);
+	    memcpy (sprites[i].spriteframes, frames, size);
+	    frames += size;
+	}
+    }
+
+    return true;
+}
+
+static void R_SaveCachedSpriteDefs(sha1_digest_t key)
+{
+    int*		numframes;
+    byte*		buf;
+    byte*		frames;
+    int			length;
+    int			size;
+    int			i;
+
+    length = sizeof(int) * (numsprites + 1);
+
+    for (i=0 ; i<numsprites ; i++)
+	length += sprites[i].numframes * sizeof(spriteframe_t);
+
+    buf = Z_Malloc (length, PU_STATIC, NULL);
+    numframes = (int *) buf;
+    numframes[0] = numsprites;
+    frames = buf + sizeof(int) * (numsprites + 1);
+
+    for (i=0 ; i<numsprites ; i++)
+    {
+	numframes[i + 1] = sprites[i].numframes;
+	size = sprites[i].numframes * sizeof(spriteframe_t);
+	memcpy (frames, sprites[i].spriteframes, size);
+	frames += size;
+    }
+
+    W_AddStartupCache ("SPRDEFS", key, buf, length);
+    Z_Free (buf);
+}
+
 void R_InitSpriteDefs(const char **namelist)
 { 
     const char **check;
@@ -178,6 +249,8 @@ void R_InitSpriteDefs(const char **namelist)
     int		start;
     int		end;
     int		patched;
+    sha1_context_t	context;
+    sha1_digest_t	cachekey;
 		
     // count the number of sprite names
     check = namelist;
@@ -190,6 +263,15 @@ void R_InitSpriteDefs(const char **namelist)
 	return;
 		
     sprites = Z_Malloc(numsprites *sizeof(*sprites), PU_STATIC, NULL);
+
+    R_StartCacheKey (&context);
+    for (i=0 ; i<numsprites ; i++)
+	SHA1_UpdateString (&context, DEH_String(namelist[i]));
+    SHA1_UpdateInt32 (&context, modifiedgame);
+    SHA1_Final (cachekey, &context);
+
+    if (R_LoadCachedSpriteDefs (cachekey))
+	return;
 	
     start = firstspritelump-1;
     end = lastspritelump+1;
@@ -270,6 +352,7 @@ void R_InitSpriteDefs(const char **namelist)
 	memcpy (sprites[i].spriteframes, sprtemp, maxframe*sizeof(spriteframe_t));
     }
 
+    R_SaveCachedSpriteDefs (cachekey);
 }
 
 
@@ -278,9 +361,18 @@ void R_InitSpriteDefs(const char **namelist)
 //
 // GAME FUNCTIONS
 //
-vissprite_t	vissprites[MAXVISSPRITES];
-vissprite_t*	vissprite_p;
-int		newvissprite;
+THREADLOCAL vissprite_t*	vissprites;
+THREADLOCAL vissprite_t*	vissprite_p;
+THREADLOCAL int		numvissprites;
+THREADLOCAL int		newvissprite;
+
+static THREADLOCAL vissprite_t **vsprsortbuf;
+
+// validcount of the last frame in which each sector's things were
+// added.  Kept by each thread rather than in the sectors, as every
+// thread walks the BSP.
+static THREADLOCAL int	*sectorvalid;
+static THREADLOCAL int	numsectorvalid;
 
 
 
@@ -296,11 +388,25 @@ void R_InitSprites(const char **namelist)
     {
 	negonearray[i] = -1;
     }
+
+    R_InitVisSprites ();
 	
     R_InitSpriteDefs (namelist);
 }
 
 
+//
+// R_InitVisSprites
+// Allocates this thread's vissprites.
+//
+void R_InitVisSprites (void)
+{
+    numvissprites = MAXVISSPRITES;
+    vissprites = I_Realloc(NULL, numvissprites * sizeof(*vissprites));
+    vsprsortbuf = I_Realloc(NULL, numvissprites * sizeof(*vsprsortbuf));
+}
+
+
 
 //
 // R_ClearSprites
@@ -309,18 +415,38 @@ void R_InitSprites(const char **namelist)
 void R_ClearSprites (void)
 {
     vissprite_p = vissprites;
+
+    if (numsectorvalid < numsectors)
+    {
+	sectorvalid = I_Realloc(sectorvalid, numsectors * sizeof(*sectorvalid));
+	memset(sectorvalid + numsectorvalid, 0,
+	       (numsectors - numsectorvalid) * sizeof(*sectorvalid));
+	numsectorvalid = numsectors;
+    }
 }
 
 
 //
 // R_NewVisSprite
 //
-vissprite_t	overflowsprite;
+THREADLOCAL vissprite_t	overflowsprite;
 
 vissprite_t* R_NewVisSprite (void)
 {
-    if (vissprite_p == &vissprites[MAXVISSPRITES])
-	return &overflowsprite;
+    int		count;
+
+    if (vissprite_p == &vissprites[numvissprites])
+    {
+	if (!nolimits)
+	    return &overflowsprite;
+
+	count = vissprite_p - vissprites;
+	numvissprites *= 2;
+	vissprites = I_Realloc(vissprites, numvissprites * sizeof(*vissprites));
+	vsprsortbuf = I_Realloc(vsprsortbuf,
+	                        numvissprites * sizeof(*vsprsortbuf));
+	vissprite_p = vissprites + count;
+    }
     
     vissprite_p++;
     return vissprite_p-1;
@@ -334,11 +460,11 @@ vissprite_t* R_NewVisSprite (void)
 // Masked means: partly transparent, i.e. stored
 //  in posts/runs of opaque pixels.
 //
-short*		mfloorclip;
-short*		mceilingclip;
+THREADLOCAL short*		mfloorclip;
+THREADLOCAL short*		mceilingclip;
 
-fixed_t		spryscale;
-fixed_t		sprtopscreen;
+THREADLOCAL fixed_t		spryscale;
+THREADLOCAL fixed_t		sprtopscreen;
 
 void R_DrawMaskedColumn (column_t* column)
 {
@@ -371,7 +497,10 @@ void R_DrawMaskedColumn (column_t* column)
 
 	    // Drawn by either R_DrawColumn
 	    //  or (SHADOW) R_DrawFuzzColumn.
-	    colfunc ();	
+	    if (dc_x >= stripx1 && dc_x <= stripx2)
+		R_ColumnCommand (colfunc);
+	    else if (colfunc == fuzzcolfunc)
+		R_ColumnCommand (R_SkipFuzzColumn);
 	}
 	column = (column_t *)(  (byte *)column + column->length + 4);
     }
@@ -397,7 +526,14 @@ R_DrawVisSprite
     patch_t*		patch;
 	
 	
-    patch = W_CacheLumpNum (vis->patch+firstspritelump, PU_CACHE);
+    patch = (patch_t *) R_CachedLump (vis->patch+firstspritelump);
+
+    if (patch == NULL)
+    {
+	R_LockCache ();
+	patch = W_CacheLumpNum (vis->patch+firstspritelump, PU_CACHE);
+	R_UnlockCache ();
+    }
 
     dc_colormap = vis->colormap;
     
@@ -415,11 +551,22 @@ R_DrawVisSprite
 	
     dc_iscale = abs(vis->xiscale)>>detailshift;
     dc_texturemid = vis->texturemid;
-    frac = vis->startfrac;
     spryscale = vis->scale;
     sprtopscreen = centeryfrac - FixedMul(dc_texturemid,spryscale);
+
+    // Clip to this thread's strip.  Shadows are not clipped, so that
+    // the fuzz effect is stepped through every column.
+    if (colfunc != fuzzcolfunc)
+    {
+	if (x1 < stripx1)
+	    x1 = stripx1;
+	if (x2 > stripx2)
+	    x2 = stripx2;
+    }
+
+    frac = vis->startfrac + vis->xiscale * (x1 - vis->x1);
 	
-    for (dc_x=vis->x1 ; dc_x<=vis->x2 ; dc_x++, frac += vis->xiscale)
+    for (dc_x=x1 ; dc_x<=x2 ; dc_x++, frac += vis->xiscale)
     {
 	texturecolumn = frac>>FRACBITS;
 #ifdef RANGECHECK
@@ -611,11 +758,11 @@ void R_AddSprites (sector_t* sec)
     // A sector might have been split into several
     //  subsectors during BSP building.
     // Thus we check whether its already added.
-    if (sec->validcount == validcount)
+    if (sectorvalid[sec - sectors] == validcount)
 	return;		
 
     // Well, now it will be done.
-    sec->validcount = validcount;
+    sectorvalid[sec - sectors] = validcount;
 	
     lightnum = (sec->lightlevel >> LIGHTSEGSHIFT)+extralight;
 
@@ -773,57 +920,55 @@ void R_DrawPlayerSprites (void)
 //
 // R_SortVisSprites
 //
-vissprite_t	vsprsortedhead;
+THREADLOCAL vissprite_t	vsprsortedhead;
+
+
+// Order vissprites by increasing scale.  Vanilla used a selection sort
+// that picks the first of several sprites with equal scale, so ties are
+// broken by position in the vissprites array to draw in the same order.
+
+static int CompareVisSprites(const void *a, const void *b)
+{
+    const vissprite_t *spr1 = *(const vissprite_t **) a;
+    const vissprite_t *spr2 = *(const vissprite_t **) b;
+
+    if (spr1->scale != spr2->scale)
+    {
+        return spr1->scale < spr2->scale ? -1 : 1;
+    }
 
+    return spr1 < spr2 ? -1 : spr1 > spr2;
+}
 
 void R_SortVisSprites (void)
 {
     int			i;
     int			count;
     vissprite_t*	ds;
-    vissprite_t*	best;
-    vissprite_t		unsorted;
-    fixed_t		bestscale;
 
     count = vissprite_p - vissprites;
-	
-    unsorted.next = unsorted.prev = &unsorted;
+
+    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
 
     if (!count)
 	return;
-		
-    for (ds=vissprites ; ds<vissprite_p ; ds++)
+
+    for (i=0 ; i<count ; i++)
     {
-	ds->next = ds+1;
-	ds->prev = ds-1;
+	vsprsortbuf[i] = &vissprites[i];
     }
-    
-    vissprites[0].prev = &unsorted;
-    unsorted.next = &vissprites[0];
-    (vissprite_p-1)->next = &unsorted;
-    unsorted.prev = vissprite_p-1;
-    
-    // pull the vissprites out by scale
 
-    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
+    qsort(vsprsortbuf, count, sizeof(*vsprsortbuf), CompareVisSprites);
+
+    // link the vissprites in sorted order
+
     for (i=0 ; i<count ; i++)
     {
-	bestscale = INT_MAX;
-        best = unsorted.next;
-	for (ds=unsorted.next ; ds!= &unsorted ; ds=ds->next)
-	{
-	    if (ds->scale < bestscale)
-	    {
-		bestscale = ds->scale;
-		best = ds;
-	    }
-	}
-	best->next->prev = best->prev;
-	best->prev->next = best->next;
-	best->next = &vsprsortedhead;
-	best->prev = vsprsortedhead.prev;
-	vsprsortedhead.prev->next = best;
-	vsprsortedhead.prev = best;
+	ds = vsprsortbuf[i];
+	ds->next = &vsprsortedhead;
+	ds->prev = vsprsortedhead.prev;
+	vsprsortedhead.prev->next = ds;
+	vsprsortedhead.prev = ds;
     }
 }
 
@@ -843,6 +988,11 @@ void R_DrawSprite (vissprite_t* spr)
     fixed_t		scale;
     fixed_t		lowscale;
     int			silhouette;
+
+    // Skip sprites outside this thread's strip, apart from shadows,
+    // which must still step the fuzz effect.
+    if ((spr->x2 < stripx1 || spr->x1 > stripx2) && spr->colormap != NULL)
+	return;
 		
     for (x = spr->x1 ; x<=spr->x2 ; x++)
 	clipbot[x] = cliptop[x] = -2;
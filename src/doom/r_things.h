@@ -24,9 +24,10 @@
 
 #define MAXVISSPRITES  	512
 
-extern vissprite_t	vissprites[MAXVISSPRITES];
-extern vissprite_t*	vissprite_p;
-extern vissprite_t	vsprsortedhead;
+extern THREADLOCAL vissprite_t*	vissprites;
+extern THREADLOCAL vissprite_t*	vissprite_p;
+extern THREADLOCAL int		numvissprites;
+extern THREADLOCAL vissprite_t	vsprsortedhead;
 
 // Constant arrays used for psprite clipping
 //  and initializing clipping.
@@ -34,10 +35,10 @@ extern short		negonearray[SCREENWIDTH];
 extern short		screenheightarray[SCREENWIDTH];
 
 // vars for R_DrawMaskedColumn
-extern short*		mfloorclip;
-extern short*		mceilingclip;
-extern fixed_t		spryscale;
-extern fixed_t		sprtopscreen;
+extern THREADLOCAL short*		mfloorclip;
+extern THREADLOCAL short*		mceilingclip;
+extern THREADLOCAL fixed_t		spryscale;
+extern THREADLOCAL fixed_t		sprtopscreen;
 
 extern fixed_t		pspritescale;
 extern fixed_t		pspriteiscale;
@@ -52,6 +53,7 @@ void R_AddSprites (sector_t* sec);
 void R_AddPSprites (void);
 void R_DrawSprites (void);
 void R_InitSprites(const char **namelist);
+void R_InitVisSprites (void);
 void R_ClearSprites (void);
 void R_DrawMasked (void);
 
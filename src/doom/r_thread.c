@@ -0,0 +1,224 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Drawing the view with several threads.  The view is split
+//	into vertical strips, one per thread.  Each thread has its
+//	own copy of the renderer's working state (see THREADLOCAL)
+//	and walks the BSP for the whole view, but only draws the
+//	columns in its own strip.  Walls, floors and sprites are
+//	stepped exactly as in a single thread, so the picture is
+//	the same.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "doomdef.h"
+
+#include "i_system.h"
+#include "i_thread.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "z_zone.h"
+
+#include "r_local.h"
+
+#define MAXRENDERTHREADS 16
+
+typedef struct
+{
+    i_thread_t *thread;
+    i_semaphore_t *start;
+    i_semaphore_t *done;
+
+    // Strip of the view to draw.
+    int x1, x2;
+} renderthread_t;
+
+int numrenderthreads = 1;
+
+// Thread 0 is the main thread, which draws the first strip itself.
+static renderthread_t renderthreads[MAXRENDERTHREADS];
+
+static i_mutex_t *cache_mutex = NULL;
+
+// Shared with the other threads at the start of each frame.
+static player_t *frame_player;
+static int frame_fuzzpos;
+static boolean shutting_down = false;
+
+static int RenderThread(void *data)
+{
+    renderthread_t *rt = data;
+
+    // Allocate this thread's own working arrays.
+    R_InitPlanes ();
+    R_InitDrawSegs ();
+    R_InitVisSprites ();
+
+    for (;;)
+    {
+        I_SemaphoreWait(rt->start);
+
+        if (shutting_down)
+        {
+            break;
+        }
+
+        R_SetupView (frame_player);
+        colfunc = basecolfunc;
+        fuzzpos = frame_fuzzpos;
+
+        R_RenderViewStrip (rt->x1, rt->x2);
+
+        I_SemaphorePost(rt->done);
+    }
+
+    return 0;
+}
+
+static void ShutdownRenderThreads(void)
+{
+    int i;
+
+    shutting_down = true;
+
+    for (i = 1; i < numrenderthreads; ++i)
+    {
+        I_SemaphorePost(renderthreads[i].start);
+        I_WaitThread(renderthreads[i].thread);
+        I_DestroySemaphore(renderthreads[i].start);
+        I_DestroySemaphore(renderthreads[i].done);
+    }
+
+    I_DestroyMutex(cache_mutex);
+    cache_mutex = NULL;
+    numrenderthreads = 1;
+}
+
+void R_InitRenderThreads (void)
+{
+    char name[16];
+    int p;
+    int i;
+
+    //!
+    // @arg <n>
+    // @category video
+    //
+    // Draw the view with n threads, each drawing a vertical strip
+    // of the screen.  If n is 0, one thread is used for each CPU.
+    // Cached graphics are not purged while the view is drawn, so if
+    // the zone fills up during a frame, the game exits with an error
+    // instead of making room.  Use -mb to give it more memory.
+    //
+
+    p = M_CheckParmWithArgs("-renderthreads", 1);
+
+    if (p == 0)
+    {
+        return;
+    }
+
+#ifndef HAVE_THREADLOCAL
+    printf("R_InitRenderThreads: Threaded rendering is not supported "
+           "on this platform.\n");
+    return;
+#endif
+
+    numrenderthreads = atoi(myargv[p + 1]);
+
+    if (numrenderthreads <= 0)
+    {
+        numrenderthreads = I_GetCPUCount();
+    }
+
+    if (numrenderthreads > MAXRENDERTHREADS)
+    {
+        numrenderthreads = MAXRENDERTHREADS;
+    }
+
+    if (numrenderthreads <= 1)
+    {
+        numrenderthreads = 1;
+        return;
+    }
+
+    cache_mutex = I_CreateMutex();
+
+    for (i = 1; i < numrenderthreads; ++i)
+    {
+        M_snprintf(name, sizeof(name), "render%i", i);
+        renderthreads[i].start = I_CreateSemaphore(0);
+        renderthreads[i].done = I_CreateSemaphore(0);
+        renderthreads[i].thread = I_CreateThread(name, RenderThread,
+                                                 &renderthreads[i]);
+    }
+
+    I_AtExit(ShutdownRenderThreads, false);
+
+    printf("R_InitRenderThreads: Drawing with %i threads.\n",
+           numrenderthreads);
+}
+
+void R_RenderThreaded (player_t* player)
+{
+    int i;
+
+    for (i = 0; i < numrenderthreads; ++i)
+    {
+        renderthreads[i].x1 = (viewwidth * i) / numrenderthreads;
+        renderthreads[i].x2 = (viewwidth * (i + 1)) / numrenderthreads - 1;
+    }
+
+    frame_player = player;
+    frame_fuzzpos = fuzzpos;
+
+    // Nothing can be purged from the zone while other threads may
+    // be drawing from cached textures, flats and sprites.  A frame
+    // that needs more than the free memory ends in I_Error.
+    Z_EnablePurging(false);
+
+    for (i = 1; i < numrenderthreads; ++i)
+    {
+        I_SemaphorePost(renderthreads[i].start);
+    }
+
+    R_RenderViewStrip (renderthreads[0].x1, renderthreads[0].x2);
+
+    for (i = 1; i < numrenderthreads; ++i)
+    {
+        I_SemaphoreWait(renderthreads[i].done);
+    }
+
+    R_MarkMappedLines();
+    Z_EnablePurging(true);
+}
+
+void R_LockCache (void)
+{
+    if (cache_mutex != NULL)
+    {
+        I_LockMutex(cache_mutex);
+    }
+}
+
+void R_UnlockCache (void)
+{
+    if (cache_mutex != NULL)
+    {
+        I_UnlockMutex(cache_mutex);
+    }
+}
+
@@ -0,0 +1,39 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Drawing the view with several threads.
+//
+
+
+#ifndef __R_THREAD__
+#define __R_THREAD__
+
+#include "d_player.h"
+
+// Number of threads drawing the view; 1 unless -renderthreads is used.
+extern int		numrenderthreads;
+
+// Called by R_Init.
+void R_InitRenderThreads (void);
+
+// Draws the view set up by R_SetupFrame, split into vertical
+// strips that are drawn in parallel.
+void R_RenderThreaded (player_t* player);
+
+// The texture, flat and sprite caches may be loaded into from
+// any thread, so access to them must be locked.
+void R_LockCache (void);
+void R_UnlockCache (void);
+
+#endif
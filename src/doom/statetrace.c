@@ -0,0 +1,367 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Per-tic game state digests, for tracking down desyncs.  With
+//     -statetrace, a record of hashes of the play simulation state is
+//     written to a file after every tic.  -statediff compares two such
+//     traces and reports the first tic and field at which they differ.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "d_loop.h"
+#include "i_system.h"
+#include "m_argv.h"
+
+#include "p_local.h"
+#include "r_state.h"
+
+#include "statetrace.h"
+
+#define TRACE_MAGIC "DTRC"
+#define TRACE_VERSION 1
+
+// Each record in a trace holds the tic number followed by one hash for
+// each of these fields.  The hashes are grouped so that a difference
+// points at the part of the simulation that went wrong.
+
+typedef enum
+{
+    FIELD_RNG,
+    FIELD_PLAYERS,
+    FIELD_MOBJCOUNT,
+    FIELD_POSITIONS,
+    FIELD_MOMENTA,
+    FIELD_HEALTH,
+    FIELD_SECTORS,
+    NUM_TRACE_FIELDS
+} tracefield_t;
+
+static const char *field_names[NUM_TRACE_FIELDS] =
+{
+    "rng index",
+    "player state",
+    "mobj count",
+    "mobj positions",
+    "mobj momenta",
+    "mobj health",
+    "sector heights",
+};
+
+extern int prndindex;
+
+static FILE *trace_file = NULL;
+
+// 32-bit FNV-1a, fed with a 32-bit value at a time.  Much faster than
+// SHA1 and good enough to tell apart two game states.
+
+#define FNV_OFFSET_BASIS 0x811c9dc5U
+#define FNV_PRIME        0x01000193U
+
+static unsigned int HashInt32(unsigned int hash, unsigned int val)
+{
+    hash = (hash ^ (val & 0xff)) * FNV_PRIME;
+    hash = (hash ^ ((val >> 8) & 0xff)) * FNV_PRIME;
+    hash = (hash ^ ((val >> 16) & 0xff)) * FNV_PRIME;
+    hash = (hash ^ ((val >> 24) & 0xff)) * FNV_PRIME;
+
+    return hash;
+}
+
+static void WriteInt32(FILE *stream, unsigned int val)
+{
+    byte buf[4];
+
+    buf[0] = val & 0xff;
+    buf[1] = (val >> 8) & 0xff;
+    buf[2] = (val >> 16) & 0xff;
+    buf[3] = (val >> 24) & 0xff;
+
+    fwrite(buf, 1, 4, stream);
+}
+
+static boolean ReadInt32(FILE *stream, unsigned int *val)
+{
+    byte buf[4];
+
+    if (fread(buf, 1, 4, stream) != 4)
+    {
+        return false;
+    }
+
+    *val = buf[0] | (buf[1] << 8) | (buf[2] << 16)
+         | ((unsigned int) buf[3] << 24);
+
+    return true;
+}
+
+static void CalculateFields(unsigned int *fields)
+{
+    thinker_t *th;
+    mobj_t *mo;
+    player_t *player;
+    int i;
+
+    fields[FIELD_RNG] = prndindex;
+
+    for (i = FIELD_PLAYERS; i < NUM_TRACE_FIELDS; ++i)
+    {
+        fields[i] = FNV_OFFSET_BASIS;
+    }
+
+    fields[FIELD_MOBJCOUNT] = 0;
+
+    for (i = 0; i < MAXPLAYERS; ++i)
+    {
+        if (!playeringame[i])
+        {
+            continue;
+        }
+
+        player = &players[i];
+
+        fields[FIELD_PLAYERS] = HashInt32(fields[FIELD_PLAYERS],
+                                          player->playerstate);
+        fields[FIELD_PLAYERS] = HashInt32(fields[FIELD_PLAYERS],
+                                          player->health);
+        fields[FIELD_PLAYERS] = HashInt32(fields[FIELD_PLAYERS],
+                                          player->armorpoints);
+        fields[FIELD_PLAYERS] = HashInt32(fields[FIELD_PLAYERS],
+                                          player->armortype);
+        fields[FIELD_PLAYERS] = HashInt32(fields[FIELD_PLAYERS],
+                                          player->readyweapon);
+        fields[FIELD_PLAYERS] = HashInt32(fields[FIELD_PLAYERS],
+                                          player->pendingweapon);
+        fields[FIELD_PLAYERS] = HashInt32(fields[FIELD_PLAYERS],
+                                          player->viewz);
+    }
+
+    if (gamestate != GS_LEVEL)
+    {
+        return;
+    }
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+    {
+        if (th->function.acp1 != (actionf_p1) P_MobjThinker)
+        {
+            continue;
+        }
+
+        mo = (mobj_t *) th;
+
+        ++fields[FIELD_MOBJCOUNT];
+
+        fields[FIELD_POSITIONS] = HashInt32(fields[FIELD_POSITIONS], mo->x);
+        fields[FIELD_POSITIONS] = HashInt32(fields[FIELD_POSITIONS], mo->y);
+        fields[FIELD_POSITIONS] = HashInt32(fields[FIELD_POSITIONS], mo->z);
+        fields[FIELD_POSITIONS] = HashInt32(fields[FIELD_POSITIONS],
+                                            mo->angle);
+        fields[FIELD_MOMENTA] = HashInt32(fields[FIELD_MOMENTA], mo->momx);
+        fields[FIELD_MOMENTA] = HashInt32(fields[FIELD_MOMENTA], mo->momy);
+        fields[FIELD_MOMENTA] = HashInt32(fields[FIELD_MOMENTA], mo->momz);
+        fields[FIELD_HEALTH] = HashInt32(fields[FIELD_HEALTH], mo->health);
+    }
+
+    for (i = 0; i < numsectors; ++i)
+    {
+        fields[FIELD_SECTORS] = HashInt32(fields[FIELD_SECTORS],
+                                          sectors[i].floorheight);
+        fields[FIELD_SECTORS] = HashInt32(fields[FIELD_SECTORS],
+                                          sectors[i].ceilingheight);
+    }
+}
+
+static void StateTraceClose(void)
+{
+    if (trace_file != NULL)
+    {
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+}
+
+void StateTraceInit(void)
+{
+    int p;
+
+    //!
+    // @arg <filename>
+    // @category demo
+    //
+    // Write a compact binary trace of the game state to the given
+    // file, with a digest of the RNG, players, map objects and sectors
+    // after every tic.  Use -statediff to compare two traces.
+    //
+
+    p = M_CheckParmWithArgs("-statetrace", 1);
+
+    if (p == 0)
+    {
+        return;
+    }
+
+    trace_file = fopen(myargv[p + 1], "wb");
+
+    if (trace_file == NULL)
+    {
+        I_Error("StateTraceInit: Unable to open %s for writing",
+                myargv[p + 1]);
+    }
+
+    fwrite(TRACE_MAGIC, 1, 4, trace_file);
+    WriteInt32(trace_file, TRACE_VERSION);
+    WriteInt32(trace_file, NUM_TRACE_FIELDS);
+
+    I_AtExit(StateTraceClose, true);
+}
+
+void StateTraceTic(void)
+{
+    unsigned int fields[NUM_TRACE_FIELDS];
+    int i;
+
+    if (trace_file == NULL)
+    {
+        return;
+    }
+
+    CalculateFields(fields);
+
+    WriteInt32(trace_file, gametic);
+
+    for (i = 0; i < NUM_TRACE_FIELDS; ++i)
+    {
+        WriteInt32(trace_file, fields[i]);
+    }
+}
+
+static FILE *OpenTrace(const char *filename)
+{
+    FILE *stream;
+    char magic[4];
+    unsigned int version, num_fields;
+
+    stream = fopen(filename, "rb");
+
+    if (stream == NULL)
+    {
+        I_Error("StateTraceDiff: Unable to open %s", filename);
+    }
+
+    if (fread(magic, 1, 4, stream) != 4
+     || memcmp(magic, TRACE_MAGIC, 4) != 0
+     || !ReadInt32(stream, &version) || version != TRACE_VERSION
+     || !ReadInt32(stream, &num_fields) || num_fields != NUM_TRACE_FIELDS)
+    {
+        I_Error("StateTraceDiff: %s is not a state trace file", filename);
+    }
+
+    return stream;
+}
+
+static boolean ReadRecord(FILE *stream, unsigned int *tic,
+                          unsigned int *fields)
+{
+    int i;
+
+    if (!ReadInt32(stream, tic))
+    {
+        return false;
+    }
+
+    for (i = 0; i < NUM_TRACE_FIELDS; ++i)
+    {
+        if (!ReadInt32(stream, &fields[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+boolean StateTraceDiff(const char *filename1, const char *filename2)
+{
+    FILE *trace1, *trace2;
+    unsigned int fields1[NUM_TRACE_FIELDS], fields2[NUM_TRACE_FIELDS];
+    unsigned int tic1, tic2;
+    boolean have1, have2;
+    boolean result = true;
+    int records = 0;
+    int i;
+
+    trace1 = OpenTrace(filename1);
+    trace2 = OpenTrace(filename2);
+
+    for (;;)
+    {
+        have1 = ReadRecord(trace1, &tic1, fields1);
+        have2 = ReadRecord(trace2, &tic2, fields2);
+
+        if (!have1 || !have2)
+        {
+            if (have1 != have2)
+            {
+                printf("Traces differ in length: %s ends after %i tics.\n",
+                       have1 ? filename2 : filename1, records);
+                result = false;
+            }
+            break;
+        }
+
+        if (tic1 != tic2)
+        {
+            printf("Traces out of step at record %i: tic %u vs. tic %u.\n",
+                   records, tic1, tic2);
+            result = false;
+            break;
+        }
+
+        for (i = 0; i < NUM_TRACE_FIELDS; ++i)
+        {
+            if (fields1[i] != fields2[i])
+            {
+                printf("First divergence at tic %u: %s "
+                       "(%08x vs. %08x).\n",
+                       tic1, field_names[i], fields1[i], fields2[i]);
+                result = false;
+                break;
+            }
+        }
+
+        if (!result)
+        {
+            break;
+        }
+
+        ++records;
+    }
+
+    if (result)
+    {
+        printf("Traces are identical (%i tics).\n", records);
+    }
+
+    fclose(trace1);
+    fclose(trace2);
+
+    return result;
+}
+
@@ -0,0 +1,37 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Per-tic game state digests, for tracking down desyncs.
+//
+
+#ifndef __STATETRACE__
+#define __STATETRACE__
+
+#include "doomtype.h"
+
+// Open the trace file if -statetrace was given.
+
+void StateTraceInit(void);
+
+// Append a record for the current tic; called at the end of G_Ticker.
+
+void StateTraceTic(void);
+
+// Compare two trace files, printing the first point at which they
+// diverge.  Returns true if they are identical.
+
+boolean StateTraceDiff(const char *filename1, const char *filename2);
+
+#endif
+
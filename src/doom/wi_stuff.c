@@ -28,6 +28,7 @@
 #include "i_swap.h"
 #include "i_system.h"
 
+#include "w_prefetch.h"
 #include "w_wad.h"
 
 #include "g_game.h"
@@ -1819,10 +1820,37 @@ void WI_initVariables(wbstartstruct_t* wbstartstruct)
 	wbs->epsd -= 3;
 }
 
+//
+// Start reading the next map in the background while the
+// intermission is shown.
+//
+static void WI_prefetchNextMap(void)
+{
+    char	lumpname[9];
+    int		map;
+
+    map = wbs->next + 1;
+
+    if (gamemode == commercial)
+    {
+	if (map<10)
+	    DEH_snprintf(lumpname, 9, "map0%i", map);
+	else
+	    DEH_snprintf(lumpname, 9, "map%i", map);
+    }
+    else
+    {
+	M_snprintf(lumpname, sizeof(lumpname), "E%iM%i", wbs->epsd + 1, map);
+    }
+
+    W_PrefetchMap(lumpname);
+}
+
 void WI_Start(wbstartstruct_t* wbstartstruct)
 {
     WI_initVariables(wbstartstruct);
     WI_loadData();
+    WI_prefetchNextMap();
 
     if (deathmatch)
 	WI_initDeathmatchStats();
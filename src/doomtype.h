@@ -90,6 +90,19 @@
 
 #define PACKED_STRUCT(...) PACKEDPREFIX struct __VA_ARGS__ PACKEDATTR
 
+// Thread-local storage.  HAVE_THREADLOCAL is defined if the compiler
+// supports it; otherwise THREADLOCAL variables are ordinary globals.
+
+#if defined(_MSC_VER)
+#define THREADLOCAL __declspec(thread)
+#define HAVE_THREADLOCAL
+#elif defined(__GNUC__) && !defined(__vita__)
+#define THREADLOCAL __thread
+#define HAVE_THREADLOCAL
+#else
+#define THREADLOCAL
+#endif
+
 // C99 integer types; with gcc we just use this.  Other compilers
 // should add conditional statements that define the C99 types.
 
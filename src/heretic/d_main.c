@@ -1094,6 +1094,8 @@ void D_DoomMain(void)
     SB_Init();
     IncThermo();
 
+    W_EndStartup();
+
 //
 // start the apropriate game based on parms
 //
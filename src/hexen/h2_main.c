@@ -513,6 +513,8 @@ void D_DoomMain(void)
 
     ST_Done();
 
+    W_EndStartup();
+
     if (autostart)
     {
         ST_Message("Warp to Map %d (\"%s\":%d), Skill %d\n",
@@ -841,51 +841,53 @@ void R_DrawPlayerSprites(void)
 
 vissprite_t vsprsortedhead;
 
+static vissprite_t *vsprsortbuf[MAXVISSPRITES];
+
+// Order vissprites by increasing scale.  Vanilla used a selection sort
+// that picks the first of several sprites with equal scale, so ties are
+// broken by position in the vissprites array to draw in the same order.
+
+static int CompareVisSprites(const void *a, const void *b)
+{
+    const vissprite_t *spr1 = *(const vissprite_t **) a;
+    const vissprite_t *spr2 = *(const vissprite_t **) b;
+
+    if (spr1->scale != spr2->scale)
+    {
+        return spr1->scale < spr2->scale ? -1 : 1;
+    }
+
+    return spr1 < spr2 ? -1 : spr1 > spr2;
+}
+
 void R_SortVisSprites(void)
 {
     int i, count;
-    vissprite_t *ds, *best;
-    vissprite_t unsorted;
-    fixed_t bestscale;
+    vissprite_t *ds;
 
     count = vissprite_p - vissprites;
 
-    unsorted.next = unsorted.prev = &unsorted;
+    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
     if (!count)
         return;
 
-    for (ds = vissprites; ds < vissprite_p; ds++)
+    for (i = 0; i < count; i++)
     {
-        ds->next = ds + 1;
-        ds->prev = ds - 1;
+        vsprsortbuf[i] = &vissprites[i];
     }
-    vissprites[0].prev = &unsorted;
-    unsorted.next = &vissprites[0];
-    (vissprite_p - 1)->next = &unsorted;
-    unsorted.prev = vissprite_p - 1;
+
+    qsort(vsprsortbuf, count, sizeof(*vsprsortbuf), CompareVisSprites);
 
 //
-// pull the vissprites out by scale
+// link the vissprites in sorted order
 //
-    best = 0;                   // shut up the compiler warning
-    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
     for (i = 0; i < count; i++)
     {
-        bestscale = INT_MAX;
-        for (ds = unsorted.next; ds != &unsorted; ds = ds->next)
-        {
-            if (ds->scale < bestscale)
-            {
-                bestscale = ds->scale;
-                best = ds;
-            }
-        }
-        best->next->prev = best->prev;
-        best->prev->next = best->next;
-        best->next = &vsprsortedhead;
-        best->prev = vsprsortedhead.prev;
-        vsprsortedhead.prev->next = best;
-        vsprsortedhead.prev = best;
+        ds = vsprsortbuf[i];
+        ds->next = &vsprsortedhead;
+        ds->prev = vsprsortedhead.prev;
+        vsprsortedhead.prev->next = ds;
+        vsprsortedhead.prev = ds;
     }
 }
 
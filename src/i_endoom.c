@@ -37,6 +37,13 @@ void I_Endoom(byte *endoom_data)
     int y;
     int indent;
 
+    // There is no window to show it in.
+
+    if (offscreen_mode)
+    {
+        return;
+    }
+
     // Set up text mode screen
 
     TXT_Init();
@@ -35,8 +35,8 @@ static boolean pcs_initialized = false;
 static SDL_mutex *sound_lock;
 static boolean use_sfx_prefix;
 
-static uint8_t *current_sound_lump = NULL;
-static uint8_t *current_sound_pos = NULL;
+static const uint8_t *current_sound_lump = NULL;
+static const uint8_t *current_sound_pos = NULL;
 static unsigned int current_sound_remaining = 0;
 static int current_sound_handle = 0;
 static int current_sound_lump_num = -1;
@@ -118,7 +118,7 @@ static boolean CachePCSLump(sfxinfo_t *sfxinfo)
 
     // Load from WAD
 
-    current_sound_lump = W_CacheLumpNum(sfxinfo->lumpnum, PU_STATIC);
+    current_sound_lump = W_CacheLumpNumConst(sfxinfo->lumpnum, PU_STATIC);
     lumplen = W_LumpLength(sfxinfo->lumpnum);
 
     // Read header
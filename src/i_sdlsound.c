@@ -65,7 +65,7 @@ static Uint16 mixer_format;
 static int mixer_channels;
 static boolean use_sfx_prefix;
 static boolean (*ExpandSoundData)(sfxinfo_t *sfxinfo,
-                                  byte *data,
+                                  const byte *data,
                                   int samplerate,
                                   int length) = NULL;
 
@@ -397,7 +397,7 @@ static int SRC_ConversionMode(void)
 // DWF 2008-02-10 with cleanups by Simon Howard.
 
 static boolean ExpandSoundData_SRC(sfxinfo_t *sfxinfo,
-                                   byte *data,
+                                   const byte *data,
                                    int samplerate,
                                    int length)
 {
@@ -595,7 +595,7 @@ static void WriteWAV(char *filename, byte *data,
 // Returns number of clipped samples (always 0).
 
 static boolean ExpandSoundData_SDL(sfxinfo_t *sfxinfo,
-                                   byte *data,
+                                   const byte *data,
                                    int samplerate,
                                    int length)
 {
@@ -717,12 +717,12 @@ static boolean CacheSFX(sfxinfo_t *sfxinfo)
     unsigned int lumplen;
     int samplerate;
     unsigned int length;
-    byte *data;
+    const byte *data;
 
     // need to load the sound
 
     lumpnum = sfxinfo->lumpnum;
-    data = W_CacheLumpNum(lumpnum, PU_STATIC);
+    data = W_CacheLumpNumConst(lumpnum, PU_STATIC);
     lumplen = W_LumpLength(lumpnum);
 
     // Check the header, and ensure this is a valid sound
@@ -0,0 +1,150 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Threads, mutexes and semaphores, implemented with SDL.
+//
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include "i_system.h"
+#include "i_thread.h"
+
+i_thread_t *I_CreateThread(const char *name, i_threadfunc_t func, void *data)
+{
+    SDL_Thread *thread;
+
+    thread = SDL_CreateThread(func, name, data);
+
+    if (thread == NULL)
+    {
+        I_Error("I_CreateThread: Failed to create thread: %s",
+                SDL_GetError());
+    }
+
+    return (i_thread_t *) thread;
+}
+
+int I_WaitThread(i_thread_t *thread)
+{
+    int result;
+
+    SDL_WaitThread((SDL_Thread *) thread, &result);
+
+    return result;
+}
+
+int I_GetCPUCount(void)
+{
+    return SDL_GetCPUCount();
+}
+
+i_mutex_t *I_CreateMutex(void)
+{
+    SDL_mutex *mutex;
+
+    mutex = SDL_CreateMutex();
+
+    if (mutex == NULL)
+    {
+        I_Error("I_CreateMutex: Failed to create mutex: %s", SDL_GetError());
+    }
+
+    return (i_mutex_t *) mutex;
+}
+
+void I_DestroyMutex(i_mutex_t *mutex)
+{
+    SDL_DestroyMutex((SDL_mutex *) mutex);
+}
+
+void I_LockMutex(i_mutex_t *mutex)
+{
+    SDL_LockMutex((SDL_mutex *) mutex);
+}
+
+void I_UnlockMutex(i_mutex_t *mutex)
+{
+    SDL_UnlockMutex((SDL_mutex *) mutex);
+}
+
+i_semaphore_t *I_CreateSemaphore(int value)
+{
+    SDL_sem *sem;
+
+    sem = SDL_CreateSemaphore(value);
+
+    if (sem == NULL)
+    {
+        I_Error("I_CreateSemaphore: Failed to create semaphore: %s",
+                SDL_GetError());
+    }
+
+    return (i_semaphore_t *) sem;
+}
+
+void I_DestroySemaphore(i_semaphore_t *sem)
+{
+    SDL_DestroySemaphore((SDL_sem *) sem);
+}
+
+void I_SemaphorePost(i_semaphore_t *sem)
+{
+    SDL_SemPost((SDL_sem *) sem);
+}
+
+void I_SemaphoreWait(i_semaphore_t *sem)
+{
+    SDL_SemWait((SDL_sem *) sem);
+}
+
+i_cond_t *I_CreateCond(void)
+{
+    SDL_cond *cond;
+
+    cond = SDL_CreateCond();
+
+    if (cond == NULL)
+    {
+        I_Error("I_CreateCond: Failed to create condition variable: %s",
+                SDL_GetError());
+    }
+
+    return (i_cond_t *) cond;
+}
+
+void I_DestroyCond(i_cond_t *cond)
+{
+    SDL_DestroyCond((SDL_cond *) cond);
+}
+
+void I_CondWait(i_cond_t *cond, i_mutex_t *mutex)
+{
+    SDL_CondWait((SDL_cond *) cond, (SDL_mutex *) mutex);
+}
+
+void I_CondBroadcast(i_cond_t *cond)
+{
+    SDL_CondBroadcast((SDL_cond *) cond);
+}
+
+void I_MemoryBarrierRelease(void)
+{
+    SDL_MemoryBarrierRelease();
+}
+
+void *I_AtomicGetPtr(void **ptr)
+{
+    return SDL_AtomicGetPtr(ptr);
+}
@@ -0,0 +1,63 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      System-specific threads, mutexes and semaphores.
+//
+
+
+#ifndef __I_THREAD__
+#define __I_THREAD__
+
+typedef struct i_thread_s i_thread_t;
+typedef struct i_mutex_s i_mutex_t;
+typedef struct i_semaphore_s i_semaphore_t;
+typedef struct i_cond_s i_cond_t;
+
+typedef int (*i_threadfunc_t)(void *data);
+
+// Start a new thread running the given function.
+i_thread_t *I_CreateThread(const char *name, i_threadfunc_t func, void *data);
+
+// Wait for a thread to finish, returning its result.
+int I_WaitThread(i_thread_t *thread);
+
+// Number of CPU cores available.
+int I_GetCPUCount(void);
+
+i_mutex_t *I_CreateMutex(void);
+void I_DestroyMutex(i_mutex_t *mutex);
+void I_LockMutex(i_mutex_t *mutex);
+void I_UnlockMutex(i_mutex_t *mutex);
+
+i_semaphore_t *I_CreateSemaphore(int value);
+void I_DestroySemaphore(i_semaphore_t *sem);
+void I_SemaphorePost(i_semaphore_t *sem);
+void I_SemaphoreWait(i_semaphore_t *sem);
+
+// Condition variables.  I_CondWait must be called with the mutex
+// locked; it unlocks it while waiting.
+i_cond_t *I_CreateCond(void);
+void I_DestroyCond(i_cond_t *cond);
+void I_CondWait(i_cond_t *cond, i_mutex_t *mutex);
+void I_CondBroadcast(i_cond_t *cond);
+
+// Pointers to data shared without a lock.  The writer fills in the
+// data, calls I_MemoryBarrierRelease and then stores the pointer.  The
+// reader loads the pointer with I_AtomicGetPtr, which guarantees that
+// it sees the data as well.
+void I_MemoryBarrierRelease(void);
+void *I_AtomicGetPtr(void **ptr);
+
+#endif
+
@@ -58,6 +58,23 @@ int I_GetTimeMS(void)
     return ticks - basetime;
 }
 
+//
+// Time in microseconds from the high resolution counter, which is
+// only useful for measuring intervals.
+//
+
+uint64_t I_GetTimeUS(void)
+{
+    Uint64 counter, freq;
+
+    counter = SDL_GetPerformanceCounter();
+    freq = SDL_GetPerformanceFrequency();
+
+    // Split the division so that the multiply cannot overflow.
+    return (counter / freq) * 1000000
+         + ((counter % freq) * 1000000) / freq;
+}
+
 // Sleep for a specified number of ms
 
 void I_Sleep(int ms)
@@ -17,7 +17,9 @@
 //
 
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDL.h"
 #include "SDL_opengl.h"
@@ -29,6 +31,13 @@
 #include <windows.h>
 #endif
 
+// The palette conversion has an AVX2 version for x86 with GCC or
+// Clang, chosen at run time if the CPU supports it.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define HAVE_SIMD_BLIT
+#include <immintrin.h>
+#endif
+
 #include "icon.c"
 
 #include "config.h"
@@ -43,6 +52,7 @@
 #include "m_argv.h"
 #include "m_config.h"
 #include "m_misc.h"
+#include "m_profile.h"
 #include "tables.h"
 #include "v_diskicon.h"
 #include "v_video.h"
@@ -65,12 +75,44 @@ static const char *window_title = "";
 // load the RGBA buffer to and that we render into another texture (4) which
 // is upscaled by an integer factor UPSCALE using "nearest" scaling and which
 // in turn is finally rendered to screen using "linear" scaling.
+//
+// When the texture is 32 bits per pixel, the RGBA buffer is skipped:
+// the paletted buffer is converted straight into the locked texture
+// through a lookup table, and only the rows that have changed since
+// the last frame are converted.  With the software renderer, the
+// upscaled texture is a streaming texture as well, and the CPU writes
+// the upscaled pixels to it directly instead of rendering into it.
 
 static SDL_Surface *screenbuffer = NULL;
 static SDL_Surface *argbbuffer = NULL;
 static SDL_Texture *texture = NULL;
 static SDL_Texture *texture_upscaled = NULL;
 
+// Use the direct conversion described above?
+
+static boolean fast_blit = false;
+static boolean cpu_upscale = false;
+
+// Factors by which the upscaled texture is larger than the screen.
+
+static int upscale_w = 1, upscale_h = 1;
+
+// The palette in the pixel format of the texture.
+
+static uint32_t palette_pixels[256];
+
+// The frame last converted into the texture, and whether all of it
+// must be converted next time anyway.
+
+static pixel_t last_frame[SCREENWIDTH * SCREENHEIGHT];
+static boolean full_update = true;
+
+// A converted row before it is upscaled.
+
+static uint32_t row_pixels[SCREENWIDTH];
+
+static void (*convert_row)(uint32_t *dest, const pixel_t *src, int count);
+
 static SDL_Rect blit_rect = {
     0,
     0,
@@ -164,6 +206,17 @@ pixel_t *I_VideoBuffer = NULL;
 
 boolean screensaver_mode = false;
 
+// If true, no window is opened and the screen is only drawn to
+// I_VideoBuffer, for capturing frames.
+
+boolean offscreen_mode = false;
+
+// Frames captured with -framedump and -framepng.
+
+static FILE *frame_dump = NULL;
+static int frame_png_interval = 0;
+static int frame_count = 0;
+
 // Flag indicating whether the screen is currently visible:
 // when the screen isnt visible, don't render the screen
 
@@ -267,11 +320,20 @@ static void SetShowCursor(boolean show)
 
 void I_ShutdownGraphics(void)
 {
+    if (frame_dump != NULL)
+    {
+        fclose(frame_dump);
+        frame_dump = NULL;
+    }
+
     if (initialized)
     {
-        SetShowCursor(true);
+        if (!offscreen_mode)
+        {
+            SetShowCursor(true);
 
-        SDL_QuitSubSystem(SDL_INIT_VIDEO);
+            SDL_QuitSubSystem(SDL_INIT_VIDEO);
+        }
 
         initialized = false;
     }
@@ -676,12 +738,16 @@ static void CreateUpscaledTexture(boolean force)
 
     new_texture = SDL_CreateTexture(renderer,
                                 pixel_format,
-                                SDL_TEXTUREACCESS_TARGET,
+                                cpu_upscale ? SDL_TEXTUREACCESS_STREAMING
+                                            : SDL_TEXTUREACCESS_TARGET,
                                 w_upscale*SCREENWIDTH,
                                 h_upscale*SCREENHEIGHT);
 
     old_texture = texture_upscaled;
     texture_upscaled = new_texture;
+    upscale_w = w_upscale;
+    upscale_h = h_upscale;
+    full_update = true;
 
     if (old_texture != NULL)
     {
@@ -689,6 +755,215 @@ static void CreateUpscaledTexture(boolean force)
     }
 }
 
+static void ConvertRow(uint32_t *dest, const pixel_t *src, int count)
+{
+    while (count > 0)
+    {
+        *dest++ = palette_pixels[*src++];
+        --count;
+    }
+}
+
+#ifdef HAVE_SIMD_BLIT
+
+// Eight pixels at a time, with the palette entries fetched by a gather.
+
+__attribute__((target("avx2")))
+static void ConvertRowAVX2(uint32_t *dest, const pixel_t *src, int count)
+{
+    __m256i indexes;
+
+    while (count >= 8)
+    {
+        indexes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) src));
+        _mm256_storeu_si256((__m256i *) dest,
+                            _mm256_i32gather_epi32((const int *) palette_pixels,
+                                                   indexes, 4));
+        src += 8;
+        dest += 8;
+        count -= 8;
+    }
+
+    ConvertRow(dest, src, count);
+}
+
+#endif
+
+static void InitConvertRow(void)
+{
+    convert_row = ConvertRow;
+
+#ifdef HAVE_SIMD_BLIT
+    // -nosimd is documented with the span drawers in r_draw.c.
+
+    if (M_ParmExists("-nosimd"))
+    {
+        return;
+    }
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        convert_row = ConvertRowAVX2;
+    }
+#endif
+}
+
+// Convert the rows of the screen that have changed into the texture,
+// upscaling them if the CPU does the upscaling.
+
+static void BlitToTexture(void)
+{
+    SDL_Texture *dest_texture;
+    SDL_Rect rect;
+    byte *pixels;
+    uint32_t *dest;
+    const pixel_t *src;
+    int w_upscale, h_upscale;
+    int first, last;
+    int pitch;
+    int x, y, i;
+
+    first = 0;
+    last = SCREENHEIGHT - 1;
+
+    if (!full_update)
+    {
+        while (first <= last
+            && !memcmp(last_frame + first * SCREENWIDTH,
+                       I_VideoBuffer + first * SCREENWIDTH, SCREENWIDTH))
+        {
+            ++first;
+        }
+
+        if (first > last)
+        {
+            return;
+        }
+
+        while (!memcmp(last_frame + last * SCREENWIDTH,
+                       I_VideoBuffer + last * SCREENWIDTH, SCREENWIDTH))
+        {
+            --last;
+        }
+    }
+
+    if (cpu_upscale)
+    {
+        dest_texture = texture_upscaled;
+        w_upscale = upscale_w;
+        h_upscale = upscale_h;
+    }
+    else
+    {
+        dest_texture = texture;
+        w_upscale = 1;
+        h_upscale = 1;
+    }
+
+    // Only the changed rows are locked; the rest of the texture keeps
+    // what it had.
+
+    rect.x = 0;
+    rect.y = first * h_upscale;
+    rect.w = SCREENWIDTH * w_upscale;
+    rect.h = (last - first + 1) * h_upscale;
+
+    if (SDL_LockTexture(dest_texture, &rect, (void **) &pixels, &pitch) != 0)
+    {
+        full_update = true;
+        return;
+    }
+
+    for (y = first; y <= last; ++y)
+    {
+        src = I_VideoBuffer + y * SCREENWIDTH;
+        dest = (uint32_t *) pixels;
+
+        if (w_upscale == 1)
+        {
+            convert_row(dest, src, SCREENWIDTH);
+        }
+        else
+        {
+            convert_row(row_pixels, src, SCREENWIDTH);
+
+            for (x = 0; x < SCREENWIDTH; ++x)
+            {
+                for (i = 0; i < w_upscale; ++i)
+                {
+                    *dest++ = row_pixels[x];
+                }
+            }
+        }
+
+        for (i = 1; i < h_upscale; ++i)
+        {
+            memcpy(pixels + i * pitch, pixels, rect.w * sizeof(uint32_t));
+        }
+
+        pixels += h_upscale * pitch;
+    }
+
+    SDL_UnlockTexture(dest_texture);
+
+    memcpy(last_frame + first * SCREENWIDTH, I_VideoBuffer + first * SCREENWIDTH,
+           (last - first + 1) * SCREENWIDTH * sizeof(pixel_t));
+    full_update = false;
+}
+
+// Write the screen to the frame dump, and every frame_png_interval
+// frames to a PNG file.
+
+static void CaptureFrame(void)
+{
+    static byte rgb[SCREENWIDTH * SCREENHEIGHT * 3];
+    SDL_Color *color;
+    byte *p;
+    int i;
+
+    if (frame_dump != NULL)
+    {
+        p = rgb;
+
+        for (i = 0; i < SCREENWIDTH * SCREENHEIGHT; ++i)
+        {
+            color = &palette[I_VideoBuffer[i]];
+            *p++ = color->r;
+            *p++ = color->g;
+            *p++ = color->b;
+        }
+
+        if (fwrite(rgb, sizeof(rgb), 1, frame_dump) < 1)
+        {
+            printf("CaptureFrame: Failed to write frame %d, "
+                   "no more frames will be written.\n", frame_count);
+            fclose(frame_dump);
+            frame_dump = NULL;
+        }
+    }
+
+#ifdef HAVE_LIBPNG
+    if (frame_png_interval > 0 && frame_count % frame_png_interval == 0)
+    {
+        char filename[20];
+
+        for (i = 0; i < 256; ++i)
+        {
+            rgb[i * 3] = palette[i].r;
+            rgb[i * 3 + 1] = palette[i].g;
+            rgb[i * 3 + 2] = palette[i].b;
+        }
+
+        M_snprintf(filename, sizeof(filename), "frame%06d.png", frame_count);
+        WritePNGfile(filename, I_VideoBuffer, SCREENWIDTH, SCREENHEIGHT, rgb);
+    }
+#endif
+
+    ++frame_count;
+}
+
 //
 // I_FinishUpdate
 //
@@ -731,7 +1006,10 @@ void I_FinishUpdate (void)
         }
     }
 
-    UpdateGrab();
+    if (!offscreen_mode)
+    {
+        UpdateGrab();
+    }
 
 #if 0 // SDL2-TODO
     // Don't update the screen if the window isn't visible.
@@ -757,14 +1035,36 @@ void I_FinishUpdate (void)
 	    I_VideoBuffer[ (SCREENHEIGHT-1)*SCREENWIDTH + i] = 0x0;
     }
 
+    // Frames are captured without the disk icon and the profile graph,
+    // which depend on timing.
+
+    if (frame_dump != NULL || frame_png_interval > 0)
+    {
+        CaptureFrame();
+    }
+
+    if (offscreen_mode)
+    {
+        return;
+    }
+
     // Draw disk icon before blit, if necessary.
     V_DrawDiskIcon();
+    M_DrawProfileGraph();
 
     if (palette_to_set)
     {
         SDL_SetPaletteColors(screenbuffer->format->palette, palette, 0, 256);
         palette_to_set = false;
 
+        for (i = 0; i < 256; ++i)
+        {
+            palette_pixels[i] = SDL_MapRGB(argbbuffer->format, palette[i].r,
+                                           palette[i].g, palette[i].b);
+        }
+
+        full_update = true;
+
         if (vga_porch_flash)
         {
             // "flash" the pillars/letterboxes with palette changes, emulating
@@ -774,14 +1074,23 @@ void I_FinishUpdate (void)
         }
     }
 
-    // Blit from the paletted 8-bit screen buffer to the intermediate
-    // 32-bit RGBA buffer that we can load into the texture.
+    if (fast_blit)
+    {
+        BlitToTexture();
+    }
+    else
+    {
+        // Blit from the paletted 8-bit screen buffer to the intermediate
+        // 32-bit RGBA buffer that we can load into the texture.
 
-    SDL_LowerBlit(screenbuffer, &blit_rect, argbbuffer, &blit_rect);
+        SDL_LowerBlit(screenbuffer, &blit_rect, argbbuffer, &blit_rect);
 
-    // Update the intermediate texture with the contents of the RGBA buffer.
+        // Update the intermediate texture with the contents of the RGBA
+        // buffer.
 
-    SDL_UpdateTexture(texture, NULL, argbbuffer->pixels, argbbuffer->pitch);
+        SDL_UpdateTexture(texture, NULL, argbbuffer->pixels,
+                          argbbuffer->pitch);
+    }
 
     // Make sure the pillarboxes are kept clear each frame.
 
@@ -790,12 +1099,15 @@ void I_FinishUpdate (void)
     // Render this intermediate texture into the upscaled texture
     // using "nearest" integer scaling.
 
-    SDL_SetRenderTarget(renderer, texture_upscaled);
-    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    if (!cpu_upscale)
+    {
+        SDL_SetRenderTarget(renderer, texture_upscaled);
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_SetRenderTarget(renderer, NULL);
+    }
 
     // Finally, render this upscaled texture to screen using linear scaling.
 
-    SDL_SetRenderTarget(renderer, NULL);
     SDL_RenderCopy(renderer, texture_upscaled, NULL, NULL);
 
     // Draw!
@@ -804,6 +1116,7 @@ void I_FinishUpdate (void)
 
     // Restore background and undo the disk indicator, if it was drawn.
     V_RestoreDiskBackground();
+    M_RestoreProfileBackground();
 }
 
 
@@ -969,6 +1282,54 @@ void I_GraphicsCheckCommandLine(void)
 
     nomouse = M_CheckParm("-nomouse") > 0;
 
+    //!
+    // @category video
+    //
+    // Don't open a window; draw the screen offscreen only.  Use with
+    // -framedump or -framepng to capture what is drawn, and with
+    // -timedemo to capture every frame of a demo as fast as it can be
+    // rendered.
+    //
+
+    offscreen_mode = M_ParmExists("-offscreen");
+
+    //!
+    // @category video
+    // @arg <file>
+    //
+    // Write every frame to the given file or pipe, as raw 24-bit RGB
+    // at 320x200.
+    //
+
+    i = M_CheckParmWithArgs("-framedump", 1);
+
+    if (i > 0)
+    {
+        frame_dump = fopen(myargv[i + 1], "wb");
+
+        if (frame_dump == NULL)
+        {
+            I_Error("Failed to open %s for writing frames", myargv[i + 1]);
+        }
+    }
+
+#ifdef HAVE_LIBPNG
+    //!
+    // @category video
+    // @arg <n>
+    //
+    // Save every <n>th frame to the current directory as a PNG file,
+    // frame000000.png, frame000010.png and so on.
+    //
+
+    i = M_CheckParmWithArgs("-framepng", 1);
+
+    if (i > 0)
+    {
+        frame_png_interval = atoi(myargv[i + 1]);
+    }
+#endif
+
     //!
     // @category video
     // @arg <x>
@@ -1154,6 +1515,7 @@ static void SetVideoMode(void)
     int bpp;
     int window_flags = 0, renderer_flags = 0;
     SDL_DisplayMode mode;
+    SDL_RendererInfo rinfo;
 
     w = window_width;
     h = window_height;
@@ -1349,17 +1711,56 @@ static void SetVideoMode(void)
                                 SDL_TEXTUREACCESS_STREAMING,
                                 SCREENWIDTH, SCREENHEIGHT);
 
+    // The palette can be converted straight into a 32-bit texture.  The
+    // software renderer does its scaling on the CPU anyway, so it is
+    // quicker to write the upscaled pixels directly than to render the
+    // texture into the upscaled one.
+
+    fast_blit = SDL_BYTESPERPIXEL(pixel_format) == 4;
+    cpu_upscale = fast_blit
+               && SDL_GetRendererInfo(renderer, &rinfo) == 0
+               && (rinfo.flags & SDL_RENDERER_SOFTWARE) != 0;
+    full_update = true;
+    palette_to_set = true;
+
     // Initially create the upscaled texture for rendering to screen
 
     CreateUpscaledTexture(true);
 }
 
+// With -offscreen, the screen is a plain buffer and SDL video is
+// never started.
+
+static void InitOffscreen(void)
+{
+    I_VideoBuffer = Z_Malloc(SCREENWIDTH * SCREENHEIGHT * sizeof(*I_VideoBuffer),
+                             PU_STATIC, NULL);
+    V_RestoreBuffer();
+
+    memset(I_VideoBuffer, 0, SCREENWIDTH * SCREENHEIGHT * sizeof(*I_VideoBuffer));
+
+    I_SetPalette(W_CacheLumpName(DEH_String("PLAYPAL"), PU_CACHE));
+
+    // There is no window to take mouse input from.
+    nomouse = true;
+
+    initialized = true;
+
+    I_AtExit(I_ShutdownGraphics, true);
+}
+
 void I_InitGraphics(void)
 {
     SDL_Event dummy;
     byte *doompal;
     char *env;
 
+    if (offscreen_mode)
+    {
+        InitOffscreen();
+        return;
+    }
+
     // Pass through the XSCREENSAVER_WINDOW environment variable to 
     // SDL_WINDOWID, to embed the SDL window into the Xscreensaver
     // window.
@@ -1403,6 +1804,7 @@ void I_InitGraphics(void)
     // Create the game window; this may switch graphic modes depending
     // on configuration.
     AdjustWindowSize();
+    InitConvertRow();
     SetVideoMode();
 
     // Start with a clear black screen
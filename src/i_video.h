@@ -83,6 +83,7 @@ extern boolean screenvisible;
 
 extern int vanilla_keyboard_mapping;
 extern boolean screensaver_mode;
+extern boolean offscreen_mode;
 extern int usegamma;
 extern pixel_t *I_VideoBuffer;
 
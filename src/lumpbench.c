@@ -0,0 +1,229 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Lump lookup benchmark.  Loads the given WAD files and times
+//      W_CheckNumForName against the hash chains it used to walk,
+//      with a mix of upper and lower case names, some of which are
+//      missing.  Every result is checked against a backwards search
+//      of the lump directory.
+//
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "v_diskicon.h"
+
+#include "w_wad.h"
+#include "z_zone.h"
+
+#define NUM_NAMES   4096
+#define NUM_ROUNDS  2000
+
+// One name in this many is not in any WAD.
+#define MISS_RATE   8
+
+static char names[NUM_NAMES][9];
+
+// Hash chains through the lump directory, as W_CheckNumForName
+// used to search them.
+
+static lumpindex_t *chain_heads;
+static lumpindex_t *chain_next;
+
+// No disk icon is drawn while reading lumps.
+
+void V_BeginRead(size_t nbytes)
+{
+}
+
+static void GenerateChains(void)
+{
+    unsigned int hash;
+    lumpindex_t i;
+
+    chain_heads = malloc(numlumps * sizeof(lumpindex_t));
+    chain_next = malloc(numlumps * sizeof(lumpindex_t));
+
+    if (chain_heads == NULL || chain_next == NULL)
+    {
+        I_Error("GenerateChains: Out of memory");
+    }
+
+    for (i = 0; i < numlumps; ++i)
+    {
+        chain_heads[i] = -1;
+    }
+
+    for (i = 0; i < numlumps; ++i)
+    {
+        hash = W_LumpNameHash(lumpinfo[i]->name) % numlumps;
+        chain_next[i] = chain_heads[hash];
+        chain_heads[hash] = i;
+    }
+}
+
+static lumpindex_t ChainCheckNumForName(const char *name)
+{
+    lumpindex_t i;
+
+    for (i = chain_heads[W_LumpNameHash(name) % numlumps]; i != -1;
+         i = chain_next[i])
+    {
+        if (!strncasecmp(lumpinfo[i]->name, name, 8))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static lumpindex_t ScanCheckNumForName(const char *name)
+{
+    lumpindex_t i;
+
+    for (i = numlumps - 1; i >= 0; --i)
+    {
+        if (!strncasecmp(lumpinfo[i]->name, name, 8))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Pick names from the lump directory, as the game would pass them:
+// some in lower case, and some that are not there at all.
+
+static void GenerateNames(void)
+{
+    char *p;
+    int i;
+
+    srand(0);
+
+    for (i = 0; i < NUM_NAMES; ++i)
+    {
+        if (i % MISS_RATE == 0)
+        {
+            M_snprintf(names[i], sizeof(names[i]), "NONE%i", i);
+            continue;
+        }
+
+        M_StringCopy(names[i], lumpinfo[rand() % numlumps]->name,
+                     sizeof(names[i]));
+
+        if (i % 3 == 0)
+        {
+            for (p = names[i]; *p != '\0'; ++p)
+            {
+                *p = tolower(*p);
+            }
+        }
+    }
+}
+
+static void CheckNames(void)
+{
+    lumpindex_t want;
+    int i;
+
+    for (i = 0; i < NUM_NAMES; ++i)
+    {
+        want = ScanCheckNumForName(names[i]);
+
+        if (W_CheckNumForName(names[i]) != want
+         || ChainCheckNumForName(names[i]) != want)
+        {
+            I_Error("CheckNames: Wrong lump found for %s", names[i]);
+        }
+    }
+}
+
+static void Time(const char *name, lumpindex_t (*lookup)(const char *name))
+{
+    uint64_t start, end;
+    int sum = 0;
+    int r, i;
+
+    start = SDL_GetPerformanceCounter();
+
+    for (r = 0; r < NUM_ROUNDS; ++r)
+    {
+        for (i = 0; i < NUM_NAMES; ++i)
+        {
+            sum += lookup(names[i]);
+        }
+    }
+
+    end = SDL_GetPerformanceCounter();
+
+    // The sum is printed so that the lookups cannot be optimized out.
+
+    printf("%-10s %6.1f ns per lookup (%i)\n", name,
+           (end - start) * 1e9 / SDL_GetPerformanceFrequency()
+                         / ((double) NUM_ROUNDS * NUM_NAMES),
+           sum & 1);
+}
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    myargc = argc;
+    myargv = argv;
+
+    if (argc < 2)
+    {
+        printf("Usage: %s <wad file>...\n", argv[0]);
+        exit(-1);
+    }
+
+    Z_Init();
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (W_AddFile(argv[i]) == NULL)
+        {
+            I_Error("Unable to open %s", argv[i]);
+        }
+    }
+
+    if (numlumps == 0)
+    {
+        I_Error("No lumps in the given WAD files");
+    }
+
+    W_GenerateHashTable();
+    GenerateChains();
+    GenerateNames();
+    CheckNames();
+
+    printf("%i lumps, %i names, one in %i missing\n",
+           numlumps, NUM_NAMES, MISS_RATE);
+
+    Time("chains", ChainCheckNumForName);
+    Time("table", W_CheckNumForName);
+
+    return 0;
+}
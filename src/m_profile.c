@@ -0,0 +1,320 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Frame time profiler.  With -profile, the time spent in each
+//      part of the game loop is measured for every frame.  A graph
+//      of recent frames is drawn in the top right corner of the
+//      screen, and the times for each frame are written to a CSV
+//      file as the frame completes.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "i_system.h"
+#include "i_timer.h"
+#include "i_video.h"
+#include "m_argv.h"
+
+#include "m_profile.h"
+
+// Graph size and position, and the time shown by one pixel of
+// height, in microseconds.
+
+#define GRAPH_WIDTH  128
+#define GRAPH_HEIGHT 50
+#define GRAPH_X      (SCREENWIDTH - GRAPH_WIDTH)
+#define GRAPH_Y      0
+#define GRAPH_SCALE  1000
+
+// One tic, the time a frame has at the normal frame rate.
+#define FRAME_BUDGET (1000000 / TICRATE)
+
+typedef struct
+{
+    uint32_t total;
+    uint32_t sections[NUM_PROFILE_SECTIONS];
+} frametime_t;
+
+static const char *section_names[NUM_PROFILE_SECTIONS] =
+{
+    "bsp",
+    "planes",
+    "masked",
+    "ticker",
+    "sound",
+    "net",
+    "blit",
+};
+
+// Colors of each section in the graph, with the rest of the frame
+// at the end.
+static const byte section_rgb[NUM_PROFILE_SECTIONS + 1][3] =
+{
+    { 255,  64,  64 },
+    {  64, 255,  64 },
+    {  64,  64, 255 },
+    { 255, 255,   0 },
+    { 255,   0, 255 },
+    {   0, 255, 255 },
+    { 255, 128,   0 },
+    { 128, 128, 128 },
+};
+
+boolean profiling = false;
+
+static FILE *csv_stream = NULL;
+
+// The frames shown in the graph, as a ring buffer.
+static frametime_t frames[GRAPH_WIDTH];
+static int num_frames = 0;
+
+static frametime_t current;
+static uint64_t start_times[NUM_PROFILE_SECTIONS];
+static uint64_t frame_start;
+
+static int section_colors[NUM_PROFILE_SECTIONS + 1];
+static int background_color, budget_color;
+static boolean colors_set = false;
+
+static pixel_t saved_background[GRAPH_WIDTH * GRAPH_HEIGHT];
+static boolean graph_drawn = false;
+
+static void WriteCSVRow(frametime_t *frame)
+{
+    int i;
+
+    fprintf(csv_stream, "%i,%u", num_frames, frame->total);
+
+    for (i = 0; i < NUM_PROFILE_SECTIONS; ++i)
+    {
+        fprintf(csv_stream, ",%u", frame->sections[i]);
+    }
+
+    fprintf(csv_stream, "\n");
+}
+
+static void CloseCSV(void)
+{
+    fclose(csv_stream);
+}
+
+void M_InitProfiler(void)
+{
+    int p;
+    int i;
+
+    //!
+    // @arg <filename>
+    // @category video
+    //
+    // Measure the time taken by the renderer, game simulation, sound,
+    // network and screen update in each frame.  A graph of recent
+    // frames is drawn on screen, and the times for every frame are
+    // written to the given file as CSV.
+    //
+
+    p = M_CheckParmWithArgs("-profile", 1);
+
+    if (p == 0)
+    {
+        return;
+    }
+
+    csv_stream = fopen(myargv[p + 1], "w");
+
+    if (csv_stream == NULL)
+    {
+        I_Error("M_InitProfiler: Unable to open %s", myargv[p + 1]);
+    }
+
+    fprintf(csv_stream, "frame,total_us");
+
+    for (i = 0; i < NUM_PROFILE_SECTIONS; ++i)
+    {
+        fprintf(csv_stream, ",%s_us", section_names[i]);
+    }
+
+    fprintf(csv_stream, "\n");
+
+    profiling = true;
+    frame_start = I_GetTimeUS();
+
+    I_AtExit(CloseCSV, true);
+}
+
+void M_ProfileStart(profilesection_t section)
+{
+    if (profiling)
+    {
+        start_times[section] = I_GetTimeUS();
+    }
+}
+
+void M_ProfileStop(profilesection_t section)
+{
+    if (profiling)
+    {
+        current.sections[section] += I_GetTimeUS() - start_times[section];
+    }
+}
+
+void M_ProfileFrame(void)
+{
+    uint64_t now;
+
+    if (!profiling)
+    {
+        return;
+    }
+
+    now = I_GetTimeUS();
+    current.total = now - frame_start;
+    frame_start = now;
+
+    WriteCSVRow(&current);
+
+    frames[num_frames % GRAPH_WIDTH] = current;
+    ++num_frames;
+    memset(&current, 0, sizeof(current));
+}
+
+static void SetColors(void)
+{
+    int i;
+
+    // Palette indexes are looked up the first time the graph is drawn,
+    // once the game palette has been set.
+
+    for (i = 0; i <= NUM_PROFILE_SECTIONS; ++i)
+    {
+        section_colors[i] = I_GetPaletteIndex(section_rgb[i][0],
+                                              section_rgb[i][1],
+                                              section_rgb[i][2]);
+    }
+
+    background_color = I_GetPaletteIndex(0, 0, 0);
+    budget_color = I_GetPaletteIndex(255, 255, 255);
+    colors_set = true;
+}
+
+// Draw the bar for one frame from the bottom of the graph upwards,
+// one section on top of another.
+
+static void DrawFrame(pixel_t *column, frametime_t *frame)
+{
+    uint32_t sum, other;
+    int y, top;
+    int i;
+
+    sum = 0;
+    y = GRAPH_HEIGHT;
+
+    for (i = 0; i <= NUM_PROFILE_SECTIONS && y > 0; ++i)
+    {
+        if (i < NUM_PROFILE_SECTIONS)
+        {
+            sum += frame->sections[i];
+        }
+        else
+        {
+            other = frame->total > sum ? frame->total - sum : 0;
+            sum += other;
+        }
+
+        top = GRAPH_HEIGHT - sum / GRAPH_SCALE;
+
+        if (top < 0)
+        {
+            top = 0;
+        }
+
+        for (; y > top; --y)
+        {
+            column[(y - 1) * SCREENWIDTH] = section_colors[i];
+        }
+    }
+}
+
+void M_DrawProfileGraph(void)
+{
+    pixel_t *graph;
+    int budget_y;
+    int first;
+    int x, y;
+
+    if (!profiling)
+    {
+        return;
+    }
+
+    if (!colors_set)
+    {
+        SetColors();
+    }
+
+    graph = I_VideoBuffer + GRAPH_Y * SCREENWIDTH + GRAPH_X;
+
+    for (y = 0; y < GRAPH_HEIGHT; ++y)
+    {
+        memcpy(saved_background + y * GRAPH_WIDTH,
+               graph + y * SCREENWIDTH, GRAPH_WIDTH * sizeof(pixel_t));
+        memset(graph + y * SCREENWIDTH, background_color,
+               GRAPH_WIDTH * sizeof(pixel_t));
+    }
+
+    graph_drawn = true;
+
+    // Newest frame on the right.
+
+    first = num_frames - GRAPH_WIDTH;
+
+    for (x = 0; x < GRAPH_WIDTH; ++x)
+    {
+        if (first + x >= 0)
+        {
+            DrawFrame(graph + x, &frames[(first + x) % GRAPH_WIDTH]);
+        }
+    }
+
+    // Dotted line at the time of one tic.
+
+    budget_y = GRAPH_HEIGHT - 1 - FRAME_BUDGET / GRAPH_SCALE;
+
+    for (x = 0; x < GRAPH_WIDTH; x += 2)
+    {
+        graph[budget_y * SCREENWIDTH + x] = budget_color;
+    }
+}
+
+void M_RestoreProfileBackground(void)
+{
+    pixel_t *graph;
+    int y;
+
+    if (!graph_drawn)
+    {
+        return;
+    }
+
+    graph = I_VideoBuffer + GRAPH_Y * SCREENWIDTH + GRAPH_X;
+
+    for (y = 0; y < GRAPH_HEIGHT; ++y)
+    {
+        memcpy(graph + y * SCREENWIDTH, saved_background + y * GRAPH_WIDTH,
+               GRAPH_WIDTH * sizeof(pixel_t));
+    }
+
+    graph_drawn = false;
+}
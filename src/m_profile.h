@@ -0,0 +1,55 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Frame time profiler.
+//
+
+#ifndef __M_PROFILE__
+#define __M_PROFILE__
+
+#include "doomtype.h"
+
+// Parts of each frame that are timed separately.
+
+typedef enum
+{
+    PROFILE_BSP,        // R_RenderBSPNode
+    PROFILE_PLANES,     // R_DrawPlanes
+    PROFILE_MASKED,     // R_DrawMasked
+    PROFILE_TICKER,     // P_Ticker
+    PROFILE_SOUND,      // S_UpdateSounds
+    PROFILE_NET,        // NetUpdate
+    PROFILE_BLIT,       // I_FinishUpdate
+    NUM_PROFILE_SECTIONS
+} profilesection_t;
+
+// True if -profile was given.
+extern boolean profiling;
+
+void M_InitProfiler(void);
+
+// Time spent between these calls is added to the section for the
+// current frame.  They must only be called from the main thread.
+void M_ProfileStart(profilesection_t section);
+void M_ProfileStop(profilesection_t section);
+
+// Called once at the end of each frame.
+void M_ProfileFrame(void);
+
+// Draw the graph of recent frame times on the screen buffer before
+// it is blitted, and restore what was under it afterwards.
+void M_DrawProfileGraph(void);
+void M_RestoreProfileBackground(void);
+
+#endif
@@ -367,6 +367,68 @@ void NET_Conn_Run(net_connection_t *conn)
     }
 }
 
+// Shorten *timeout to the time left until deadline, if the deadline is
+// still to come.  A deadline that has passed is ignored: whatever it
+// was for has been done, or is waiting for a packet to arrive.
+
+void NET_UpdateTimeout(int *timeout, int nowtime, int deadline)
+{
+    int remaining;
+
+    remaining = deadline - nowtime;
+
+    if (remaining > 0 && (*timeout < 0 || remaining < *timeout))
+    {
+        *timeout = remaining;
+    }
+}
+
+// Shorten *timeout to the time until NET_Conn_Run next has something
+// to do for this connection.  The checks above fire once a period has
+// been exceeded, hence the extra millisecond.
+
+void NET_Conn_UpdateTimeout(net_connection_t *conn, int nowtime, int *timeout)
+{
+    if (conn->state == NET_CONN_STATE_CONNECTED)
+    {
+        NET_UpdateTimeout(timeout, nowtime,
+                          conn->keepalive_recv_time
+                        + CONNECTION_TIMEOUT_LEN * 1000 + 1);
+        NET_UpdateTimeout(timeout, nowtime,
+                          conn->keepalive_send_time
+                        + KEEPALIVE_PERIOD * 1000 + 1);
+
+        if (conn->reliable_packets != NULL)
+        {
+            if (conn->reliable_packets->last_send_time < 0)
+            {
+                *timeout = 0;
+            }
+            else
+            {
+                NET_UpdateTimeout(timeout, nowtime,
+                                  conn->reliable_packets->last_send_time
+                                + 1001);
+            }
+        }
+    }
+    else if (conn->state == NET_CONN_STATE_DISCONNECTING)
+    {
+        if (conn->last_send_time < 0)
+        {
+            *timeout = 0;
+        }
+        else
+        {
+            NET_UpdateTimeout(timeout, nowtime, conn->last_send_time + 1001);
+        }
+    }
+    else if (conn->state == NET_CONN_STATE_DISCONNECTED_SLEEP)
+    {
+        NET_UpdateTimeout(timeout, nowtime, conn->last_send_time + 5001);
+    }
+}
+
 net_packet_t *NET_Conn_NewReliable(net_connection_t *conn, int packet_type)
 {
     net_packet_t *packet;
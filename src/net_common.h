@@ -93,6 +93,10 @@ void NET_Conn_Disconnect(net_connection_t *conn);
 void NET_Conn_Run(net_connection_t *conn);
 net_packet_t *NET_Conn_NewReliable(net_connection_t *conn, int packet_type);
 
+// Timeouts are in milliseconds, with -1 meaning no timeout.
+void NET_UpdateTimeout(int *timeout, int nowtime, int deadline);
+void NET_Conn_UpdateTimeout(net_connection_t *conn, int nowtime, int *timeout);
+
 // Other miscellaneous common functions
 unsigned int NET_ExpandTicNum(unsigned int relative, unsigned int b);
 boolean NET_ValidGameSettings(GameMode_t mode, GameMission_t mission,
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "config.h"
 #include "doomtype.h"
 
 #include "i_system.h"
@@ -26,8 +27,10 @@
 #include "m_argv.h"
 
 #include "net_common.h"
+#include "net_packet.h"
 #include "net_sdl.h"
 #include "net_server.h"
+#include "net_udp.h"
 
 // 
 // People can become confused about how dedicated servers work.  Game
@@ -61,11 +64,148 @@ static void CheckForClientOptions(void)
     }
 }
 
+#ifdef HAVE_POLL
+
+// How often to write packet counts, and the number of allocations
+// made for packets, to the -netlog file, in ms.
+
+#define STATS_INTERVAL 10000
+
+// Host a number of games, each on its own port.  A game is only run
+// when a packet arrives for it or it has something to do; otherwise
+// the server sleeps.
+
+static void HostGames(int num_games)
+{
+    net_server_t **servers;
+    boolean *ready;
+    boolean *waiting;
+    int *deadlines;
+    int stats_time;
+    int nowtime;
+    int timeout;
+    int remaining;
+    int i;
+
+    servers = malloc(num_games * sizeof(net_server_t *));
+    ready = malloc(num_games * sizeof(boolean));
+    waiting = malloc(num_games * sizeof(boolean));
+    deadlines = malloc(num_games * sizeof(int));
+
+    if (servers == NULL || ready == NULL || waiting == NULL
+     || deadlines == NULL)
+    {
+        I_Error("HostGames: Unable to allocate %d games", num_games);
+    }
+
+    for (i = 0; i < num_games; ++i)
+    {
+        servers[i] = NET_SV_Init();
+
+        if (i > 0)
+        {
+            NET_UDP_AddSocket();
+        }
+
+        NET_SV_AddModule(&net_udp_module);
+        NET_SV_RegisterWithMaster();
+
+        ready[i] = true;
+        waiting[i] = false;
+    }
+
+    stats_time = I_GetTimeMS();
+
+    while (true)
+    {
+        nowtime = I_GetTimeMS();
+        timeout = -1;
+
+        for (i = 0; i < num_games; ++i)
+        {
+            if (ready[i] || (waiting[i] && nowtime - deadlines[i] >= 0))
+            {
+                NET_SV_SelectServer(servers[i]);
+                NET_UDP_SelectSocket(i);
+                NET_UDP_StartBatch();
+                NET_SV_Run();
+                NET_UDP_FlushBatch();
+
+                remaining = NET_SV_NextTimeout();
+                waiting[i] = remaining >= 0;
+                deadlines[i] = nowtime + remaining;
+            }
+
+            if (waiting[i])
+            {
+                remaining = deadlines[i] - nowtime;
+
+                if (remaining < 0)
+                {
+                    remaining = 0;
+                }
+
+                if (timeout < 0 || remaining < timeout)
+                {
+                    timeout = remaining;
+                }
+            }
+        }
+
+        if (nowtime - stats_time >= STATS_INTERVAL)
+        {
+            NET_UDP_LogStats();
+            NET_Log("packets: %u allocations in total",
+                    NET_PacketAllocations());
+            stats_time = nowtime;
+        }
+
+        // Sleep until a packet arrives or a game next has something
+        // to do.
+
+        NET_UDP_WaitForPackets(timeout, ready);
+    }
+}
+
+#endif
+
 void NET_DedicatedServer(void)
 {
+#ifdef HAVE_POLL
+    int num_games;
+    int p;
+#endif
+
     CheckForClientOptions();
 
     NET_OpenLog();
+
+#ifdef HAVE_POLL
+    //!
+    // @category net
+    // @arg <n>
+    //
+    // When running a dedicated server, host <n> separate games at
+    // once, on consecutive UDP ports starting from the one given
+    // with -port.
+    //
+
+    num_games = 1;
+    p = M_CheckParmWithArgs("-games", 1);
+
+    if (p > 0)
+    {
+        num_games = atoi(myargv[p + 1]);
+
+        if (num_games < 1)
+        {
+            I_Error("NET_DedicatedServer: Invalid number of games: %s",
+                    myargv[p + 1]);
+        }
+    }
+
+    HostGames(num_games);
+#else
     NET_SV_Init();
     NET_SV_AddModule(&net_sdl_module);
     NET_SV_RegisterWithMaster();
@@ -73,8 +213,8 @@ void NET_DedicatedServer(void)
     while (true)
     {
         NET_SV_Run();
-        // TODO: Block on socket instead of polling.
         I_Sleep(1);
     }
+#endif
 }
 
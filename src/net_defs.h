@@ -55,6 +55,7 @@ struct _net_packet_s
     size_t len;
     size_t alloced;
     unsigned int pos;
+    int refcount;
 };
 
 struct _net_module_s
@@ -21,25 +21,59 @@
 #include "net_packet.h"
 #include "z_zone.h"
 
+// Most free packets kept in the pool.  Any more than this are
+// returned to the zone.
+
+#define MAX_FREE_PACKETS 256
+
 static int total_packet_memory = 0;
+static unsigned int packet_allocs = 0;
 
-net_packet_t *NET_NewPacket(int initial_size)
+static net_packet_t *free_packets[MAX_FREE_PACKETS];
+static int num_free_packets = 0;
+
+static net_packet_t *AllocPacket(int size)
 {
     net_packet_t *packet;
 
     packet = (net_packet_t *) Z_Malloc(sizeof(net_packet_t), PU_STATIC, 0);
-    
-    if (initial_size == 0)
-        initial_size = 256;
 
-    packet->alloced = initial_size;
-    packet->data = Z_Malloc(initial_size, PU_STATIC, 0);
-    packet->len = 0;
-    packet->pos = 0;
+    packet->alloced = size;
+    packet->data = Z_Malloc(size, PU_STATIC, 0);
 
-    total_packet_memory += sizeof(net_packet_t) + initial_size;
+    total_packet_memory += sizeof(net_packet_t) + size;
+    ++packet_allocs;
 
     //printf("total packet memory: %i bytes\n", total_packet_memory);
+
+    return packet;
+}
+
+net_packet_t *NET_NewPacket(int initial_size)
+{
+    net_packet_t *packet;
+
+    if (initial_size <= NET_PACKET_BUFFER_SIZE)
+    {
+        if (num_free_packets > 0)
+        {
+            --num_free_packets;
+            packet = free_packets[num_free_packets];
+        }
+        else
+        {
+            packet = AllocPacket(NET_PACKET_BUFFER_SIZE);
+        }
+    }
+    else
+    {
+        packet = AllocPacket(initial_size);
+    }
+
+    packet->len = 0;
+    packet->pos = 0;
+    packet->refcount = 1;
+
     //printf("%p: allocated\n", packet);
 
     return packet;
@@ -60,13 +94,40 @@ net_packet_t *NET_PacketDup(net_packet_t *packet)
 
 void NET_FreePacket(net_packet_t *packet)
 {
+    --packet->refcount;
+
+    if (packet->refcount > 0)
+    {
+        return;
+    }
+
     //printf("%p: destroyed\n", packet);
-    
+
+    // Put it back in the pool, unless it has grown.
+
+    if (packet->alloced == NET_PACKET_BUFFER_SIZE
+     && num_free_packets < MAX_FREE_PACKETS)
+    {
+        free_packets[num_free_packets] = packet;
+        ++num_free_packets;
+        return;
+    }
+
     total_packet_memory -= sizeof(net_packet_t) + packet->alloced;
     Z_Free(packet->data);
     Z_Free(packet);
 }
 
+void NET_HoldPacket(net_packet_t *packet)
+{
+    ++packet->refcount;
+}
+
+unsigned int NET_PacketAllocations(void)
+{
+    return packet_allocs;
+}
+
 // Read a byte from the packet, returning true if read
 // successfully
 
@@ -245,6 +306,7 @@ static void NET_IncreasePacket(net_packet_t *packet)
     packet->alloced *= 2;
 
     newdata = Z_Malloc(packet->alloced, PU_STATIC, 0);
+    ++packet_allocs;
 
     memcpy(newdata, packet->data, packet->len);
 
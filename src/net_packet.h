@@ -20,10 +20,25 @@
 
 #include "net_defs.h"
 
+// Packets of up to this size come from a pool of buffers that are
+// reused when freed.  It is large enough for any packet received.
+
+#define NET_PACKET_BUFFER_SIZE 1500
+
 net_packet_t *NET_NewPacket(int initial_size);
 net_packet_t *NET_PacketDup(net_packet_t *packet);
 void NET_FreePacket(net_packet_t *packet);
 
+// Keep a packet from being freed until NET_FreePacket is called once
+// more, eg. while it is waiting to be sent.
+
+void NET_HoldPacket(net_packet_t *packet);
+
+// Number of times that memory has been allocated for packets, which
+// stops going up once the pool holds as many as are in use at once.
+
+unsigned int NET_PacketAllocations(void);
+
 boolean NET_ReadInt8(net_packet_t *packet, unsigned int *data);
 boolean NET_ReadInt16(net_packet_t *packet, unsigned int *data);
 boolean NET_ReadInt32(net_packet_t *packet, unsigned int *data);
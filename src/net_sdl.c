@@ -42,14 +42,23 @@ static int port = DEFAULT_PORT;
 static UDPsocket udpsocket;
 static UDPpacket *recvpacket;
 
-typedef struct
+// Addresses are kept in a hash table keyed on IP and port, so that
+// finding the address of a received packet stays quick when many
+// addresses are known, eg. when the server is being flooded with
+// queries.  An address is removed when its last reference is released.
+
+typedef struct addrpair_s addrpair_t;
+
+struct addrpair_s
 {
     net_addr_t net_addr;
     IPaddress sdl_addr;
-} addrpair_t;
+    addrpair_t *next;
+};
 
 static addrpair_t **addr_table;
 static int addr_table_size = -1;
+static int num_addrs = 0;
 
 // Initializes the address table
 
@@ -68,62 +77,80 @@ static boolean AddressesEqual(IPaddress *a, IPaddress *b)
         && a->port == b->port;
 }
 
+static unsigned int HashAddress(IPaddress *addr)
+{
+    unsigned int hash;
+
+    hash = (addr->host ^ ((unsigned int) addr->port << 16)) * 0x9e3779b1u;
+
+    return (hash ^ (hash >> 16)) & (addr_table_size - 1);
+}
+
+// Double the number of chains once there are more addresses than
+// chains, so that they stay short.
+
+static void NET_SDL_GrowAddrTable(void)
+{
+    addrpair_t **old_table;
+    addrpair_t *entry, *next;
+    unsigned int hash;
+    int old_size;
+    int i;
+
+    old_table = addr_table;
+    old_size = addr_table_size;
+
+    addr_table_size = old_size * 2;
+    addr_table = Z_Malloc(sizeof(addrpair_t *) * addr_table_size,
+                          PU_STATIC, 0);
+    memset(addr_table, 0, sizeof(addrpair_t *) * addr_table_size);
+
+    for (i=0; i<old_size; ++i)
+    {
+        for (entry = old_table[i]; entry != NULL; entry = next)
+        {
+            next = entry->next;
+            hash = HashAddress(&entry->sdl_addr);
+            entry->next = addr_table[hash];
+            addr_table[hash] = entry;
+        }
+    }
+
+    Z_Free(old_table);
+}
+
 // Finds an address by searching the table.  If the address is not found,
 // it is added to the table.
 
 static net_addr_t *NET_SDL_FindAddress(IPaddress *addr)
 {
     addrpair_t *new_entry;
-    int empty_entry = -1;
-    int i;
+    addrpair_t *entry;
+    unsigned int hash;
 
     if (addr_table_size < 0)
     {
         NET_SDL_InitAddrTable();
     }
 
-    for (i=0; i<addr_table_size; ++i)
+    hash = HashAddress(addr);
+
+    for (entry = addr_table[hash]; entry != NULL; entry = entry->next)
     {
-        if (addr_table[i] != NULL
-         && AddressesEqual(addr, &addr_table[i]->sdl_addr))
+        if (AddressesEqual(addr, &entry->sdl_addr))
         {
-            return &addr_table[i]->net_addr;
+            return &entry->net_addr;
         }
-
-        if (empty_entry < 0 && addr_table[i] == NULL)
-            empty_entry = i;
     }
 
     // Was not found in list.  We need to add it.
 
-    // Is there any space in the table? If not, increase the table size
-
-    if (empty_entry < 0)
+    if (num_addrs >= addr_table_size)
     {
-        addrpair_t **new_addr_table;
-        int new_addr_table_size;
-
-        // after reallocing, we will add this in as the first entry
-        // in the new block of memory
-
-        empty_entry = addr_table_size;
-        
-        // allocate a new array twice the size, init to 0 and copy 
-        // the existing table in.  replace the old table.
-
-        new_addr_table_size = addr_table_size * 2;
-        new_addr_table = Z_Malloc(sizeof(addrpair_t *) * new_addr_table_size,
-                                  PU_STATIC, 0);
-        memset(new_addr_table, 0, sizeof(addrpair_t *) * new_addr_table_size);
-        memcpy(new_addr_table, addr_table, 
-               sizeof(addrpair_t *) * addr_table_size);
-        Z_Free(addr_table);
-        addr_table = new_addr_table;
-        addr_table_size = new_addr_table_size;
+        NET_SDL_GrowAddrTable();
+        hash = HashAddress(addr);
     }
 
-    // Add a new entry
-    
     new_entry = Z_Malloc(sizeof(addrpair_t), PU_STATIC, 0);
 
     new_entry->sdl_addr = *addr;
@@ -131,22 +158,31 @@ static net_addr_t *NET_SDL_FindAddress(IPaddress *addr)
     new_entry->net_addr.handle = &new_entry->sdl_addr;
     new_entry->net_addr.module = &net_sdl_module;
 
-    addr_table[empty_entry] = new_entry;
+    new_entry->next = addr_table[hash];
+    addr_table[hash] = new_entry;
+    ++num_addrs;
 
     return &new_entry->net_addr;
 }
 
 static void NET_SDL_FreeAddress(net_addr_t *addr)
 {
-    int i;
-    
-    for (i=0; i<addr_table_size; ++i)
+    addrpair_t *pair = (addrpair_t *) addr;
+    addrpair_t **entry;
+
+    if (addr_table_size > 0)
     {
-        if (addr == &addr_table[i]->net_addr)
+        entry = &addr_table[HashAddress(&pair->sdl_addr)];
+
+        for (; *entry != NULL; entry = &(*entry)->next)
         {
-            Z_Free(addr_table[i]);
-            addr_table[i] = NULL;
-            return;
+            if (*entry == pair)
+            {
+                *entry = pair->next;
+                --num_addrs;
+                Z_Free(pair);
+                return;
+            }
         }
     }
 
@@ -17,14 +17,29 @@
 #ifndef NET_SERVER_H
 #define NET_SERVER_H
 
-// initialize server and wait for connections
+// A dedicated server can host several games at once.  Each has its
+// own net_server_t, and the functions below act on the one selected.
 
-void NET_SV_Init(void);
+typedef struct net_server_s net_server_t;
+
+// initialize a new server and wait for connections.  The new server
+// is selected.
+
+net_server_t *NET_SV_Init(void);
+
+// Select the server that the other functions act on.
+
+void NET_SV_SelectServer(net_server_t *server);
 
 // run server: check for new packets received etc.
 
 void NET_SV_Run(void);
 
+// Milliseconds until NET_SV_Run next has something to do if no packet
+// arrives, or -1 if it has nothing to do until one does.
+
+int NET_SV_NextTimeout(void);
+
 // Shut down the server
 // Blocks until all clients disconnect, or until a 5 second timeout
 
@@ -0,0 +1,803 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Networking module which uses POSIX sockets directly.
+//
+//     The packets sent are the same as those of the SDL_net module.
+//     The difference is that the socket can be waited on with
+//     NET_UDP_WaitForPackets, so that a dedicated server sleeps until
+//     a packet arrives instead of polling.
+//
+//     Where recvmmsg and sendmmsg are available, the socket is read
+//     a batch of packets at a time, and a dedicated server queues the
+//     packets sent while running a game and sends them with one call.
+//
+//     A dedicated server hosting several games has a socket for each,
+//     on consecutive ports.  The module sends and receives on the
+//     selected socket, and each address belongs to the socket that it
+//     was seen on.
+//
+
+#include "config.h"
+
+#ifdef HAVE_POLL
+
+// recvmmsg and sendmmsg are GNU extensions.
+#if defined(HAVE_RECVMMSG) || defined(HAVE_SENDMMSG)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "net_common.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_udp.h"
+#include "z_zone.h"
+
+#define DEFAULT_PORT 2342
+
+// Number of packets read or sent with one call.
+
+#define RECV_BATCH 32
+#define SEND_BATCH 64
+
+static boolean initted = false;
+static int port = DEFAULT_PORT;
+
+#ifdef HAVE_RECVMMSG
+
+// Packets are read straight into packets from the pool.  Those read
+// from recv_socket but not yet returned are from recv_pos up to
+// recv_count; the rest are empty, or NULL if they have been returned.
+
+static net_packet_t *recvpackets[RECV_BATCH];
+static struct sockaddr_in recvaddrs[RECV_BATCH];
+static struct mmsghdr recvmsgs[RECV_BATCH];
+static struct iovec recviovs[RECV_BATCH];
+static int recv_socket = -1;
+static int recv_pos = 0;
+static int recv_count = 0;
+
+#endif
+
+#ifdef HAVE_SENDMMSG
+
+// Packets queued to be sent on send_socket by NET_UDP_FlushBatch.
+// They are held rather than copied.
+
+static boolean batching = false;
+static net_packet_t *sendpackets[SEND_BATCH];
+static struct sockaddr_in sendaddrs[SEND_BATCH];
+static struct mmsghdr sendmsgs[SEND_BATCH];
+static struct iovec sendiovs[SEND_BATCH];
+static int send_socket = -1;
+static int send_count = 0;
+
+#endif
+
+// Packets sent and received, and the calls made to do it.
+
+static unsigned int packets_recvd, recv_calls;
+static unsigned int packets_sent, send_calls;
+
+// All sockets opened, and the selected one.
+
+static struct pollfd *sockets = NULL;
+static int num_sockets = 0;
+static int udpsocket = -1;
+
+// Addresses are kept in a hash table keyed on socket, IP and port, as
+// in the SDL_net module.  An address is removed when its last
+// reference is released.
+
+typedef struct addrpair_s addrpair_t;
+
+struct addrpair_s
+{
+    net_addr_t net_addr;
+    int socket;
+    struct sockaddr_in sin;
+    addrpair_t *next;
+};
+
+static addrpair_t **addr_table;
+static int addr_table_size = -1;
+static int num_addrs = 0;
+
+// Initializes the address table
+
+static void NET_UDP_InitAddrTable(void)
+{
+    addr_table_size = 16;
+
+    addr_table = Z_Malloc(sizeof(addrpair_t *) * addr_table_size,
+                          PU_STATIC, 0);
+    memset(addr_table, 0, sizeof(addrpair_t *) * addr_table_size);
+}
+
+static boolean AddressesEqual(struct sockaddr_in *a, struct sockaddr_in *b)
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr
+        && a->sin_port == b->sin_port;
+}
+
+static unsigned int HashAddress(int socket, struct sockaddr_in *addr)
+{
+    unsigned int hash;
+
+    hash = (addr->sin_addr.s_addr ^ ((unsigned int) addr->sin_port << 16)
+            ^ (unsigned int) socket) * 0x9e3779b1u;
+
+    return (hash ^ (hash >> 16)) & (addr_table_size - 1);
+}
+
+// Double the number of chains once there are more addresses than
+// chains, so that they stay short.
+
+static void NET_UDP_GrowAddrTable(void)
+{
+    addrpair_t **old_table;
+    addrpair_t *entry, *next;
+    unsigned int hash;
+    int old_size;
+    int i;
+
+    old_table = addr_table;
+    old_size = addr_table_size;
+
+    addr_table_size = old_size * 2;
+    addr_table = Z_Malloc(sizeof(addrpair_t *) * addr_table_size,
+                          PU_STATIC, 0);
+    memset(addr_table, 0, sizeof(addrpair_t *) * addr_table_size);
+
+    for (i=0; i<old_size; ++i)
+    {
+        for (entry = old_table[i]; entry != NULL; entry = next)
+        {
+            next = entry->next;
+            hash = HashAddress(entry->socket, &entry->sin);
+            entry->next = addr_table[hash];
+            addr_table[hash] = entry;
+        }
+    }
+
+    Z_Free(old_table);
+}
+
+// Finds an address seen on the selected socket by searching the table.
+// If the address is not found, it is added to the table.
+
+static net_addr_t *NET_UDP_FindAddress(struct sockaddr_in *addr)
+{
+    addrpair_t *new_entry;
+    addrpair_t *entry;
+    unsigned int hash;
+
+    if (addr_table_size < 0)
+    {
+        NET_UDP_InitAddrTable();
+    }
+
+    hash = HashAddress(udpsocket, addr);
+
+    for (entry = addr_table[hash]; entry != NULL; entry = entry->next)
+    {
+        if (entry->socket == udpsocket && AddressesEqual(addr, &entry->sin))
+        {
+            return &entry->net_addr;
+        }
+    }
+
+    // Was not found in list.  We need to add it.
+
+    if (num_addrs >= addr_table_size)
+    {
+        NET_UDP_GrowAddrTable();
+        hash = HashAddress(udpsocket, addr);
+    }
+
+    new_entry = Z_Malloc(sizeof(addrpair_t), PU_STATIC, 0);
+
+    new_entry->socket = udpsocket;
+    memset(&new_entry->sin, 0, sizeof(new_entry->sin));
+    new_entry->sin.sin_family = AF_INET;
+    new_entry->sin.sin_addr = addr->sin_addr;
+    new_entry->sin.sin_port = addr->sin_port;
+    new_entry->net_addr.refcount = 0;
+    new_entry->net_addr.handle = &new_entry->sin;
+    new_entry->net_addr.module = &net_udp_module;
+
+    new_entry->next = addr_table[hash];
+    addr_table[hash] = new_entry;
+    ++num_addrs;
+
+    return &new_entry->net_addr;
+}
+
+static void NET_UDP_FreeAddress(net_addr_t *addr)
+{
+    addrpair_t *pair = (addrpair_t *) addr;
+    addrpair_t **entry;
+
+    if (addr_table_size > 0)
+    {
+        entry = &addr_table[HashAddress(pair->socket, &pair->sin)];
+
+        for (; *entry != NULL; entry = &(*entry)->next)
+        {
+            if (*entry == pair)
+            {
+                *entry = pair->next;
+                --num_addrs;
+                Z_Free(pair);
+                return;
+            }
+        }
+    }
+
+    I_Error("NET_UDP_FreeAddress: Attempted to remove an unused address!");
+}
+
+// Open a non-blocking UDP socket on the given port, or on any port
+// if it is zero, and select it.  Returns false if it could not be
+// bound.
+
+static boolean OpenSocket(int bind_port)
+{
+    struct sockaddr_in sin;
+    int broadcast = 1;
+    int flags;
+    int s;
+
+    s = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (s < 0)
+    {
+        return false;
+    }
+
+    flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, flags | O_NONBLOCK);
+
+    setsockopt(s, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_ANY);
+    sin.sin_port = htons(bind_port);
+
+    if (bind(s, (struct sockaddr *) &sin, sizeof(sin)) < 0)
+    {
+        close(s);
+        return false;
+    }
+
+    sockets = I_Realloc(sockets, (num_sockets + 1) * sizeof(struct pollfd));
+    sockets[num_sockets].fd = s;
+    sockets[num_sockets].events = POLLIN;
+    sockets[num_sockets].revents = 0;
+    ++num_sockets;
+
+    udpsocket = s;
+
+    return true;
+}
+
+static void CheckPortParm(void)
+{
+    int p;
+
+    // -port is documented in the SDL_net module.
+
+    p = M_CheckParmWithArgs("-port", 1);
+    if (p > 0)
+        port = atoi(myargv[p+1]);
+}
+
+static boolean NET_UDP_InitClient(void)
+{
+    if (initted)
+        return true;
+
+    CheckPortParm();
+
+    if (!OpenSocket(0))
+    {
+        I_Error("NET_UDP_InitClient: Unable to open a socket!");
+    }
+
+    initted = true;
+
+    return true;
+}
+
+static boolean NET_UDP_InitServer(void)
+{
+    if (initted)
+        return true;
+
+    CheckPortParm();
+
+    if (!OpenSocket(port))
+    {
+        I_Error("NET_UDP_InitServer: Unable to bind to port %i", port);
+    }
+
+    initted = true;
+
+    return true;
+}
+
+// A full send buffer just loses the packet, as the network might have
+// done anyway.
+
+static void CheckSendError(void)
+{
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS
+     && errno != EINTR && errno != ECONNREFUSED)
+    {
+        I_Error("NET_UDP_SendPacket: Error transmitting packet: %s",
+                strerror(errno));
+    }
+}
+
+#ifdef HAVE_SENDMMSG
+
+static void SendQueued(void)
+{
+    int sent = 0;
+    int result;
+
+    while (sent < send_count)
+    {
+        result = sendmmsg(send_socket, sendmsgs + sent, send_count - sent, 0);
+        ++send_calls;
+
+        if (result < 0)
+        {
+            // The first packet could not be sent; lose it and carry on
+            // with the rest.
+
+            CheckSendError();
+            result = 1;
+        }
+        else
+        {
+            packets_sent += result;
+        }
+
+        sent += result;
+    }
+
+    for (sent = 0; sent < send_count; ++sent)
+    {
+        NET_FreePacket(sendpackets[sent]);
+    }
+
+    send_count = 0;
+}
+
+static void QueuePacket(int s, struct sockaddr_in *sin, net_packet_t *packet)
+{
+    struct mmsghdr *msg;
+
+    // Only packets for one socket can be sent with each call.
+
+    if (send_count == SEND_BATCH || (send_count > 0 && s != send_socket))
+    {
+        SendQueued();
+    }
+
+    NET_HoldPacket(packet);
+    sendpackets[send_count] = packet;
+    sendaddrs[send_count] = *sin;
+    sendiovs[send_count].iov_base = packet->data;
+    sendiovs[send_count].iov_len = packet->len;
+
+    msg = &sendmsgs[send_count];
+    memset(msg, 0, sizeof(*msg));
+    msg->msg_hdr.msg_name = &sendaddrs[send_count];
+    msg->msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    msg->msg_hdr.msg_iov = &sendiovs[send_count];
+    msg->msg_hdr.msg_iovlen = 1;
+
+    send_socket = s;
+    ++send_count;
+}
+
+void NET_UDP_StartBatch(void)
+{
+    batching = true;
+}
+
+void NET_UDP_FlushBatch(void)
+{
+    batching = false;
+
+    if (send_count > 0)
+    {
+        SendQueued();
+    }
+}
+
+#else
+
+void NET_UDP_StartBatch(void)
+{
+}
+
+void NET_UDP_FlushBatch(void)
+{
+}
+
+#endif
+
+static void NET_UDP_SendPacket(net_addr_t *addr, net_packet_t *packet)
+{
+    struct sockaddr_in sin;
+    int s;
+
+    if (addr == &net_broadcast_addr)
+    {
+        memset(&sin, 0, sizeof(sin));
+        sin.sin_family = AF_INET;
+        sin.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+        sin.sin_port = htons(port);
+        s = udpsocket;
+    }
+    else
+    {
+        sin = *((struct sockaddr_in *) addr->handle);
+        s = ((addrpair_t *) addr)->socket;
+    }
+
+#ifdef HAVE_SENDMMSG
+    if (batching)
+    {
+        QueuePacket(s, &sin, packet);
+        return;
+    }
+#endif
+
+    ++send_calls;
+
+    if (sendto(s, packet->data, packet->len, 0,
+               (struct sockaddr *) &sin, sizeof(sin)) < 0)
+    {
+        CheckSendError();
+    }
+    else
+    {
+        ++packets_sent;
+    }
+}
+
+// Returns false if there is nothing to receive.
+
+static boolean CheckRecvError(void)
+{
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+    {
+        return false;
+    }
+
+    // Some systems report an ICMP error from an earlier send here.
+
+    if (errno != EINTR && errno != ECONNREFUSED)
+    {
+        I_Error("NET_UDP_RecvPacket: Error receiving packet: %s",
+                strerror(errno));
+    }
+
+    return true;
+}
+
+#ifdef HAVE_RECVMMSG
+
+// Read as many packets as are waiting on the selected socket, up to
+// RECV_BATCH.
+
+static boolean ReadBatch(void)
+{
+    int result;
+    int i;
+
+    recv_socket = udpsocket;
+    recv_pos = 0;
+    recv_count = 0;
+
+    for (i=0; i<RECV_BATCH; ++i)
+    {
+        if (recvpackets[i] == NULL)
+        {
+            recvpackets[i] = NET_NewPacket(NET_PACKET_BUFFER_SIZE);
+        }
+
+        recviovs[i].iov_base = recvpackets[i]->data;
+        recviovs[i].iov_len = NET_PACKET_BUFFER_SIZE;
+
+        memset(&recvmsgs[i], 0, sizeof(struct mmsghdr));
+        recvmsgs[i].msg_hdr.msg_name = &recvaddrs[i];
+        recvmsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        recvmsgs[i].msg_hdr.msg_iov = &recviovs[i];
+        recvmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    for (;;)
+    {
+        result = recvmmsg(udpsocket, recvmsgs, RECV_BATCH, 0, NULL);
+        ++recv_calls;
+
+        if (result >= 0)
+        {
+            break;
+        }
+
+        if (!CheckRecvError())
+        {
+            return false;
+        }
+    }
+
+    recv_count = result;
+    packets_recvd += result;
+
+    return result > 0;
+}
+
+// Get the next packet, reading another batch if the last one has been
+// used up.  Callers read until there is nothing left before selecting
+// another socket, so a batch is never left part read.
+
+static net_packet_t *ReadPacket(struct sockaddr_in *sin)
+{
+    net_packet_t *packet;
+    int i;
+
+    if (recv_socket != udpsocket)
+    {
+        recv_pos = recv_count = 0;
+    }
+
+    if (recv_pos >= recv_count && !ReadBatch())
+    {
+        return NULL;
+    }
+
+    i = recv_pos;
+    ++recv_pos;
+
+    packet = recvpackets[i];
+    packet->len = recvmsgs[i].msg_len;
+    recvpackets[i] = NULL;
+    *sin = recvaddrs[i];
+
+    return packet;
+}
+
+#else
+
+static net_packet_t *ReadPacket(struct sockaddr_in *sin)
+{
+    net_packet_t *packet;
+    socklen_t sin_len;
+    int result;
+
+    packet = NET_NewPacket(NET_PACKET_BUFFER_SIZE);
+
+    for (;;)
+    {
+        sin_len = sizeof(*sin);
+        result = recvfrom(udpsocket, packet->data, NET_PACKET_BUFFER_SIZE, 0,
+                          (struct sockaddr *) sin, &sin_len);
+        ++recv_calls;
+
+        if (result >= 0)
+        {
+            break;
+        }
+
+        if (!CheckRecvError())
+        {
+            NET_FreePacket(packet);
+            return NULL;
+        }
+    }
+
+    ++packets_recvd;
+    packet->len = result;
+
+    return packet;
+}
+
+#endif
+
+static boolean NET_UDP_RecvPacket(net_addr_t **addr, net_packet_t **packet)
+{
+    struct sockaddr_in sin;
+
+    // The packet is read straight into a buffer from the pool.
+
+    *packet = ReadPacket(&sin);
+
+    // no packets received
+
+    if (*packet == NULL)
+    {
+        return false;
+    }
+
+    // Address
+
+    *addr = NET_UDP_FindAddress(&sin);
+
+    return true;
+}
+
+void NET_UDP_LogStats(void)
+{
+    NET_Log("udp: received %u packets with %u calls, "
+            "sent %u packets with %u calls",
+            packets_recvd, recv_calls, packets_sent, send_calls);
+
+    packets_recvd = recv_calls = 0;
+    packets_sent = send_calls = 0;
+}
+
+static void NET_UDP_AddrToString(net_addr_t *addr, char *buffer,
+                                 int buffer_len)
+{
+    struct sockaddr_in *sin;
+    uint32_t host;
+    uint16_t addr_port;
+
+    sin = (struct sockaddr_in *) addr->handle;
+    host = ntohl(sin->sin_addr.s_addr);
+    addr_port = ntohs(sin->sin_port);
+
+    M_snprintf(buffer, buffer_len, "%i.%i.%i.%i",
+               (host >> 24) & 0xff, (host >> 16) & 0xff,
+               (host >> 8) & 0xff, host & 0xff);
+
+    // As with the SDL_net module, the port is only shown if it is not
+    // the default.
+    if (addr_port != DEFAULT_PORT)
+    {
+        char portbuf[10];
+        M_snprintf(portbuf, sizeof(portbuf), ":%i", addr_port);
+        M_StringConcat(buffer, portbuf, buffer_len);
+    }
+}
+
+static net_addr_t *NET_UDP_ResolveAddress(const char *address)
+{
+    struct addrinfo hints;
+    struct addrinfo *result;
+    struct sockaddr_in sin;
+    char *addr_hostname;
+    int addr_port;
+    char *colon;
+
+    colon = strchr(address, ':');
+
+    addr_hostname = M_StringDuplicate(address);
+    if (colon != NULL)
+    {
+        addr_hostname[colon - address] = '\0';
+        addr_port = atoi(colon + 1);
+    }
+    else
+    {
+        addr_port = port;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    if (getaddrinfo(addr_hostname, NULL, &hints, &result) != 0)
+    {
+        // unable to resolve
+
+        free(addr_hostname);
+        return NULL;
+    }
+
+    memcpy(&sin, result->ai_addr, sizeof(sin));
+    sin.sin_port = htons(addr_port);
+
+    freeaddrinfo(result);
+    free(addr_hostname);
+
+    return NET_UDP_FindAddress(&sin);
+}
+
+int NET_UDP_AddSocket(void)
+{
+    int bind_port;
+
+    bind_port = port + num_sockets;
+
+    if (!OpenSocket(bind_port))
+    {
+        I_Error("NET_UDP_AddSocket: Unable to bind to port %i", bind_port);
+    }
+
+    return num_sockets - 1;
+}
+
+void NET_UDP_SelectSocket(int n)
+{
+    udpsocket = sockets[n].fd;
+}
+
+void NET_UDP_WaitForPackets(int timeout, boolean *ready)
+{
+    int i;
+
+    if (num_sockets == 0)
+    {
+        return;
+    }
+
+    // An interrupted wait just returns early, with nothing ready.
+
+    if (poll(sockets, num_sockets, timeout) <= 0)
+    {
+        if (ready != NULL)
+        {
+            memset(ready, 0, num_sockets * sizeof(boolean));
+        }
+
+        return;
+    }
+
+    if (ready != NULL)
+    {
+        for (i = 0; i < num_sockets; ++i)
+        {
+            ready[i] = (sockets[i].revents & (POLLIN | POLLERR)) != 0;
+        }
+    }
+}
+
+// Complete module
+
+net_module_t net_udp_module =
+{
+    NET_UDP_InitClient,
+    NET_UDP_InitServer,
+    NET_UDP_SendPacket,
+    NET_UDP_RecvPacket,
+    NET_UDP_AddrToString,
+    NET_UDP_FreeAddress,
+    NET_UDP_ResolveAddress,
+};
+
+#endif /* #ifdef HAVE_POLL */
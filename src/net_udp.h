@@ -0,0 +1,54 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Networking module which uses POSIX sockets directly.
+//
+
+#ifndef NET_UDP_H
+#define NET_UDP_H
+
+#include "net_defs.h"
+
+extern net_module_t net_udp_module;
+
+// Open a socket on the next port up from the last one opened, for
+// another game hosted by a dedicated server, and select it.  Returns
+// its number.
+
+int NET_UDP_AddSocket(void);
+
+// Select the socket to send and receive on.  Socket 0 is the one
+// opened when the module was initialized.
+
+void NET_UDP_SelectSocket(int n);
+
+// Wait until a packet arrives on any socket, or for timeout
+// milliseconds; -1 waits for as long as it takes.  If ready is not
+// NULL, ready[n] is set to whether socket n has anything to receive.
+
+void NET_UDP_WaitForPackets(int timeout, boolean *ready);
+
+// Queue the packets sent from now on, and send them all at once when
+// NET_UDP_FlushBatch is called.  Packets are sent straight away where
+// this is not supported.
+
+void NET_UDP_StartBatch(void);
+void NET_UDP_FlushBatch(void);
+
+// Write the number of packets sent and received, and the number of
+// calls made to do it, to the -netlog file, and reset the counts.
+
+void NET_UDP_LogStats(void);
+
+#endif /* #ifndef NET_UDP_H */
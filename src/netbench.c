@@ -0,0 +1,181 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Network address load test.  Feeds packets from a large number
+//      of sources through NET_RecvPacket and the POSIX sockets module,
+//      and reports how long it took to receive them.
+//
+//      The packets do not come from the network: recvfrom and recvmmsg
+//      are replaced by versions that make up packets from random
+//      sources, so that the time measured is spent looking up and
+//      adding addresses rather than in the kernel.
+//
+
+#include "config.h"
+
+#ifdef HAVE_RECVMMSG
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_POLL
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include "SDL.h"
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "m_argv.h"
+
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_udp.h"
+
+#ifdef HAVE_POLL
+
+// Length of each packet made up.
+#define PACKET_LEN  8
+
+// Number of addresses kept referenced at any time, as a server does
+// for its clients and the servers it is querying.
+#define HELD_ADDRS  2048
+
+static unsigned int num_sources = 100000;
+static unsigned int rand_state = 12345;
+
+static void MakePacket(void *buf, size_t len, struct sockaddr_in *sin)
+{
+    unsigned int source;
+
+    rand_state = rand_state * 1664525 + 1013904223;
+    source = (rand_state >> 8) % num_sources;
+
+    memset(sin, 0, sizeof(*sin));
+    sin->sin_family = AF_INET;
+    sin->sin_addr.s_addr = htonl(0x0a000000 + source * 7);
+    sin->sin_port = htons(1024 + (source & 1023));
+
+    memset(buf, 0, len < PACKET_LEN ? len : PACKET_LEN);
+}
+
+ssize_t recvfrom(int s, void *buf, size_t len, int flags,
+                 struct sockaddr *from, socklen_t *fromlen)
+{
+    MakePacket(buf, len, (struct sockaddr_in *) from);
+    *fromlen = sizeof(struct sockaddr_in);
+
+    return PACKET_LEN;
+}
+
+#ifdef HAVE_RECVMMSG
+
+int recvmmsg(int s, struct mmsghdr *msgs, unsigned int vlen, int flags,
+             struct timespec *timeout)
+{
+    unsigned int i;
+
+    for (i = 0; i < vlen; ++i)
+    {
+        MakePacket(msgs[i].msg_hdr.msg_iov[0].iov_base,
+                   msgs[i].msg_hdr.msg_iov[0].iov_len,
+                   msgs[i].msg_hdr.msg_name);
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_len = PACKET_LEN;
+    }
+
+    return vlen;
+}
+
+#endif
+
+int main(int argc, char *argv[])
+{
+    static net_addr_t *held[HELD_ADDRS];
+    net_context_t *context;
+    net_packet_t *packet;
+    net_addr_t *addr;
+    uint64_t start, end;
+    unsigned int num_packets = 2000000;
+    unsigned int i;
+    int p;
+
+    myargc = argc;
+    myargv = argv;
+
+    p = M_CheckParmWithArgs("-packets", 1);
+
+    if (p > 0)
+    {
+        num_packets = atoi(myargv[p + 1]);
+    }
+
+    p = M_CheckParmWithArgs("-sources", 1);
+
+    if (p > 0)
+    {
+        num_sources = atoi(myargv[p + 1]);
+    }
+
+    if (num_packets == 0 || num_sources == 0)
+    {
+        printf("Usage: %s [-packets <n>] [-sources <n>]\n", argv[0]);
+        exit(-1);
+    }
+
+    context = NET_NewContext();
+    NET_AddModule(context, &net_udp_module);
+    net_udp_module.InitClient();
+
+    start = SDL_GetPerformanceCounter();
+
+    for (i = 0; i < num_packets; ++i)
+    {
+        if (!NET_RecvPacket(context, &addr, &packet))
+        {
+            I_Error("No packet received");
+        }
+
+        NET_FreePacket(packet);
+
+        NET_ReleaseAddress(held[i % HELD_ADDRS]);
+        held[i % HELD_ADDRS] = addr;
+    }
+
+    end = SDL_GetPerformanceCounter();
+
+    printf("%u packets from %u sources: %.3f s, %.0f ns per packet\n",
+           num_packets, num_sources,
+           (end - start) / (double) SDL_GetPerformanceFrequency(),
+           (end - start) * 1e9 / SDL_GetPerformanceFrequency()
+                         / num_packets);
+
+    return 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+    printf("%s: The POSIX sockets module is not available.\n", argv[0]);
+
+    return -1;
+}
+
+#endif
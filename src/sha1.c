@@ -314,7 +314,7 @@ void SHA1_UpdateInt32(sha1_context_t *context, unsigned int val)
     SHA1_Update(context, buf, 4);
 }
 
-void SHA1_UpdateString(sha1_context_t *context, char *str)
+void SHA1_UpdateString(sha1_context_t *context, const char *str)
 {
     SHA1_Update(context, (byte *) str, strlen(str) + 1);
 }
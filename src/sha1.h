@@ -34,7 +34,7 @@ void SHA1_Init(sha1_context_t *context);
 void SHA1_Update(sha1_context_t *context, byte *buf, size_t len);
 void SHA1_Final(sha1_digest_t digest, sha1_context_t *context);
 void SHA1_UpdateInt32(sha1_context_t *context, unsigned int val);
-void SHA1_UpdateString(sha1_context_t *context, char *str);
+void SHA1_UpdateString(sha1_context_t *context, const char *str);
 
 #endif /* #ifndef __SHA1_H__ */
 
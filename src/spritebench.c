@@ -0,0 +1,281 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Vissprite sort benchmark.  Times the selection sort that
+//      R_SortVisSprites used to do against the qsort it does now,
+//      for different numbers of sprites, and checks that both draw
+//      the sprites in the same order.  Some sprites are given equal
+//      scales, as sprites at the same distance would have.
+//
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SDL.h"
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_fixed.h"
+
+// Enough time to get a stable result for each number of sprites.
+#define ROUNDS_SPRITES  (4 * 1024 * 1024)
+
+// A vissprite_t from the renderers, with the fields that the sort
+// does not look at replaced by padding of the same size.
+
+typedef struct vissprite_s
+{
+    struct vissprite_s *prev;
+    struct vissprite_s *next;
+    int x1, x2;
+    fixed_t gx, gy, gz, gzt;
+    fixed_t startfrac;
+    fixed_t scale;
+    fixed_t xiscale;
+    fixed_t texturemid;
+    int patch;
+    void *colormap;
+    int mobjflags;
+} vissprite_t;
+
+static const int sprite_counts[] = { 8, 32, 128, 512, 2048 };
+
+static vissprite_t *vissprites;
+static vissprite_t *vissprite_p;
+static vissprite_t **vsprsortbuf;
+static vissprite_t vsprsortedhead;
+
+// The sort as it was before the qsort, from the Doom renderer.
+
+static void SelectionSort(void)
+{
+    int i;
+    int count;
+    vissprite_t *ds;
+    vissprite_t *best;
+    vissprite_t unsorted;
+    fixed_t bestscale;
+
+    count = vissprite_p - vissprites;
+
+    unsorted.next = unsorted.prev = &unsorted;
+
+    if (!count)
+        return;
+
+    for (ds = vissprites; ds < vissprite_p; ds++)
+    {
+        ds->next = ds + 1;
+        ds->prev = ds - 1;
+    }
+
+    vissprites[0].prev = &unsorted;
+    unsorted.next = &vissprites[0];
+    (vissprite_p - 1)->next = &unsorted;
+    unsorted.prev = vissprite_p - 1;
+
+    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
+
+    for (i = 0; i < count; i++)
+    {
+        bestscale = INT_MAX;
+        best = unsorted.next;
+
+        for (ds = unsorted.next; ds != &unsorted; ds = ds->next)
+        {
+            if (ds->scale < bestscale)
+            {
+                bestscale = ds->scale;
+                best = ds;
+            }
+        }
+
+        best->next->prev = best->prev;
+        best->prev->next = best->next;
+        best->next = &vsprsortedhead;
+        best->prev = vsprsortedhead.prev;
+        vsprsortedhead.prev->next = best;
+        vsprsortedhead.prev = best;
+    }
+}
+
+// The sort as R_SortVisSprites does it now.
+
+static int CompareVisSprites(const void *a, const void *b)
+{
+    const vissprite_t *spr1 = *(const vissprite_t **) a;
+    const vissprite_t *spr2 = *(const vissprite_t **) b;
+
+    if (spr1->scale != spr2->scale)
+    {
+        return spr1->scale < spr2->scale ? -1 : 1;
+    }
+
+    return spr1 < spr2 ? -1 : spr1 > spr2;
+}
+
+static void QuickSort(void)
+{
+    int i;
+    int count;
+    vissprite_t *ds;
+
+    count = vissprite_p - vissprites;
+
+    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
+
+    if (!count)
+        return;
+
+    for (i = 0; i < count; i++)
+    {
+        vsprsortbuf[i] = &vissprites[i];
+    }
+
+    qsort(vsprsortbuf, count, sizeof(*vsprsortbuf), CompareVisSprites);
+
+    for (i = 0; i < count; i++)
+    {
+        ds = vsprsortbuf[i];
+        ds->next = &vsprsortedhead;
+        ds->prev = vsprsortedhead.prev;
+        vsprsortedhead.prev->next = ds;
+        vsprsortedhead.prev = ds;
+    }
+}
+
+// One sprite in four has the same scale as another.
+
+static void GenerateSprites(int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (i > 0 && rand() % 4 == 0)
+        {
+            vissprites[i].scale = vissprites[rand() % i].scale;
+        }
+        else
+        {
+            vissprites[i].scale = FRACUNIT / 64 + rand() % (FRACUNIT * 4);
+        }
+    }
+
+    vissprite_p = vissprites + count;
+}
+
+// Returns the sprites in drawing order, as indexes into vissprites.
+
+static void GetOrder(int *order)
+{
+    vissprite_t *ds;
+    int i = 0;
+
+    for (ds = vsprsortedhead.next; ds != &vsprsortedhead; ds = ds->next)
+    {
+        order[i++] = ds - vissprites;
+    }
+}
+
+static void CheckOrder(int count)
+{
+    int *order1, *order2;
+    int i;
+
+    order1 = malloc(count * sizeof(int));
+    order2 = malloc(count * sizeof(int));
+
+    if (order1 == NULL || order2 == NULL)
+    {
+        I_Error("CheckOrder: Out of memory");
+    }
+
+    SelectionSort();
+    GetOrder(order1);
+    QuickSort();
+    GetOrder(order2);
+
+    for (i = 0; i < count; ++i)
+    {
+        if (order1[i] != order2[i])
+        {
+            I_Error("CheckOrder: Sprites drawn in a different order "
+                    "with %i sprites", count);
+        }
+    }
+
+    free(order1);
+    free(order2);
+}
+
+static double Time(void (*sort)(void), int rounds)
+{
+    uint64_t start, end;
+    int i;
+
+    start = SDL_GetPerformanceCounter();
+
+    for (i = 0; i < rounds; ++i)
+    {
+        sort();
+    }
+
+    end = SDL_GetPerformanceCounter();
+
+    return (end - start) * 1e9 / SDL_GetPerformanceFrequency() / rounds;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int i;
+    int count;
+    int rounds;
+
+    myargc = argc;
+    myargv = argv;
+
+    count = sprite_counts[arrlen(sprite_counts) - 1];
+    vissprites = malloc(count * sizeof(vissprite_t));
+    vsprsortbuf = malloc(count * sizeof(vissprite_t *));
+
+    if (vissprites == NULL || vsprsortbuf == NULL)
+    {
+        I_Error("Out of memory");
+    }
+
+    srand(0);
+
+    printf("%8s %14s %14s\n", "sprites", "selection ns", "qsort ns");
+
+    for (i = 0; i < arrlen(sprite_counts); ++i)
+    {
+        count = sprite_counts[i];
+
+        GenerateSprites(count);
+        CheckOrder(count);
+
+        // The selection sort takes time in the square of the count,
+        // so it gets fewer rounds for large counts.
+
+        rounds = ROUNDS_SPRITES / count;
+        printf("%8i %14.0f ", count,
+               Time(SelectionSort, rounds / count + 1));
+        printf("%14.0f\n", Time(QuickSort, rounds));
+    }
+
+    return 0;
+}
@@ -1210,7 +1210,7 @@ static void D_DrawText(const char *string, int bc, int fc)
 // haleyjd 08/28/10: Clip patches to the framebuffer without errors.
 // Returns false if V_DrawPatch should return without drawing.
 //
-boolean D_PatchClipCallback(patch_t *patch, int x, int y)
+boolean D_PatchClipCallback(const patch_t *patch, int x, int y)
 {
     // note that offsets were already accounted for in V_DrawPatch
     return (x >= 0 && y >= 0 
@@ -2126,6 +2126,8 @@ void D_DoomMain (void)
     ST_Init ();
     D_IntroTick(); // [STRIFE]
 
+    W_EndStartup();
+
     // haleyjd [STRIFE] -statcopy used to be here...
     D_IntroTick(); // [STRIFE]
 
@@ -138,14 +138,14 @@ void V_SetPatchClipCallback(vpatchclipfunc_t func)
 // Masks a column based masked pic to the screen. 
 //
 
-void V_DrawPatch(int x, int y, patch_t *patch)
+void V_DrawPatch(int x, int y, const patch_t *patch)
 { 
     int count;
     int col;
-    column_t *column;
+    const column_t *column;
     pixel_t *desttop;
     pixel_t *dest;
-    byte *source;
+    const byte *source;
     int w;
 
     y -= SHORT(patch->topoffset);
@@ -177,12 +177,12 @@ void V_DrawPatch(int x, int y, patch_t *patch)
 
     for ( ; col<w ; x++, col++, desttop++)
     {
-        column = (column_t *)((byte *)patch + LONG(patch->columnofs[col]));
+        column = (const column_t *)((const byte *)patch + LONG(patch->columnofs[col]));
 
         // step through the posts in a column
         while (column->topdelta != 0xff)
         {
-            source = (byte *)column + 3;
+            source = (const byte *)column + 3;
             dest = desttop + column->topdelta*SCREENWIDTH;
             count = column->length;
 
@@ -191,7 +191,7 @@ void V_DrawPatch(int x, int y, patch_t *patch)
                 *dest = *source++;
                 dest += SCREENWIDTH;
             }
-            column = (column_t *)((byte *)column + column->length + 4);
+            column = (const column_t *)((const byte *)column + column->length + 4);
         }
     }
 }
@@ -202,14 +202,14 @@ void V_DrawPatch(int x, int y, patch_t *patch)
 // Flips horizontally, e.g. to mirror face.
 //
 
-void V_DrawPatchFlipped(int x, int y, patch_t *patch)
+void V_DrawPatchFlipped(int x, int y, const patch_t *patch)
 {
     int count;
     int col; 
-    column_t *column; 
+    const column_t *column; 
     pixel_t *desttop;
     pixel_t *dest;
-    byte *source; 
+    const byte *source; 
     int w; 
  
     y -= SHORT(patch->topoffset); 
@@ -241,12 +241,12 @@ void V_DrawPatchFlipped(int x, int y, patch_t *patch)
 
     for ( ; col<w ; x++, col++, desttop++)
     {
-        column = (column_t *)((byte *)patch + LONG(patch->columnofs[w-1-col]));
+        column = (const column_t *)((const byte *)patch + LONG(patch->columnofs[w-1-col]));
 
         // step through the posts in a column
         while (column->topdelta != 0xff )
         {
-            source = (byte *)column + 3;
+            source = (const byte *)column + 3;
             dest = desttop + column->topdelta*SCREENWIDTH;
             count = column->length;
 
@@ -255,7 +255,7 @@ void V_DrawPatchFlipped(int x, int y, patch_t *patch)
                 *dest = *source++;
                 dest += SCREENWIDTH;
             }
-            column = (column_t *)((byte *)column + column->length + 4);
+            column = (const column_t *)((const byte *)column + column->length + 4);
         }
     }
 }
@@ -267,7 +267,7 @@ void V_DrawPatchFlipped(int x, int y, patch_t *patch)
 // Draws directly to the screen on the pc. 
 //
 
-void V_DrawPatchDirect(int x, int y, patch_t *patch)
+void V_DrawPatchDirect(int x, int y, const patch_t *patch)
 {
     V_DrawPatch(x, y, patch); 
 } 
@@ -278,12 +278,12 @@ void V_DrawPatchDirect(int x, int y, patch_t *patch)
 // Masks a column based translucent masked pic to the screen.
 //
 
-void V_DrawTLPatch(int x, int y, patch_t * patch)
+void V_DrawTLPatch(int x, int y, const patch_t * patch)
 {
     int count, col;
-    column_t *column;
+    const column_t *column;
     pixel_t *desttop, *dest;
-    byte *source;
+    const byte *source;
     int w;
 
     y -= SHORT(patch->topoffset);
@@ -303,13 +303,13 @@ void V_DrawTLPatch(int x, int y, patch_t * patch)
     w = SHORT(patch->width);
     for (; col < w; x++, col++, desttop++)
     {
-        column = (column_t *) ((byte *) patch + LONG(patch->columnofs[col]));
+        column = (const column_t *) ((const byte *) patch + LONG(patch->columnofs[col]));
 
         // step through the posts in a column
 
         while (column->topdelta != 0xff)
         {
-            source = (byte *) column + 3;
+            source = (const byte *) column + 3;
             dest = desttop + column->topdelta * SCREENWIDTH;
             count = column->length;
 
@@ -318,7 +318,7 @@ void V_DrawTLPatch(int x, int y, patch_t * patch)
                 *dest = tinttable[((*dest) << 8) + *source++];
                 dest += SCREENWIDTH;
             }
-            column = (column_t *) ((byte *) column + column->length + 4);
+            column = (const column_t *) ((const byte *) column + column->length + 4);
         }
     }
 }
@@ -329,12 +329,12 @@ void V_DrawTLPatch(int x, int y, patch_t * patch)
 // villsa [STRIFE] Masks a column based translucent masked pic to the screen.
 //
 
-void V_DrawXlaPatch(int x, int y, patch_t * patch)
+void V_DrawXlaPatch(int x, int y, const patch_t * patch)
 {
     int count, col;
-    column_t *column;
+    const column_t *column;
     pixel_t *desttop, *dest;
-    byte *source;
+    const byte *source;
     int w;
 
     y -= SHORT(patch->topoffset);
@@ -352,13 +352,13 @@ void V_DrawXlaPatch(int x, int y, patch_t * patch)
     w = SHORT(patch->width);
     for(; col < w; x++, col++, desttop++)
     {
-        column = (column_t *) ((byte *) patch + LONG(patch->columnofs[col]));
+        column = (const column_t *) ((const byte *) patch + LONG(patch->columnofs[col]));
 
         // step through the posts in a column
 
         while(column->topdelta != 0xff)
         {
-            source = (byte *) column + 3;
+            source = (const byte *) column + 3;
             dest = desttop + column->topdelta * SCREENWIDTH;
             count = column->length;
 
@@ -368,7 +368,7 @@ void V_DrawXlaPatch(int x, int y, patch_t * patch)
                 source++;
                 dest += SCREENWIDTH;
             }
-            column = (column_t *) ((byte *) column + column->length + 4);
+            column = (const column_t *) ((const byte *) column + column->length + 4);
         }
     }
 }
@@ -379,12 +379,12 @@ void V_DrawXlaPatch(int x, int y, patch_t * patch)
 // Masks a column based translucent masked pic to the screen.
 //
 
-void V_DrawAltTLPatch(int x, int y, patch_t * patch)
+void V_DrawAltTLPatch(int x, int y, const patch_t * patch)
 {
     int count, col;
-    column_t *column;
+    const column_t *column;
     pixel_t *desttop, *dest;
-    byte *source;
+    const byte *source;
     int w;
 
     y -= SHORT(patch->topoffset);
@@ -404,13 +404,13 @@ void V_DrawAltTLPatch(int x, int y, patch_t * patch)
     w = SHORT(patch->width);
     for (; col < w; x++, col++, desttop++)
     {
-        column = (column_t *) ((byte *) patch + LONG(patch->columnofs[col]));
+        column = (const column_t *) ((const byte *) patch + LONG(patch->columnofs[col]));
 
         // step through the posts in a column
 
         while (column->topdelta != 0xff)
         {
-            source = (byte *) column + 3;
+            source = (const byte *) column + 3;
             dest = desttop + column->topdelta * SCREENWIDTH;
             count = column->length;
 
@@ -419,7 +419,7 @@ void V_DrawAltTLPatch(int x, int y, patch_t * patch)
                 *dest = tinttable[((*dest) << 8) + *source++];
                 dest += SCREENWIDTH;
             }
-            column = (column_t *) ((byte *) column + column->length + 4);
+            column = (const column_t *) ((const byte *) column + column->length + 4);
         }
     }
 }
@@ -430,12 +430,12 @@ void V_DrawAltTLPatch(int x, int y, patch_t * patch)
 // Masks a column based masked pic to the screen.
 //
 
-void V_DrawShadowedPatch(int x, int y, patch_t *patch)
+void V_DrawShadowedPatch(int x, int y, const patch_t *patch)
 {
     int count, col;
-    column_t *column;
+    const column_t *column;
     pixel_t *desttop, *dest;
-    byte *source;
+    const byte *source;
     pixel_t *desttop2, *dest2;
     int w;
 
@@ -457,13 +457,13 @@ void V_DrawShadowedPatch(int x, int y, patch_t *patch)
     w = SHORT(patch->width);
     for (; col < w; x++, col++, desttop++, desttop2++)
     {
-        column = (column_t *) ((byte *) patch + LONG(patch->columnofs[col]));
+        column = (const column_t *) ((const byte *) patch + LONG(patch->columnofs[col]));
 
         // step through the posts in a column
 
         while (column->topdelta != 0xff)
         {
-            source = (byte *) column + 3;
+            source = (const byte *) column + 3;
             dest = desttop + column->topdelta * SCREENWIDTH;
             dest2 = desttop2 + column->topdelta * SCREENWIDTH;
             count = column->length;
@@ -476,7 +476,7 @@ void V_DrawShadowedPatch(int x, int y, patch_t *patch)
                 dest += SCREENWIDTH;
 
             }
-            column = (column_t *) ((byte *) column + column->length + 4);
+            column = (const column_t *) ((const byte *) column + column->length + 4);
         }
     }
 }
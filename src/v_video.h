@@ -41,7 +41,7 @@ extern byte *tinttable;
 // haleyjd 08/28/10: implemented for Strife support
 // haleyjd 08/28/10: Patch clipping callback, implemented to support Choco
 // Strife.
-typedef boolean (*vpatchclipfunc_t)(patch_t *, int, int);
+typedef boolean (*vpatchclipfunc_t)(const patch_t *, int, int);
 void V_SetPatchClipCallback(vpatchclipfunc_t func);
 
 
@@ -54,13 +54,13 @@ void V_CopyRect(int srcx, int srcy, pixel_t *source,
                 int width, int height,
                 int destx, int desty);
 
-void V_DrawPatch(int x, int y, patch_t *patch);
-void V_DrawPatchFlipped(int x, int y, patch_t *patch);
-void V_DrawTLPatch(int x, int y, patch_t *patch);
-void V_DrawAltTLPatch(int x, int y, patch_t * patch);
-void V_DrawShadowedPatch(int x, int y, patch_t *patch);
-void V_DrawXlaPatch(int x, int y, patch_t * patch);     // villsa [STRIFE]
-void V_DrawPatchDirect(int x, int y, patch_t *patch);
+void V_DrawPatch(int x, int y, const patch_t *patch);
+void V_DrawPatchFlipped(int x, int y, const patch_t *patch);
+void V_DrawTLPatch(int x, int y, const patch_t *patch);
+void V_DrawAltTLPatch(int x, int y, const patch_t *patch);
+void V_DrawShadowedPatch(int x, int y, const patch_t *patch);
+void V_DrawXlaPatch(int x, int y, const patch_t *patch);     // villsa [STRIFE]
+void V_DrawPatchDirect(int x, int y, const patch_t *patch);
 
 // Draw a linear block of pixels into the view buffer.
 
@@ -91,6 +91,12 @@ void V_RestoreBuffer(void);
 
 void V_ScreenShot(const char *format);
 
+// Write a paletted screen to a PNG file.  Only there if built with
+// libpng (HAVE_LIBPNG).
+void WritePNGfile(char *filename, pixel_t *data,
+                  int width, int height,
+                  byte *palette);
+
 // Load the lookup table for translucency calculations from the TINTTAB
 // lump.
 
@@ -49,16 +49,31 @@ static wad_file_class_t *wad_file_classes[] =
 wad_file_t *W_OpenFile(const char *path)
 {
     wad_file_t *result;
+    boolean use_mmap;
     int i;
 
     //!
     // @category obscure
     //
     // Use the OS's virtual memory subsystem to map WAD files
-    // directly into memory.
+    // directly into memory.  This is the default on systems that
+    // have mmap().
     //
 
-    if (!M_CheckParm("-mmap"))
+    use_mmap = M_CheckParm("-mmap") > 0;
+
+#ifdef HAVE_MMAP
+    //!
+    // @category obscure
+    //
+    // Read WAD files into memory as lumps are needed, rather than
+    // mapping them.
+    //
+
+    use_mmap = !M_CheckParm("-nommap");
+#endif
+
+    if (!use_mmap)
     {
         return stdc_wad_file.OpenFile(path);
     }
@@ -91,3 +106,12 @@ size_t W_Read(wad_file_t *wad, unsigned int offset,
     return wad->file_class->Read(wad, offset, buffer, buffer_len);
 }
 
+void W_Advise(wad_file_t *wad, unsigned int offset, size_t len,
+              wad_advice_t advice)
+{
+    if (wad->mapped != NULL && wad->file_class->Advise != NULL)
+    {
+        wad->file_class->Advise(wad, offset, len, advice);
+    }
+}
+
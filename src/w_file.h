@@ -25,6 +25,15 @@
 
 typedef struct _wad_file_s wad_file_t;
 
+// Hints about how a memory mapped file is about to be read.
+
+typedef enum
+{
+    WAD_ADVISE_NORMAL,
+    WAD_ADVISE_SEQUENTIAL,
+    WAD_ADVISE_WILLNEED,
+} wad_advice_t;
+
 typedef struct
 {
     // Open a file for reading.
@@ -37,6 +46,11 @@ typedef struct
     // provided buffer.  Returns the number of bytes read.
     size_t (*Read)(wad_file_t *file, unsigned int offset,
                    void *buffer, size_t buffer_len);
+
+    // Tell the OS how part of a mapped file will be read.  May be
+    // NULL if the class has nothing to tell.
+    void (*Advise)(wad_file_t *file, unsigned int offset,
+                   size_t len, wad_advice_t advice);
 } wad_file_class_t;
 
 struct _wad_file_s
@@ -71,4 +85,10 @@ void W_CloseFile(wad_file_t *wad);
 size_t W_Read(wad_file_t *wad, unsigned int offset,
               void *buffer, size_t buffer_len);
 
+// Give the OS a hint about how part of the specified file will be
+// read.  Does nothing unless the file is memory mapped.
+
+void W_Advise(wad_file_t *wad, unsigned int offset, size_t len,
+              wad_advice_t advice);
+
 #endif /* #ifndef __W_FILE__ */
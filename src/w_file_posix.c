@@ -122,6 +122,56 @@ static void W_POSIX_CloseFile(wad_file_t *wad)
     Z_Free(posix_wad);
 }
 
+static void W_POSIX_Advise(wad_file_t *wad, unsigned int offset,
+                           size_t len, wad_advice_t advice)
+{
+    static long page_size = 0;
+    unsigned int start;
+    int flags;
+
+    if (page_size <= 0)
+    {
+        page_size = sysconf(_SC_PAGESIZE);
+
+        if (page_size <= 0)
+        {
+            page_size = 4096;
+        }
+    }
+
+    switch (advice)
+    {
+        case WAD_ADVISE_SEQUENTIAL:
+            flags = MADV_SEQUENTIAL;
+            break;
+
+        case WAD_ADVISE_WILLNEED:
+            flags = MADV_WILLNEED;
+            break;
+
+        default:
+            flags = MADV_NORMAL;
+            break;
+    }
+
+    // madvise() wants the start of a page.
+
+    start = offset - (offset % page_size);
+    len += offset - start;
+
+    if (start >= wad->length)
+    {
+        return;
+    }
+
+    if (len > wad->length - start)
+    {
+        len = wad->length - start;
+    }
+
+    madvise(wad->mapped + start, len, flags);
+}
+
 // Read data from the specified position in the file into the 
 // provided buffer.  Returns the number of bytes read.
 
@@ -170,6 +220,7 @@ wad_file_class_t posix_wad_file =
     W_POSIX_OpenFile,
     W_POSIX_CloseFile,
     W_POSIX_Read,
+    W_POSIX_Advise,
 };
 
 
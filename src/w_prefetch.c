@@ -0,0 +1,459 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Background reading of lumps that will be needed soon.
+//
+//      The game asks for lumps with W_PrefetchLump, and a thread
+//      reads them, in order, into buffers of its own outside the
+//      zone.  When W_ReadLump is later called for one of them, the
+//      data is copied from the buffer instead of being read from
+//      disk.  Each WAD file is opened again for the thread, so that
+//      its reads do not move the file position under the main thread.
+//
+//      Memory-mapped WAD files are not read by the thread; the OS is
+//      asked to page their lumps in instead.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "i_system.h"
+#include "i_thread.h"
+#include "m_argv.h"
+#include "w_file.h"
+#include "w_prefetch.h"
+#include "w_wad.h"
+
+// Stop reading ahead when this much is waiting to be used.
+#define MAX_STAGED_BYTES (8 * 1024 * 1024)
+
+// The number of lumps after a map's marker lump that hold its data.
+#define MAP_LUMPS 10
+
+typedef enum
+{
+    PF_NONE,
+    PF_QUEUED,
+    PF_READING,
+    PF_READY,
+} prefetchstate_t;
+
+// A lump to read, with where it is, so that the thread does not have
+// to look at lumpinfo.
+
+typedef struct
+{
+    lumpindex_t lump;
+    wad_file_t *handle;
+    int position;
+    int size;
+} prefetchreq_t;
+
+// The thread's own handle for a WAD file.  Handles are opened and
+// closed by the main thread, as that uses the zone.
+
+typedef struct
+{
+    wad_file_t *wad_file;
+    wad_file_t *handle;
+} prefetchfile_t;
+
+static boolean prefetch_enabled = false;
+static i_thread_t *prefetch_thread;
+
+// Everything below is protected by prefetch_lock.  prefetch_changed
+// is signalled whenever the queue or the state of a lump changes.
+
+static i_mutex_t *prefetch_lock;
+static i_cond_t *prefetch_changed;
+static boolean shutting_down = false;
+
+static prefetchreq_t *queue = NULL;
+static int queue_pos = 0;
+static int queue_len = 0;
+static int queue_max = 0;
+
+static byte *states = NULL;
+static void **staged = NULL;
+static int staged_bytes = 0;
+static int num_states = 0;
+static int num_reading = 0;
+
+static prefetchfile_t *files = NULL;
+static int num_files = 0;
+
+// Called with the lock held, but reads without it.
+
+static void *ReadRequest(prefetchreq_t *req)
+{
+    void *buf;
+
+    I_UnlockMutex(prefetch_lock);
+
+    buf = malloc(req->size);
+
+    if (buf != NULL
+     && W_Read(req->handle, req->position, buf, req->size) < req->size)
+    {
+        free(buf);
+        buf = NULL;
+    }
+
+    I_LockMutex(prefetch_lock);
+
+    return buf;
+}
+
+static int PrefetchThread(void *unused)
+{
+    prefetchreq_t req;
+    void *buf;
+
+    I_LockMutex(prefetch_lock);
+
+    for (;;)
+    {
+        while (!shutting_down
+            && (queue_pos == queue_len || staged_bytes >= MAX_STAGED_BYTES))
+        {
+            I_CondWait(prefetch_changed, prefetch_lock);
+        }
+
+        if (shutting_down)
+        {
+            break;
+        }
+
+        req = queue[queue_pos];
+        ++queue_pos;
+
+        // Skip lumps that were read by W_ReadLump before we got here.
+        if (states[req.lump] != PF_QUEUED)
+        {
+            continue;
+        }
+
+        states[req.lump] = PF_READING;
+        ++num_reading;
+
+        buf = ReadRequest(&req);
+
+        --num_reading;
+
+        if (buf != NULL)
+        {
+            staged[req.lump] = buf;
+            staged_bytes += req.size;
+            states[req.lump] = PF_READY;
+        }
+        else
+        {
+            // W_ReadLump will read it and report the error.
+            states[req.lump] = PF_NONE;
+        }
+
+        I_CondBroadcast(prefetch_changed);
+    }
+
+    I_UnlockMutex(prefetch_lock);
+
+    return 0;
+}
+
+static void ShutdownPrefetch(void)
+{
+    W_ClosePrefetchFiles();
+
+    I_LockMutex(prefetch_lock);
+    shutting_down = true;
+    I_CondBroadcast(prefetch_changed);
+    I_UnlockMutex(prefetch_lock);
+
+    I_WaitThread(prefetch_thread);
+    prefetch_enabled = false;
+}
+
+void W_InitPrefetch(void)
+{
+    unsigned int i;
+
+    //!
+    // @category obscure
+    //
+    // Don't read lumps ahead of time in a background thread.  Lumps
+    // are only read ahead from WAD files that are not memory mapped,
+    // so this only makes a difference with -nommap or on systems
+    // without mmap().
+    //
+
+    if (M_ParmExists("-noprefetch"))
+    {
+        return;
+    }
+
+    // There is nothing for the thread to do if every WAD file is
+    // memory mapped.
+
+    for (i = 0; i < numlumps; ++i)
+    {
+        if (lumpinfo[i]->wad_file->mapped == NULL)
+        {
+            break;
+        }
+    }
+
+    if (i == numlumps)
+    {
+        return;
+    }
+
+    prefetch_lock = I_CreateMutex();
+    prefetch_changed = I_CreateCond();
+    prefetch_thread = I_CreateThread("prefetch", PrefetchThread, NULL);
+    prefetch_enabled = true;
+
+    I_AtExit(ShutdownPrefetch, false);
+}
+
+// Called with the lock held.
+
+static void GrowStates(void)
+{
+    int i;
+
+    staged = I_Realloc(staged, numlumps * sizeof(void *));
+    states = I_Realloc(states, numlumps);
+
+    for (i = num_states; i < (int) numlumps; ++i)
+    {
+        staged[i] = NULL;
+        states[i] = PF_NONE;
+    }
+
+    num_states = numlumps;
+}
+
+static wad_file_t *GetHandle(wad_file_t *wad_file)
+{
+    wad_file_t *handle;
+    int i;
+
+    for (i = 0; i < num_files; ++i)
+    {
+        if (files[i].wad_file == wad_file)
+        {
+            return files[i].handle;
+        }
+    }
+
+    handle = W_OpenFile(wad_file->path);
+
+    files = I_Realloc(files, (num_files + 1) * sizeof(prefetchfile_t));
+    files[num_files].wad_file = wad_file;
+    files[num_files].handle = handle;
+    ++num_files;
+
+    return handle;
+}
+
+void W_PrefetchLump(lumpindex_t lump)
+{
+    lumpinfo_t *l;
+    wad_file_t *handle;
+
+    if (lump < 0 || lump >= (int) numlumps)
+    {
+        return;
+    }
+
+    l = lumpinfo[lump];
+
+    // A mapped lump does not need reading, but the OS can be asked to
+    // page it in.
+    if (l->wad_file->mapped != NULL)
+    {
+        W_Advise(l->wad_file, l->position, l->size, WAD_ADVISE_WILLNEED);
+        return;
+    }
+
+    if (!prefetch_enabled || l->cache != NULL || l->size <= 0)
+    {
+        return;
+    }
+
+    handle = GetHandle(l->wad_file);
+
+    if (handle == NULL)
+    {
+        return;
+    }
+
+    I_LockMutex(prefetch_lock);
+
+    if (lump >= num_states)
+    {
+        GrowStates();
+    }
+
+    if (states[lump] == PF_NONE)
+    {
+        // Start again at the beginning once the queue has been used up.
+        if (queue_pos == queue_len)
+        {
+            queue_pos = queue_len = 0;
+        }
+
+        if (queue_len == queue_max)
+        {
+            queue_max = queue_max == 0 ? 256 : queue_max * 2;
+            queue = I_Realloc(queue, queue_max * sizeof(prefetchreq_t));
+        }
+
+        queue[queue_len].lump = lump;
+        queue[queue_len].handle = handle;
+        queue[queue_len].position = l->position;
+        queue[queue_len].size = l->size;
+        ++queue_len;
+
+        states[lump] = PF_QUEUED;
+        I_CondBroadcast(prefetch_changed);
+    }
+
+    I_UnlockMutex(prefetch_lock);
+}
+
+void W_PrefetchMap(const char *name)
+{
+    lumpindex_t lump;
+    int i;
+
+    lump = W_CheckNumForName(name);
+
+    if (lump < 0)
+    {
+        return;
+    }
+
+    for (i = 1; i <= MAP_LUMPS; ++i)
+    {
+        W_PrefetchLump(lump + i);
+    }
+}
+
+boolean W_TakePrefetchedLump(lumpindex_t lump, void *dest)
+{
+    void *buf = NULL;
+    int size = 0;
+
+    if (!prefetch_enabled)
+    {
+        return false;
+    }
+
+    I_LockMutex(prefetch_lock);
+
+    if (lump < num_states)
+    {
+        while (states[lump] == PF_READING)
+        {
+            I_CondWait(prefetch_changed, prefetch_lock);
+        }
+
+        if (states[lump] == PF_READY)
+        {
+            buf = staged[lump];
+            size = lumpinfo[lump]->size;
+            staged[lump] = NULL;
+            staged_bytes -= size;
+            I_CondBroadcast(prefetch_changed);
+        }
+
+        // If it is still queued, it is read now instead, and the
+        // thread skips it.
+        states[lump] = PF_NONE;
+    }
+
+    I_UnlockMutex(prefetch_lock);
+
+    if (buf == NULL)
+    {
+        return false;
+    }
+
+    memcpy(dest, buf, size);
+    free(buf);
+
+    return true;
+}
+
+void W_CancelPrefetch(void)
+{
+    int i;
+
+    if (!prefetch_enabled)
+    {
+        return;
+    }
+
+    I_LockMutex(prefetch_lock);
+
+    queue_pos = queue_len = 0;
+
+    while (num_reading > 0)
+    {
+        I_CondWait(prefetch_changed, prefetch_lock);
+    }
+
+    for (i = 0; i < num_states; ++i)
+    {
+        free(staged[i]);
+        staged[i] = NULL;
+        states[i] = PF_NONE;
+    }
+
+    staged_bytes = 0;
+
+    // The thread's file handles are kept for the next level.
+
+    I_UnlockMutex(prefetch_lock);
+}
+
+void W_ClosePrefetchFiles(void)
+{
+    int i;
+
+    if (!prefetch_enabled)
+    {
+        return;
+    }
+
+    W_CancelPrefetch();
+
+    I_LockMutex(prefetch_lock);
+
+    // Nothing is queued or being read, so the handles can be closed.
+    for (i = 0; i < num_files; ++i)
+    {
+        if (files[i].handle != NULL)
+        {
+            W_CloseFile(files[i].handle);
+        }
+    }
+
+    free(files);
+    files = NULL;
+    num_files = 0;
+
+    I_UnlockMutex(prefetch_lock);
+}
@@ -0,0 +1,49 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Background reading of lumps that will be needed soon.
+//
+
+#ifndef __W_PREFETCH__
+#define __W_PREFETCH__
+
+#include "doomtype.h"
+#include "w_wad.h"
+
+// Start the prefetch thread, unless -noprefetch was given.  Call
+// after all WAD files have been added.
+void W_InitPrefetch(void);
+
+// Ask for a lump to be read in the background.  Does nothing if the
+// lump is already cached or on its way.  For a memory-mapped lump the
+// OS is asked to page it in instead.
+void W_PrefetchLump(lumpindex_t lump);
+
+// Ask for a map's lumps, from the marker lump to the blockmap.
+void W_PrefetchMap(const char *name);
+
+// Called by W_ReadLump: if the lump has been prefetched, copy it into
+// dest and return true.  Waits if the lump is being read.
+boolean W_TakePrefetchedLump(lumpindex_t lump, void *dest);
+
+// Forget every lump asked for, free those already read, and wait for
+// any read in progress.  Called at each level start, so that lumps
+// read ahead for a map that was never loaded do not stay in memory.
+void W_CancelPrefetch(void);
+
+// As W_CancelPrefetch, and also close the thread's handles for the
+// WAD files.  Must be called before a WAD file is closed.
+void W_ClosePrefetchFiles(void);
+
+#endif
@@ -0,0 +1,521 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Cache of data worked out from the WAD files at startup.
+//
+//      Reading WAD directories, texture definitions and sprite
+//      lists takes a while when many PWADs are loaded.  The results
+//      are kept in a file in the config directory, as named sections
+//      of flat data, each with a SHA1 key made from everything that
+//      the data was worked out from.  On the next run with the same
+//      files, the sections are used instead.  The file is opened with
+//      W_OpenFile, so it is memory mapped where possible.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "config.h"
+
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_config.h"
+#include "m_misc.h"
+#include "w_startup.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#define CACHE_FILENAME  "startup.cache"
+#define CACHE_MAGIC     "CDSTART1"
+
+// Checked on load, so that a cache from a machine with the other byte
+// order is ignored.
+#define CACHE_BYTE_ORDER 0x01020304
+
+// Sections that were not used this time are dropped when the file
+// would grow beyond this.
+#define MAX_CACHE_SIZE  (4 * 1024 * 1024)
+
+typedef struct
+{
+    char magic[8];
+    int byte_order;
+    int num_sections;
+    int length;
+
+    // Of everything after the header.
+    unsigned int checksum;
+} cacheheader_t;
+
+typedef struct
+{
+    char name[8];
+    sha1_digest_t key;
+    int offset;
+    int length;
+} cachesection_t;
+
+typedef struct
+{
+    char name[8];
+    sha1_digest_t key;
+    const byte *data;
+    int length;
+    boolean used;
+} cacheentry_t;
+
+static boolean cache_loaded = false;
+static boolean cache_enabled = false;
+static boolean cache_changed = false;
+static wad_file_t *cache_file = NULL;
+static byte *cache_data = NULL;
+
+static cacheentry_t *entries = NULL;
+static int num_entries = 0;
+
+void W_StartupKeyFile(sha1_context_t *context, wad_file_t *wad)
+{
+    struct stat st;
+
+    SHA1_UpdateString(context, wad->path);
+    SHA1_UpdateInt32(context, wad->length);
+
+    if (stat(wad->path, &st) == 0)
+    {
+        SHA1_UpdateInt32(context, (unsigned int) st.st_mtime);
+        SHA1_UpdateInt32(context, (unsigned int) ((uint64_t) st.st_mtime >> 32));
+
+        // A file saved twice in the same second, at the same size,
+        // can only be told apart by the fraction of a second.
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+        SHA1_UpdateInt32(context, (unsigned int) st.st_mtim.tv_nsec);
+#endif
+    }
+}
+
+// Add a 32-bit word to a 64-bit FNV-1a hash.
+
+static uint64_t HashWord(uint64_t hash, uint32_t word)
+{
+    return (hash ^ word) * 1099511628211ull;
+}
+
+// The directory can have thousands of entries, so it goes through a
+// 64-bit FNV hash first, which is much quicker than SHA1 on this
+// many small pieces.
+
+void W_StartupKeyLumps(sha1_context_t *context)
+{
+    wad_file_t **files = NULL;
+    int num_files = 0;
+    lumpinfo_t *lump;
+    uint32_t name[2];
+    uint64_t hash;
+    unsigned int i;
+    int j;
+
+    hash = 14695981039346656037ull;
+
+    for (i = 0; i < numlumps; ++i)
+    {
+        lump = lumpinfo[i];
+
+        for (j = 0; j < num_files; ++j)
+        {
+            if (files[j] == lump->wad_file)
+            {
+                break;
+            }
+        }
+
+        if (j == num_files)
+        {
+            files = I_Realloc(files, (num_files + 1) * sizeof(wad_file_t *));
+            files[num_files] = lump->wad_file;
+            ++num_files;
+        }
+
+        memcpy(name, lump->name, sizeof(name));
+        hash = HashWord(hash, name[0]);
+        hash = HashWord(hash, name[1]);
+        hash = HashWord(hash, j);
+        hash = HashWord(hash, lump->position);
+        hash = HashWord(hash, lump->size);
+    }
+
+    SHA1_UpdateInt32(context, numlumps);
+    SHA1_UpdateInt32(context, (unsigned int) hash);
+    SHA1_UpdateInt32(context, (unsigned int) (hash >> 32));
+
+    for (j = 0; j < num_files; ++j)
+    {
+        W_StartupKeyFile(context, files[j]);
+    }
+
+    free(files);
+}
+
+static char *CachePath(void)
+{
+    return M_StringJoin(configdir, CACHE_FILENAME, NULL);
+}
+
+static void AddEntry(const char *name, sha1_digest_t key,
+                     const byte *data, int length)
+{
+    cacheentry_t *entry;
+
+    entries = I_Realloc(entries, (num_entries + 1) * sizeof(cacheentry_t));
+    entry = &entries[num_entries];
+    ++num_entries;
+
+    memset(entry->name, 0, sizeof(entry->name));
+    strncpy(entry->name, name, sizeof(entry->name));
+    memcpy(entry->key, key, sizeof(sha1_digest_t));
+    entry->data = data;
+    entry->length = length;
+    entry->used = false;
+}
+
+// A quick check that the file was written out whole; the data is
+// always a whole number of 32-bit words.
+
+static unsigned int Checksum(const byte *data, int length)
+{
+    const uint32_t *p = (const uint32_t *) data;
+    unsigned int result = 2166136261u;
+    int i;
+
+    for (i = 0; i < length / 4; ++i)
+    {
+        result = (result ^ p[i]) * 16777619u;
+    }
+
+    return result;
+}
+
+// Check the file and read its list of sections.
+
+static void ParseCache(void)
+{
+    cacheheader_t *header;
+    cachesection_t *sections;
+    int length;
+    int i;
+
+    length = cache_file->length;
+    header = (cacheheader_t *) cache_data;
+
+    if (length < (int) sizeof(cacheheader_t)
+     || memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0
+     || header->byte_order != CACHE_BYTE_ORDER
+     || header->length != length
+     || header->num_sections < 0
+     || header->num_sections > (length - (int) sizeof(cacheheader_t))
+                              / (int) sizeof(cachesection_t))
+    {
+        return;
+    }
+
+    // A file cut short, or written by two games at once, is ignored.
+    if (Checksum(cache_data + sizeof(cacheheader_t),
+                 length - sizeof(cacheheader_t)) != header->checksum)
+    {
+        return;
+    }
+
+    sections = (cachesection_t *) (cache_data + sizeof(cacheheader_t));
+
+    for (i = 0; i < header->num_sections; ++i)
+    {
+        if (sections[i].offset < 0 || sections[i].length < 0
+         || sections[i].offset > length
+         || sections[i].length > length - sections[i].offset)
+        {
+            num_entries = 0;
+            return;
+        }
+
+        AddEntry(sections[i].name, sections[i].key,
+                 cache_data + sections[i].offset, sections[i].length);
+    }
+}
+
+static void LoadCache(void)
+{
+    struct stat st;
+    char *path;
+
+    cache_loaded = true;
+
+    //!
+    // @category obscure
+    //
+    // Don't use or write the cache of WAD directories, texture
+    // definitions and sprite lists that speeds up startup.
+    //
+
+    if (configdir == NULL || M_ParmExists("-nostartupcache"))
+    {
+        return;
+    }
+
+    cache_enabled = true;
+
+    path = CachePath();
+
+    if (stat(path, &st) == 0 && st.st_size >= sizeof(cacheheader_t))
+    {
+        cache_file = W_OpenFile(path);
+    }
+
+    free(path);
+
+    if (cache_file == NULL)
+    {
+        return;
+    }
+
+    if (cache_file->mapped != NULL)
+    {
+        cache_data = cache_file->mapped;
+    }
+    else
+    {
+        cache_data = Z_Malloc(cache_file->length, PU_STATIC, NULL);
+
+        if (W_Read(cache_file, 0, cache_data, cache_file->length)
+              < cache_file->length)
+        {
+            return;
+        }
+    }
+
+    ParseCache();
+}
+
+static cacheentry_t *FindEntry(const char *name, sha1_digest_t key)
+{
+    int i;
+
+    for (i = 0; i < num_entries; ++i)
+    {
+        if (!strncmp(entries[i].name, name, sizeof(entries[i].name))
+         && !memcmp(entries[i].key, key, sizeof(sha1_digest_t)))
+        {
+            return &entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+const void *W_GetStartupCache(const char *name, sha1_digest_t key,
+                              int *length)
+{
+    cacheentry_t *entry;
+
+    if (!cache_loaded)
+    {
+        LoadCache();
+    }
+
+    entry = FindEntry(name, key);
+
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+
+    entry->used = true;
+    *length = entry->length;
+
+    return entry->data;
+}
+
+void W_AddStartupCache(const char *name, sha1_digest_t key,
+                       const void *data, int length)
+{
+    cacheentry_t *entry;
+    byte *copy;
+
+    if (!cache_loaded)
+    {
+        LoadCache();
+    }
+
+    if (!cache_enabled)
+    {
+        return;
+    }
+
+    copy = malloc(length);
+
+    if (copy == NULL)
+    {
+        return;
+    }
+
+    memcpy(copy, data, length);
+
+    // A section that was found to be bad when it was loaded is
+    // replaced by the one worked out again.
+
+    entry = FindEntry(name, key);
+
+    if (entry == NULL)
+    {
+        AddEntry(name, key, copy, length);
+        entry = &entries[num_entries - 1];
+    }
+    else
+    {
+        entry->data = copy;
+        entry->length = length;
+    }
+
+    entry->used = true;
+    cache_changed = true;
+}
+
+static int Align(int offset)
+{
+    return (offset + 7) & ~7;
+}
+
+// Write the sections used or added this time first, then any others
+// that still fit.
+
+void W_WriteStartupCache(void)
+{
+    cacheheader_t header;
+    cachesection_t *sections;
+    cacheentry_t **order;
+    char *path, *temp_path;
+    byte *buf;
+    int num_sections;
+    int offset;
+    int pass;
+    int i;
+
+    if (!cache_changed)
+    {
+        return;
+    }
+
+    cache_changed = false;
+
+    order = malloc(num_entries * sizeof(cacheentry_t *));
+    sections = malloc(num_entries * sizeof(cachesection_t));
+
+    if (order == NULL || sections == NULL)
+    {
+        free(order);
+        free(sections);
+        return;
+    }
+
+    num_sections = 0;
+    offset = sizeof(cacheheader_t);
+
+    for (pass = 0; pass < 2; ++pass)
+    {
+        for (i = 0; i < num_entries; ++i)
+        {
+            if (entries[i].used != (pass == 0))
+            {
+                continue;
+            }
+
+            if (pass == 1
+             && Align(offset + entries[i].length)
+                 + (num_sections + 1) * (int) sizeof(cachesection_t)
+                    > MAX_CACHE_SIZE)
+            {
+                break;
+            }
+
+            order[num_sections] = &entries[i];
+            offset = Align(offset + entries[i].length);
+            ++num_sections;
+        }
+    }
+
+    // Lay the file out: header, section list, then the data.
+
+    offset = Align(sizeof(cacheheader_t)
+                 + num_sections * sizeof(cachesection_t));
+
+    for (i = 0; i < num_sections; ++i)
+    {
+        memcpy(sections[i].name, order[i]->name, sizeof(sections[i].name));
+        memcpy(sections[i].key, order[i]->key, sizeof(sha1_digest_t));
+        sections[i].offset = offset;
+        sections[i].length = order[i]->length;
+        offset = Align(offset + order[i]->length);
+    }
+
+    buf = malloc(offset);
+
+    if (buf == NULL)
+    {
+        free(order);
+        free(sections);
+        return;
+    }
+
+    memset(buf, 0, offset);
+    memcpy(buf + sizeof(cacheheader_t), sections,
+           num_sections * sizeof(cachesection_t));
+
+    for (i = 0; i < num_sections; ++i)
+    {
+        memcpy(buf + sections[i].offset, order[i]->data, order[i]->length);
+    }
+
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.byte_order = CACHE_BYTE_ORDER;
+    header.num_sections = num_sections;
+    header.length = offset;
+
+    header.checksum = Checksum(buf + sizeof(cacheheader_t),
+                               offset - sizeof(cacheheader_t));
+
+    memcpy(buf, &header, sizeof(cacheheader_t));
+
+    // Write to a new file and rename it over the old one, which may
+    // still be mapped.
+
+    path = CachePath();
+    temp_path = M_StringJoin(path, ".tmp", NULL);
+
+    if (M_WriteFile(temp_path, buf, offset)
+     && rename(temp_path, path) != 0)
+    {
+        remove(path);
+
+        if (rename(temp_path, path) != 0)
+        {
+            remove(temp_path);
+        }
+    }
+
+    free(temp_path);
+    free(path);
+    free(buf);
+    free(order);
+    free(sections);
+}
@@ -0,0 +1,46 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Cache of data worked out from the WAD files at startup.
+//
+
+#ifndef __W_STARTUP__
+#define __W_STARTUP__
+
+#include "doomtype.h"
+#include "sha1.h"
+#include "w_file.h"
+
+// Add the identity of a WAD file (its path, length and modification
+// time) to a key.
+void W_StartupKeyFile(sha1_context_t *context, wad_file_t *wad);
+
+// Add the whole lump directory to a key, along with the identity of
+// every file in it.
+void W_StartupKeyLumps(sha1_context_t *context);
+
+// Look up a section of the cache.  Returns NULL if there is no section
+// with this name and key.  The data stays valid until the game exits.
+const void *W_GetStartupCache(const char *name, sha1_digest_t key,
+                              int *length);
+
+// Add a section to the cache, replacing any with the same name and
+// key.  The data is copied.
+void W_AddStartupCache(const char *name, sha1_digest_t key,
+                       const void *data, int length);
+
+// Write the cache file, if anything was added to it.
+void W_WriteStartupCache(void);
+
+#endif
@@ -28,11 +28,14 @@
 
 #include "i_swap.h"
 #include "i_system.h"
+#include "i_thread.h"
 #include "i_video.h"
 #include "m_misc.h"
 #include "v_diskicon.h"
 #include "z_zone.h"
 
+#include "w_prefetch.h"
+#include "w_startup.h"
 #include "w_wad.h"
 
 typedef PACKED_STRUCT (
@@ -59,8 +62,18 @@ typedef PACKED_STRUCT (
 lumpinfo_t **lumpinfo;
 unsigned int numlumps = 0;
 
-// Hash table for fast lookups
-static lumpindex_t *lumphash;
+// Hash table for fast lookups.  Open addressing, with each name
+// packed into a 64-bit key, so that a lookup is one hash and some
+// integer compares.  An entry with a lump of -1 is empty.
+
+typedef struct
+{
+    uint64_t key;
+    lumpindex_t lump;
+} lumphashentry_t;
+
+static lumphashentry_t *lumphash;
+static unsigned int lumphash_mask;
 
 // Variables for the reload hack: filename of the PWAD to reload, and the
 // lumps from WADs before the reload file, so we can resent numlumps and
@@ -87,10 +100,55 @@ unsigned int W_LumpNameHash(const char *s)
     return result;
 }
 
+// Pack a lump name into a 64-bit key, upper case and padded with
+// zeros, so that two names are the same when their keys are.
+static uint64_t LumpNameKey(const char *s)
+{
+    uint64_t result = 0;
+    unsigned int i;
+    byte c;
+
+    for (i = 0; i < 8 && s[i] != '\0'; ++i)
+    {
+        c = s[i];
+
+        if (c >= 'a' && c <= 'z')
+        {
+            c -= 'a' - 'A';
+        }
+
+        result |= (uint64_t) c << (i * 8);
+    }
+
+    return result;
+}
+
+static unsigned int LumpKeySlot(uint64_t key)
+{
+    return (unsigned int) ((key * 0x9e3779b97f4a7c15ull) >> 32)
+         & lumphash_mask;
+}
+
 //
 // LUMP BASED ROUTINES.
 //
 
+// Look for the directory of a WAD file in the startup cache.  The
+// key is filled in either way, for W_AddFile to add the directory if
+// it was not found.
+
+static const void *StartupCachedDirectory(wad_file_t *wad_file,
+                                          sha1_digest_t key, int *length)
+{
+    sha1_context_t sha1_context;
+
+    SHA1_Init(&sha1_context);
+    W_StartupKeyFile(&sha1_context, wad_file);
+    SHA1_Final(key, &sha1_context);
+
+    return W_GetStartupCache("WADDIR", key, length);
+}
+
 //
 // W_AddFile
 // All files are optional, but at least one file must be
@@ -111,6 +169,8 @@ wad_file_t *W_AddFile (const char *filename)
     filelump_t *filerover;
     lumpinfo_t *filelumps;
     int numfilelumps;
+    sha1_digest_t dirkey;
+    const void *cached;
 
     // If the filename begins with a ~, it indicates that we should use the
     // reload hack.
@@ -140,6 +200,10 @@ wad_file_t *W_AddFile (const char *filename)
 	return NULL;
     }
 
+    // Most of a WAD is read from start to end while the game starts,
+    // so let the OS read well ahead until W_EndStartup is called.
+    W_Advise(wad_file, 0, wad_file->length, WAD_ADVISE_SEQUENTIAL);
+
     if (strcasecmp(filename+strlen(filename)-3 , "wad" ) )
     {
 	// single lump file
@@ -159,6 +223,15 @@ wad_file_t *W_AddFile (const char *filename)
 	M_ExtractFileBase (filename, fileinfo->name);
 	numfilelumps = 1;
     }
+    else if ((cached = StartupCachedDirectory(wad_file, dirkey, &length))
+               != NULL)
+    {
+        // The directory was read the last time this file was loaded.
+
+	fileinfo = Z_Malloc(length, PU_STATIC, 0);
+        memcpy(fileinfo, cached, length);
+	numfilelumps = length / sizeof(filelump_t);
+    }
     else
     {
 	// WAD file
@@ -194,6 +267,8 @@ wad_file_t *W_AddFile (const char *filename)
 
         W_Read(wad_file, header.infotableofs, fileinfo, length);
 	numfilelumps = header.numlumps;
+
+        W_AddStartupCache("WADDIR", dirkey, fileinfo, length);
     }
 
     // Increase size of numlumps array to accomodate the new file.
@@ -266,17 +341,19 @@ lumpindex_t W_CheckNumForName(const char *name)
 
     if (lumphash != NULL)
     {
-        int hash;
+        uint64_t key;
+        unsigned int slot;
 
         // We do! Excellent.
 
-        hash = W_LumpNameHash(name) % numlumps;
+        key = LumpNameKey(name);
 
-        for (i = lumphash[hash]; i != -1; i = lumpinfo[i]->next)
+        for (slot = LumpKeySlot(key); lumphash[slot].lump != -1;
+             slot = (slot + 1) & lumphash_mask)
         {
-            if (!strncasecmp(lumpinfo[i]->name, name, 8))
+            if (lumphash[slot].key == key)
             {
-                return i;
+                return lumphash[slot].lump;
             }
         }
     }
@@ -355,6 +432,11 @@ void W_ReadLump(lumpindex_t lump, void *dest)
 
     l = lumpinfo[lump];
 
+    if (W_TakePrefetchedLump(lump, dest))
+    {
+        return;
+    }
+
     V_BeginRead(l->size);
 
     c = W_Read(l->wad_file, l->position, dest, l->size);
@@ -384,6 +466,7 @@ void W_ReadLump(lumpindex_t lump, void *dest)
 void *W_CacheLumpNum(lumpindex_t lumpnum, int tag)
 {
     byte *result;
+    void *data;
     lumpinfo_t *lump;
 
     if ((unsigned)lumpnum >= numlumps)
@@ -413,10 +496,14 @@ void *W_CacheLumpNum(lumpindex_t lumpnum, int tag)
     }
     else
     {
-        // Not yet loaded, so load it now
-
-        lump->cache = Z_Malloc(W_LumpLength(lumpnum), tag, &lump->cache);
-	W_ReadLump (lumpnum, lump->cache);
+        // Not yet loaded, so load it now.  lump->cache is only set
+        // once the lump has been read, after a release barrier, as
+        // Doom's drawing threads look at it without locking.
+
+        data = Z_Malloc(W_LumpLength(lumpnum), tag, &data);
+        W_ReadLump(lumpnum, data);
+        I_MemoryBarrierRelease();
+        Z_ChangeUser(data, &lump->cache);
         result = lump->cache;
     }
 	
@@ -433,6 +520,24 @@ void *W_CacheLumpName(const char *name, int tag)
     return W_CacheLumpNum(W_GetNumForName(name), tag);
 }
 
+//
+// Read-only versions of W_CacheLumpNum and W_CacheLumpName, for
+// callers that only look at the lump.  In a memory-mapped file the
+// pointer is into the mapping itself; as long as nothing writes to
+// it, the pages stay shared with the OS's file cache instead of
+// being copied.
+//
+
+const void *W_CacheLumpNumConst(lumpindex_t lumpnum, int tag)
+{
+    return W_CacheLumpNum(lumpnum, tag);
+}
+
+const void *W_CacheLumpNameConst(const char *name, int tag)
+{
+    return W_CacheLumpNum(W_GetNumForName(name), tag);
+}
+
 // 
 // Release a lump back to the cache, so that it can be reused later 
 // without having to read from disk again, or alternatively, discarded
@@ -544,39 +649,76 @@ void W_Profile (void)
 void W_GenerateHashTable(void)
 {
     lumpindex_t i;
+    unsigned int size;
 
     // Free the old hash table, if there is one:
     if (lumphash != NULL)
     {
         Z_Free(lumphash);
+        lumphash = NULL;
     }
 
     // Generate hash table
     if (numlumps > 0)
     {
-        lumphash = Z_Malloc(sizeof(lumpindex_t) * numlumps, PU_STATIC, NULL);
+        // Keep the table at most half full, so that runs of used
+        // entries stay short.
 
-        for (i = 0; i < numlumps; ++i)
+        for (size = 16; size < numlumps * 2; size <<= 1);
+
+        lumphash = Z_Malloc(sizeof(lumphashentry_t) * size, PU_STATIC, NULL);
+        lumphash_mask = size - 1;
+
+        for (i = 0; i < size; ++i)
         {
-            lumphash[i] = -1;
+            lumphash[i].lump = -1;
         }
 
         for (i = 0; i < numlumps; ++i)
         {
-            unsigned int hash;
+            uint64_t key;
+            unsigned int slot;
+
+            key = LumpNameKey(lumpinfo[i]->name);
+            slot = LumpKeySlot(key);
 
-            hash = W_LumpNameHash(lumpinfo[i]->name) % numlumps;
+            while (lumphash[slot].lump != -1 && lumphash[slot].key != key)
+            {
+                slot = (slot + 1) & lumphash_mask;
+            }
 
-            // Hook into the hash table
+            // Later lumps replace earlier ones with the same name, so
+            // that PWADs override the IWAD.
 
-            lumpinfo[i]->next = lumphash[hash];
-            lumphash[hash] = i;
+            lumphash[slot].key = key;
+            lumphash[slot].lump = i;
         }
     }
 
     // All done!
 }
 
+// Called when the game has finished starting up.  From now on lumps
+// are read in any order, so stop the OS from reading far ahead in
+// memory-mapped files.  Anything new in the startup cache is saved.
+
+void W_EndStartup(void)
+{
+    wad_file_t *last = NULL;
+    unsigned int i;
+
+    for (i = 0; i < numlumps; ++i)
+    {
+        if (lumpinfo[i]->wad_file != last)
+        {
+            last = lumpinfo[i]->wad_file;
+            W_Advise(last, 0, last->length, WAD_ADVISE_NORMAL);
+        }
+    }
+
+    W_WriteStartupCache();
+}
+
 // The Doom reload hack. The idea here is that if you give a WAD file to -file
 // prefixed with the ~ hack, that WAD file will be reloaded each time a new
 // level is loaded. This lets you use a level editor in parallel and make
@@ -593,6 +735,9 @@ void W_Reload(void)
         return;
     }
 
+    // The prefetch thread has the file open too.
+    W_ClosePrefetchFiles();
+
     // We must free any lumps being cached from the PWAD we're about to reload:
     for (i = reloadlump; i < numlumps; ++i)
     {
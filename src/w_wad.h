@@ -44,9 +44,6 @@ struct lumpinfo_s
     int		position;
     int		size;
     void       *cache;
-
-    // Used for hash table lookups
-    lumpindex_t next;
 };
 
 
@@ -64,8 +61,11 @@ void W_ReadLump(lumpindex_t lump, void *dest);
 
 void *W_CacheLumpNum(lumpindex_t lump, int tag);
 void *W_CacheLumpName(const char *name, int tag);
+const void *W_CacheLumpNumConst(lumpindex_t lump, int tag);
+const void *W_CacheLumpNameConst(const char *name, int tag);
 
 void W_GenerateHashTable(void);
+void W_EndStartup(void);
 
 extern unsigned int W_LumpNameHash(const char *s);
 
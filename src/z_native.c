@@ -45,6 +45,10 @@ struct memblock_s
  
 static memblock_t *allocated_blocks[PU_NUM_TAGS];
 
+// If false, the cache is not cleared to make room; see Z_EnablePurging.
+
+static boolean purge_enabled = true;
+
 #ifdef TESTING
 
 static int test_malloced = 0;
@@ -134,7 +138,7 @@ void Z_Init (void)
 //
 // Z_Free
 //
-void Z_Free (void* ptr)
+void Z_Free2 (void* ptr, const char *file, int line)
 {
     memblock_t*		block;
 
@@ -170,6 +174,11 @@ static boolean ClearCache(int size)
     memblock_t *next_block;
     int remaining;
 
+    if (!purge_enabled)
+    {
+        return false;
+    }
+
     block = allocated_blocks[PU_CACHE];
 
     if (block == NULL)
@@ -228,7 +237,7 @@ static boolean ClearCache(int size)
 // You can pass a NULL user if the tag is < PU_PURGELEVEL.
 //
 
-void *Z_Malloc(int size, int tag, void *user)
+void *Z_Malloc2(int size, int tag, void *user, const char *file, int line)
 {
     memblock_t *newblock;
     unsigned char *data;
@@ -285,6 +294,18 @@ void *Z_Malloc(int size, int tag, void *user)
 
 
 
+//
+// Z_EnablePurging
+//
+// Purging is disabled while other threads may be reading from
+// purgable blocks, so that an allocation cannot free them.
+//
+
+void Z_EnablePurging(boolean enable)
+{
+    purge_enabled = enable;
+}
+
 //
 // Z_FreeTags
 //
@@ -0,0 +1,784 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Size class zone allocator.  Uses the same memory as the
+//      default zone allocator, with the same tags, purging and
+//      user pointers, but finds free blocks without walking the
+//      whole heap.
+//
+//      Every block starts with a header holding its own size and
+//      the size of the block before it (a boundary tag), so that
+//      a freed block can be merged with its neighbours directly.
+//      Free blocks up to SMALL_MAX bytes are kept in one list for
+//      each size; larger ones are kept in a tree ordered by size
+//      and address, and the smallest one that fits is used.
+//
+//      Only when no free block is big enough are purgable blocks
+//      freed, starting from where the last purge left off.
+//
+
+#include <string.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "m_argv.h"
+
+#include "z_zone.h"
+#include "z_sizeclass.h"
+#include "z_trace.h"
+
+#define ZONEID  0x1d4a11
+
+// Block sizes are multiples of GRANULE, which is also the alignment
+// of the memory returned.
+
+#define GRANULE 16
+
+typedef struct memblock_s
+{
+    int         size;           // including the header
+    int         prevsize;       // size of the previous block; 0 if none
+    int         tag;            // PU_FREE if this is free
+    int         id;             // should be ZONEID
+    void**      user;
+} memblock_t;
+
+// Free blocks keep their links where the data would be.
+
+typedef struct
+{
+    memblock_t* next;           // same size class
+    memblock_t* prev;
+    memblock_t* left;           // tree of large blocks
+    memblock_t* right;
+} freelinks_t;
+
+#define HEADER_SIZE ((sizeof(memblock_t) + GRANULE - 1) & ~(GRANULE - 1))
+#define MIN_BLOCK   ((HEADER_SIZE + sizeof(freelinks_t) + GRANULE - 1) \
+                     & ~(GRANULE - 1))
+
+// Don't split off free blocks smaller than this.
+#define MINFRAGMENT 64
+
+// Largest block kept in a size class list.
+#define SMALL_MAX   512
+#define NUM_SMALL   (SMALL_MAX / GRANULE + 1)
+
+#define LINKS(block)  ((freelinks_t *) ((byte *) (block) + HEADER_SIZE))
+#define DATA(block)   ((void *) ((byte *) (block) + HEADER_SIZE))
+#define NEXT(block)   ((memblock_t *) ((byte *) (block) + (block)->size))
+#define PREV(block)   ((memblock_t *) ((byte *) (block) - (block)->prevsize))
+
+static byte *zonebase;
+static int zonesize;
+
+// First block, and a header after the last block that is never free.
+static memblock_t *heapstart;
+static memblock_t *heapend;
+
+static memblock_t *smallbins[NUM_SMALL];
+static uint64_t smallmap;              // bit set for each non-empty list
+static memblock_t *largetree;
+
+// Where the next purge starts.
+static memblock_t *rover;
+
+static boolean zero_on_free;
+static boolean scan_on_free;
+static boolean purge_enabled = true;
+
+//
+// Tree of large free blocks.  It is a treap: ordered by size, then
+// address, and balanced by a priority made from the address.
+//
+
+static unsigned int Priority(memblock_t *block)
+{
+    return (unsigned int) ((uintptr_t) block / GRANULE) * 2654435761u;
+}
+
+static boolean TreeLess(memblock_t *a, memblock_t *b)
+{
+    if (a->size != b->size)
+    {
+        return a->size < b->size;
+    }
+
+    return a < b;
+}
+
+static memblock_t *RotateLeft(memblock_t *node)
+{
+    memblock_t *right = LINKS(node)->right;
+
+    LINKS(node)->right = LINKS(right)->left;
+    LINKS(right)->left = node;
+
+    return right;
+}
+
+static memblock_t *RotateRight(memblock_t *node)
+{
+    memblock_t *left = LINKS(node)->left;
+
+    LINKS(node)->left = LINKS(left)->right;
+    LINKS(left)->right = node;
+
+    return left;
+}
+
+static memblock_t *TreeInsert(memblock_t *node, memblock_t *block)
+{
+    if (node == NULL)
+    {
+        LINKS(block)->left = LINKS(block)->right = NULL;
+        return block;
+    }
+
+    if (TreeLess(block, node))
+    {
+        LINKS(node)->left = TreeInsert(LINKS(node)->left, block);
+
+        if (Priority(LINKS(node)->left) > Priority(node))
+        {
+            node = RotateRight(node);
+        }
+    }
+    else
+    {
+        LINKS(node)->right = TreeInsert(LINKS(node)->right, block);
+
+        if (Priority(LINKS(node)->right) > Priority(node))
+        {
+            node = RotateLeft(node);
+        }
+    }
+
+    return node;
+}
+
+static memblock_t *TreeJoin(memblock_t *left, memblock_t *right)
+{
+    if (left == NULL)
+    {
+        return right;
+    }
+
+    if (right == NULL)
+    {
+        return left;
+    }
+
+    if (Priority(left) > Priority(right))
+    {
+        LINKS(left)->right = TreeJoin(LINKS(left)->right, right);
+        return left;
+    }
+    else
+    {
+        LINKS(right)->left = TreeJoin(left, LINKS(right)->left);
+        return right;
+    }
+}
+
+static memblock_t *TreeRemove(memblock_t *node, memblock_t *block)
+{
+    if (node == block)
+    {
+        return TreeJoin(LINKS(node)->left, LINKS(node)->right);
+    }
+
+    if (TreeLess(block, node))
+    {
+        LINKS(node)->left = TreeRemove(LINKS(node)->left, block);
+    }
+    else
+    {
+        LINKS(node)->right = TreeRemove(LINKS(node)->right, block);
+    }
+
+    return node;
+}
+
+// Smallest block in the tree of at least the given size.
+
+static memblock_t *TreeBestFit(int size)
+{
+    memblock_t *node, *best;
+
+    best = NULL;
+    node = largetree;
+
+    while (node != NULL)
+    {
+        if (node->size >= size)
+        {
+            best = node;
+            node = LINKS(node)->left;
+        }
+        else
+        {
+            node = LINKS(node)->right;
+        }
+    }
+
+    return best;
+}
+
+//
+// Free block lists.
+//
+
+static void InsertFree(memblock_t *block)
+{
+    freelinks_t *links = LINKS(block);
+    int bin;
+
+    block->tag = PU_FREE;
+
+    if (block->size > SMALL_MAX)
+    {
+        largetree = TreeInsert(largetree, block);
+        return;
+    }
+
+    bin = block->size / GRANULE;
+    links->prev = NULL;
+    links->next = smallbins[bin];
+
+    if (links->next != NULL)
+    {
+        LINKS(links->next)->prev = block;
+    }
+
+    smallbins[bin] = block;
+    smallmap |= (uint64_t) 1 << bin;
+}
+
+static void RemoveFree(memblock_t *block)
+{
+    freelinks_t *links = LINKS(block);
+    int bin;
+
+    if (block->size > SMALL_MAX)
+    {
+        largetree = TreeRemove(largetree, block);
+        return;
+    }
+
+    bin = block->size / GRANULE;
+
+    if (links->prev != NULL)
+    {
+        LINKS(links->prev)->next = links->next;
+    }
+    else
+    {
+        smallbins[bin] = links->next;
+
+        if (links->next == NULL)
+        {
+            smallmap &= ~((uint64_t) 1 << bin);
+        }
+    }
+
+    if (links->next != NULL)
+    {
+        LINKS(links->next)->prev = links->prev;
+    }
+}
+
+static memblock_t *FindFree(int size)
+{
+    uint64_t map;
+    int bin;
+
+    if (size <= SMALL_MAX)
+    {
+        bin = size / GRANULE;
+        map = smallmap >> bin;
+
+        if (map != 0)
+        {
+            while ((map & 1) == 0)
+            {
+                map >>= 1;
+                ++bin;
+            }
+
+            return smallbins[bin];
+        }
+    }
+
+    return TreeBestFit(size);
+}
+
+//
+// ZS_Init
+//
+void ZS_Init(void)
+{
+    byte *start, *end;
+    int size;
+
+    zonebase = I_ZoneBase(&size);
+    zonesize = size;
+
+    start = (byte *) (((uintptr_t) zonebase + GRANULE - 1)
+                      & ~(uintptr_t) (GRANULE - 1));
+    end = (byte *) (((uintptr_t) zonebase + size - HEADER_SIZE)
+                    & ~(uintptr_t) (GRANULE - 1));
+
+    memset(smallbins, 0, sizeof(smallbins));
+    smallmap = 0;
+    largetree = NULL;
+
+    heapstart = (memblock_t *) start;
+    heapstart->size = end - start;
+    heapstart->prevsize = 0;
+    heapstart->user = NULL;
+    heapstart->id = 0;
+
+    heapend = (memblock_t *) end;
+    heapend->size = 0;
+    heapend->prevsize = heapstart->size;
+    heapend->tag = PU_STATIC;
+    heapend->user = NULL;
+    heapend->id = 0;
+
+    InsertFree(heapstart);
+
+    Z_TraceZone(zonebase, zonesize, HEADER_SIZE);
+    rover = heapstart;
+
+    zero_on_free = M_ParmExists("-zonezero");
+    scan_on_free = M_ParmExists("-zonescan");
+}
+
+// Scan the zone heap for pointers within the specified range, and warn about
+// any remaining pointers.
+static void ScanForBlock(void *start, void *end)
+{
+    memblock_t *block;
+    void **mem;
+    int i, len, tag;
+
+    for (block = heapstart; block != heapend; block = NEXT(block))
+    {
+        tag = block->tag;
+
+        if (tag == PU_STATIC || tag == PU_LEVEL || tag == PU_LEVSPEC)
+        {
+            mem = DATA(block);
+            len = (block->size - HEADER_SIZE) / sizeof(void *);
+
+            for (i = 0; i < len; ++i)
+            {
+                if (start <= mem[i] && mem[i] <= end)
+                {
+                    fprintf(stderr,
+                            "%p has dangling pointer into freed block "
+                            "%p (%p -> %p)\n",
+                            mem, start, &mem[i], mem[i]);
+                }
+            }
+        }
+    }
+}
+
+//
+// FreeBlock
+// Frees a block and merges it with free blocks either side,
+// returning the merged block.
+//
+static memblock_t *FreeBlock(memblock_t *block)
+{
+    memblock_t *other;
+
+    if (block->id != ZONEID)
+    {
+        I_Error("Z_Free: freed a pointer without ZONEID");
+    }
+
+    if (block->user != NULL)
+    {
+        // clear the user's mark
+        *block->user = NULL;
+    }
+
+    block->user = NULL;
+    block->id = 0;
+
+    if (zero_on_free)
+    {
+        memset(DATA(block), 0, block->size - HEADER_SIZE);
+    }
+    if (scan_on_free)
+    {
+        ScanForBlock(DATA(block), (byte *) block + block->size);
+    }
+
+    other = NEXT(block);
+
+    if (other->tag == PU_FREE)
+    {
+        RemoveFree(other);
+        block->size += other->size;
+
+        if (other == rover)
+        {
+            rover = block;
+        }
+    }
+
+    if (block->prevsize != 0)
+    {
+        other = PREV(block);
+
+        if (other->tag == PU_FREE)
+        {
+            RemoveFree(other);
+            other->size += block->size;
+
+            if (block == rover)
+            {
+                rover = other;
+            }
+
+            block = other;
+        }
+    }
+
+    NEXT(block)->prevsize = block->size;
+    InsertFree(block);
+
+    return block;
+}
+
+//
+// PurgeForSpace
+// Frees purgable blocks in address order, starting at the rover,
+// until there is a free block of at least the given size.
+//
+static memblock_t *PurgeForSpace(int size)
+{
+    memblock_t *block;
+    int pass;
+
+    if (!purge_enabled)
+    {
+        return NULL;
+    }
+
+    block = rover;
+
+    // From the rover to the end of the heap, then from the start.
+
+    for (pass = 0; pass < 2; ++pass)
+    {
+        while (block != heapend)
+        {
+            if (block->tag >= PU_PURGELEVEL)
+            {
+                Z_TracePurge(DATA(block));
+                block = FreeBlock(block);
+
+                if (block->size >= size)
+                {
+                    return block;
+                }
+            }
+
+            block = NEXT(block);
+        }
+
+        block = heapstart;
+    }
+
+    return NULL;
+}
+
+//
+// ZS_Malloc
+//
+void *ZS_Malloc(int size, int tag, void *user, const char *file, int line)
+{
+    memblock_t *block, *newblock;
+    int blocksize;
+    int extra;
+    void *result;
+    boolean purged;
+
+    if (user == NULL && tag >= PU_PURGELEVEL)
+    {
+        I_Error("Z_Malloc: an owner is required for purgable blocks");
+    }
+
+    blocksize = (size + HEADER_SIZE + GRANULE - 1) & ~(GRANULE - 1);
+
+    if (blocksize < MIN_BLOCK)
+    {
+        blocksize = MIN_BLOCK;
+    }
+
+    block = FindFree(blocksize);
+    purged = false;
+
+    if (block == NULL)
+    {
+        block = PurgeForSpace(blocksize);
+
+        if (block == NULL)
+        {
+            Z_TraceFailed(size, tag, file, line);
+            I_Error("Z_Malloc: failed on allocation of %i bytes", blocksize);
+        }
+
+        purged = true;
+    }
+
+    RemoveFree(block);
+
+    extra = block->size - blocksize;
+
+    if (extra > MINFRAGMENT)
+    {
+        // there will be a free fragment after the allocated block
+        newblock = (memblock_t *) ((byte *) block + blocksize);
+        newblock->size = extra;
+        newblock->prevsize = blocksize;
+        newblock->user = NULL;
+        newblock->id = 0;
+        NEXT(newblock)->prevsize = extra;
+        InsertFree(newblock);
+
+        block->size = blocksize;
+    }
+
+    block->user = user;
+    block->tag = tag;
+    block->id = ZONEID;
+
+    result = DATA(block);
+
+    if (user != NULL)
+    {
+        *block->user = result;
+    }
+
+    // The next purge carries on after this block, so that the cache
+    // is purged in address order like a ring buffer.
+    if (purged)
+    {
+        rover = NEXT(block);
+
+        if (rover == heapend)
+        {
+            rover = heapstart;
+        }
+    }
+
+    Z_TraceMalloc(result, size, block->size, tag, file, line);
+
+    return result;
+}
+
+static memblock_t *BlockForPointer(void *ptr, const char *func)
+{
+    memblock_t *block;
+
+    block = (memblock_t *) ((byte *) ptr - HEADER_SIZE);
+
+    if (block->id != ZONEID)
+    {
+        I_Error("%s: block without a ZONEID!", func);
+    }
+
+    return block;
+}
+
+//
+// ZS_Free
+//
+void ZS_Free(void *ptr, const char *file, int line)
+{
+    Z_TraceFree(ptr, file, line);
+    FreeBlock(BlockForPointer(ptr, "Z_Free"));
+}
+
+//
+// ZS_FreeTags
+//
+void ZS_FreeTags(int lowtag, int hightag)
+{
+    memblock_t *block;
+
+    Z_TraceFreeTags(lowtag, hightag);
+
+    for (block = heapstart; block != heapend; block = NEXT(block))
+    {
+        if (block->tag != PU_FREE
+         && block->tag >= lowtag && block->tag <= hightag)
+        {
+            block = FreeBlock(block);
+        }
+    }
+}
+
+void ZS_EnablePurging(boolean enable)
+{
+    purge_enabled = enable;
+}
+
+//
+// ZS_DumpHeap
+//
+void ZS_DumpHeap(int lowtag, int hightag)
+{
+    memblock_t *block;
+
+    printf("zone size: %i  location: %p\n", zonesize, zonebase);
+    printf("tag range: %i to %i\n", lowtag, hightag);
+
+    for (block = heapstart; block != heapend; block = NEXT(block))
+    {
+        if (block->tag >= lowtag && block->tag <= hightag)
+        {
+            printf("block:%p    size:%7i    user:%p    tag:%3i\n",
+                   block, block->size, block->user, block->tag);
+        }
+
+        if (NEXT(block)->prevsize != block->size)
+        {
+            printf("ERROR: next block doesn't have proper back link\n");
+        }
+
+        if (block->tag == PU_FREE && NEXT(block)->tag == PU_FREE)
+        {
+            printf("ERROR: two consecutive free blocks\n");
+        }
+    }
+}
+
+//
+// ZS_FileDumpHeap
+//
+void ZS_FileDumpHeap(FILE *f)
+{
+    memblock_t *block;
+
+    fprintf(f, "zone size: %i  location: %p\n", zonesize, zonebase);
+
+    for (block = heapstart; block != heapend; block = NEXT(block))
+    {
+        fprintf(f, "block:%p    size:%7i    user:%p    tag:%3i\n",
+                block, block->size, block->user, block->tag);
+
+        if (NEXT(block)->prevsize != block->size)
+        {
+            fprintf(f, "ERROR: next block doesn't have proper back link\n");
+        }
+
+        if (block->tag == PU_FREE && NEXT(block)->tag == PU_FREE)
+        {
+            fprintf(f, "ERROR: two consecutive free blocks\n");
+        }
+    }
+}
+
+//
+// ZS_CheckHeap
+//
+void ZS_CheckHeap(void)
+{
+    memblock_t *block;
+
+    for (block = heapstart; block != heapend; block = NEXT(block))
+    {
+        if (block->size < MIN_BLOCK || (byte *) NEXT(block) > (byte *) heapend)
+        {
+            I_Error("Z_CheckHeap: block size does not touch the next block\n");
+        }
+
+        if (NEXT(block)->prevsize != block->size)
+        {
+            I_Error("Z_CheckHeap: next block doesn't have proper back link\n");
+        }
+
+        if (block->tag == PU_FREE && NEXT(block)->tag == PU_FREE)
+        {
+            I_Error("Z_CheckHeap: two consecutive free blocks\n");
+        }
+    }
+}
+
+//
+// ZS_ChangeTag2
+//
+void ZS_ChangeTag2(void *ptr, int tag, const char *file, int line)
+{
+    memblock_t *block;
+
+    block = (memblock_t *) ((byte *) ptr - HEADER_SIZE);
+
+    if (block->id != ZONEID)
+    {
+        I_Error("%s:%i: Z_ChangeTag: block without a ZONEID!",
+                file, line);
+    }
+
+    if (tag >= PU_PURGELEVEL && block->user == NULL)
+    {
+        I_Error("%s:%i: Z_ChangeTag: an owner is required "
+                "for purgable blocks", file, line);
+    }
+
+    Z_TraceChangeTag(ptr, tag, file, line);
+    block->tag = tag;
+}
+
+void ZS_ChangeUser(void *ptr, void **user)
+{
+    memblock_t *block;
+
+    block = BlockForPointer(ptr, "Z_ChangeUser");
+    block->user = user;
+    *user = ptr;
+}
+
+//
+// ZS_FreeMemory
+//
+int ZS_FreeMemory(void)
+{
+    memblock_t *block;
+    int free;
+
+    free = 0;
+
+    for (block = heapstart; block != heapend; block = NEXT(block))
+    {
+        if (block->tag == PU_FREE || block->tag >= PU_PURGELEVEL)
+        {
+            free += block->size;
+        }
+    }
+
+    return free;
+}
+
+unsigned int ZS_ZoneSize(void)
+{
+    return zonesize;
+}
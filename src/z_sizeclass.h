@@ -0,0 +1,40 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Size class zone allocator, used instead of the default zone
+//      allocator with -zonesizeclass.  Each function behaves as the
+//      Z_ function of the same name.
+//
+
+#ifndef __Z_SIZECLASS__
+#define __Z_SIZECLASS__
+
+#include <stdio.h>
+
+#include "doomtype.h"
+
+void    ZS_Init(void);
+void*   ZS_Malloc(int size, int tag, void *user, const char *file, int line);
+void    ZS_Free(void *ptr, const char *file, int line);
+void    ZS_FreeTags(int lowtag, int hightag);
+void    ZS_EnablePurging(boolean enable);
+void    ZS_DumpHeap(int lowtag, int hightag);
+void    ZS_FileDumpHeap(FILE *f);
+void    ZS_CheckHeap(void);
+void    ZS_ChangeTag2(void *ptr, int tag, const char *file, int line);
+void    ZS_ChangeUser(void *ptr, void **user);
+int     ZS_FreeMemory(void);
+unsigned int ZS_ZoneSize(void);
+
+#endif
@@ -0,0 +1,452 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Zone allocation traces.  With -zonetrace, every allocation,
+//      free, tag change and purge made by the zone allocator is
+//      written to a binary file, with the source file and line that
+//      made it, so that it can be replayed (see zonebench.c) or
+//      summarised (see zonereport.c) later.
+//
+//      Source file names are written once each, in a ZT_FILENAME
+//      record, and then referred to by number.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_misc.h"
+
+#include "z_trace.h"
+
+#define TRACE_MAGIC "ZTRC"
+#define TRACE_VERSION 2
+
+// File numbers fit in 16 bits; number 0 is used when the file is not
+// known.
+
+#define MAX_FILES 1024
+
+static FILE *trace_file = NULL;
+
+// While writing: file name pointers given so far, by hash of the
+// pointer, with the number of each.
+
+static const char *file_keys[MAX_FILES];
+static int file_ids[MAX_FILES];
+static int num_files = 0;
+
+// While reading: file name for each number.
+
+static char *file_names[MAX_FILES];
+
+static void WriteInt(FILE *stream, uint64_t val, int bytes)
+{
+    byte buf[8];
+    int i;
+
+    for (i = 0; i < bytes; ++i)
+    {
+        buf[i] = (val >> (i * 8)) & 0xff;
+    }
+
+    fwrite(buf, 1, bytes, stream);
+}
+
+static boolean ReadInt(FILE *stream, uint64_t *val, int bytes)
+{
+    byte buf[8];
+    int i;
+
+    if (fread(buf, 1, bytes, stream) != bytes)
+    {
+        return false;
+    }
+
+    *val = 0;
+
+    for (i = 0; i < bytes; ++i)
+    {
+        *val |= (uint64_t) buf[i] << (i * 8);
+    }
+
+    return true;
+}
+
+static void TraceClose(void)
+{
+    if (trace_file != NULL)
+    {
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+}
+
+void Z_InitTrace(void)
+{
+    int p;
+
+    //!
+    // @arg <filename>
+    // @category obscure
+    //
+    // Write every zone memory allocation, free, tag change and purge
+    // to the given file, with the source file and line that made it.
+    //
+
+    p = M_CheckParmWithArgs("-zonetrace", 1);
+
+    if (p == 0)
+    {
+        return;
+    }
+
+    trace_file = fopen(myargv[p + 1], "wb");
+
+    if (trace_file == NULL)
+    {
+        I_Error("Z_InitTrace: Unable to open %s for writing", myargv[p + 1]);
+    }
+
+    fwrite(TRACE_MAGIC, 1, 4, trace_file);
+    WriteInt(trace_file, TRACE_VERSION, 4);
+
+    // The trace is closed on I_Error too, so that it ends with the
+    // allocation that failed.
+    I_AtExit(TraceClose, true);
+}
+
+// Get the number for a source file name, writing the name to the
+// trace the first time it is seen.  __FILE__ gives the same pointer
+// for every call in a file, so the pointer is used as the key.
+
+static int FileNumber(const char *file)
+{
+    unsigned int i;
+    size_t len;
+
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    i = (unsigned int) (((uintptr_t) file >> 2) * 2654435761u) % MAX_FILES;
+
+    while (file_keys[i] != NULL)
+    {
+        if (file_keys[i] == file)
+        {
+            return file_ids[i];
+        }
+
+        i = (i + 1) % MAX_FILES;
+    }
+
+    // Keep one slot empty, so that the search above always ends.
+    if (num_files >= MAX_FILES - 2)
+    {
+        return 0;
+    }
+
+    ++num_files;
+    file_keys[i] = file;
+    file_ids[i] = num_files;
+
+    len = strlen(file);
+
+    WriteInt(trace_file, ZT_FILENAME, 1);
+    WriteInt(trace_file, num_files, 2);
+    WriteInt(trace_file, len, 2);
+    fwrite(file, 1, len, trace_file);
+
+    return num_files;
+}
+
+static void WriteEvent(ztraceop_t op, void *ptr)
+{
+    WriteInt(trace_file, op, 1);
+    WriteInt(trace_file, (uintptr_t) ptr, 8);
+}
+
+// The file number is looked up before anything else is written, as
+// it may write a ZT_FILENAME record first.
+
+static void WriteEventAt(ztraceop_t op, void *ptr, const char *file)
+{
+    int filenum = FileNumber(file);
+
+    WriteEvent(op, ptr);
+    WriteInt(trace_file, filenum, 2);
+}
+
+void Z_TraceZone(void *base, int size, int headersize)
+{
+    if (trace_file != NULL)
+    {
+        WriteEvent(ZT_ZONE, base);
+        WriteInt(trace_file, size, 4);
+        WriteInt(trace_file, headersize, 4);
+    }
+}
+
+void Z_TraceMalloc(void *ptr, int size, int blocksize, int tag,
+                   const char *file, int line)
+{
+    if (trace_file != NULL)
+    {
+        WriteEventAt(ZT_MALLOC, ptr, file);
+        WriteInt(trace_file, line, 4);
+        WriteInt(trace_file, size, 4);
+        WriteInt(trace_file, blocksize, 4);
+        WriteInt(trace_file, tag, 1);
+    }
+}
+
+void Z_TraceFailed(int size, int tag, const char *file, int line)
+{
+    if (trace_file != NULL)
+    {
+        WriteEventAt(ZT_FAILED, NULL, file);
+        WriteInt(trace_file, line, 4);
+        WriteInt(trace_file, size, 4);
+        WriteInt(trace_file, tag, 1);
+    }
+}
+
+void Z_TraceFree(void *ptr, const char *file, int line)
+{
+    if (trace_file != NULL)
+    {
+        WriteEventAt(ZT_FREE, ptr, file);
+        WriteInt(trace_file, line, 4);
+    }
+}
+
+void Z_TracePurge(void *ptr)
+{
+    if (trace_file != NULL)
+    {
+        WriteEvent(ZT_PURGE, ptr);
+    }
+}
+
+void Z_TraceChangeTag(void *ptr, int tag, const char *file, int line)
+{
+    if (trace_file != NULL)
+    {
+        WriteEventAt(ZT_CHANGETAG, ptr, file);
+        WriteInt(trace_file, line, 4);
+        WriteInt(trace_file, tag, 1);
+    }
+}
+
+void Z_TraceFreeTags(int lowtag, int hightag)
+{
+    if (trace_file != NULL)
+    {
+        WriteInt(trace_file, ZT_FREETAGS, 1);
+        WriteInt(trace_file, lowtag, 1);
+        WriteInt(trace_file, hightag, 1);
+    }
+}
+
+FILE *Z_OpenTrace(const char *filename)
+{
+    FILE *stream;
+    char magic[4];
+    uint64_t version;
+    int i;
+
+    stream = fopen(filename, "rb");
+
+    if (stream == NULL)
+    {
+        I_Error("Z_OpenTrace: Unable to open %s", filename);
+    }
+
+    if (fread(magic, 1, 4, stream) != 4
+     || memcmp(magic, TRACE_MAGIC, 4) != 0
+     || !ReadInt(stream, &version, 4))
+    {
+        I_Error("Z_OpenTrace: %s is not a zone trace file", filename);
+    }
+
+    if (version != TRACE_VERSION)
+    {
+        I_Error("Z_OpenTrace: %s is a version %i zone trace; only "
+                "version %i is supported", filename, (int) version,
+                TRACE_VERSION);
+    }
+
+    for (i = 0; i < MAX_FILES; ++i)
+    {
+        free(file_names[i]);
+        file_names[i] = NULL;
+    }
+
+    file_names[0] = M_StringDuplicate("?");
+
+    return stream;
+}
+
+static boolean ReadFileName(FILE *stream)
+{
+    uint64_t num, len;
+    char *name;
+
+    if (!ReadInt(stream, &num, 2) || !ReadInt(stream, &len, 2)
+     || num == 0 || num >= MAX_FILES)
+    {
+        return false;
+    }
+
+    name = malloc(len + 1);
+
+    if (name == NULL || fread(name, 1, len, stream) != len)
+    {
+        free(name);
+        return false;
+    }
+
+    name[len] = '\0';
+    free(file_names[num]);
+    file_names[num] = name;
+
+    return true;
+}
+
+static boolean ReadCaller(FILE *stream, ztracerecord_t *record)
+{
+    uint64_t num, line;
+
+    if (!ReadInt(stream, &num, 2) || !ReadInt(stream, &line, 4)
+     || num >= MAX_FILES || file_names[num] == NULL)
+    {
+        return false;
+    }
+
+    record->file = file_names[num];
+    record->line = line;
+
+    return true;
+}
+
+boolean Z_ReadTraceRecord(FILE *stream, ztracerecord_t *record)
+{
+    uint64_t op, val;
+
+    memset(record, 0, sizeof(*record));
+
+    for (;;)
+    {
+        if (!ReadInt(stream, &op, 1))
+        {
+            return false;
+        }
+
+        if (op != ZT_FILENAME)
+        {
+            break;
+        }
+
+        if (!ReadFileName(stream))
+        {
+            return false;
+        }
+    }
+
+    record->op = op;
+
+    if (op == ZT_FREETAGS)
+    {
+        if (!ReadInt(stream, &val, 1))
+        {
+            return false;
+        }
+        record->tag = val;
+
+        if (!ReadInt(stream, &val, 1))
+        {
+            return false;
+        }
+        record->hightag = val;
+
+        return true;
+    }
+
+    if (!ReadInt(stream, &record->ptr, 8))
+    {
+        return false;
+    }
+
+    switch (op)
+    {
+        case ZT_ZONE:
+            if (!ReadInt(stream, &val, 4))
+            {
+                return false;
+            }
+            record->size = val;
+
+            if (!ReadInt(stream, &val, 4))
+            {
+                return false;
+            }
+            record->headersize = val;
+            return true;
+
+        case ZT_MALLOC:
+        case ZT_FAILED:
+            if (!ReadCaller(stream, record) || !ReadInt(stream, &val, 4))
+            {
+                return false;
+            }
+            record->size = val;
+
+            if (op == ZT_MALLOC)
+            {
+                if (!ReadInt(stream, &val, 4))
+                {
+                    return false;
+                }
+                record->blocksize = val;
+            }
+
+            if (!ReadInt(stream, &val, 1))
+            {
+                return false;
+            }
+            record->tag = val;
+            return true;
+
+        case ZT_CHANGETAG:
+            if (!ReadCaller(stream, record) || !ReadInt(stream, &val, 1))
+            {
+                return false;
+            }
+            record->tag = val;
+            return true;
+
+        case ZT_FREE:
+            return ReadCaller(stream, record);
+
+        case ZT_PURGE:
+            return true;
+
+        default:
+            return false;
+    }
+}
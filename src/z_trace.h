@@ -0,0 +1,73 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Zone allocation traces.  See zonereport.c and zonebench.c for
+//      the tools that read them.
+//
+
+#ifndef __Z_TRACE__
+#define __Z_TRACE__
+
+#include <stdio.h>
+
+#include "doomtype.h"
+
+typedef enum
+{
+    ZT_MALLOC,
+    ZT_FREE,
+    ZT_PURGE,
+    ZT_CHANGETAG,
+    ZT_FREETAGS,
+    ZT_ZONE,            // the zone was set up
+    ZT_FAILED,          // an allocation failed
+    ZT_FILENAME,        // used internally, never returned by the reader
+} ztraceop_t;
+
+// One event read back from a trace.  Blocks are identified by the
+// address they had when the trace was recorded.
+
+typedef struct
+{
+    ztraceop_t op;
+    uint64_t ptr;       // zone base address for ZT_ZONE
+    int size;           // ZT_MALLOC, ZT_FAILED; zone size for ZT_ZONE
+    int blocksize;      // ZT_MALLOC, including the header
+    int headersize;     // ZT_ZONE: block header size before each pointer
+    int tag;            // ZT_MALLOC, ZT_CHANGETAG, ZT_FAILED;
+                        // low tag for ZT_FREETAGS
+    int hightag;        // ZT_FREETAGS
+    const char *file;   // caller of ZT_MALLOC, ZT_FREE, ZT_CHANGETAG
+    int line;           // and ZT_FAILED
+} ztracerecord_t;
+
+// Start writing a trace if -zonetrace was given.  Called by Z_Init.
+void Z_InitTrace(void);
+
+void Z_TraceZone(void *base, int size, int headersize);
+void Z_TraceMalloc(void *ptr, int size, int blocksize, int tag,
+                   const char *file, int line);
+void Z_TraceFailed(int size, int tag, const char *file, int line);
+void Z_TraceFree(void *ptr, const char *file, int line);
+void Z_TracePurge(void *ptr);
+void Z_TraceChangeTag(void *ptr, int tag, const char *file, int line);
+void Z_TraceFreeTags(int lowtag, int hightag);
+
+// Reading a trace back.  Z_OpenTrace exits with an error if the file
+// is not a zone trace.  Only one trace can be read at a time: the
+// file names in records point into a table that Z_OpenTrace resets.
+FILE *Z_OpenTrace(const char *filename);
+boolean Z_ReadTraceRecord(FILE *stream, ztracerecord_t *record);
+
+#endif
@@ -23,6 +23,8 @@
 #include "m_argv.h"
 
 #include "z_zone.h"
+#include "z_sizeclass.h"
+#include "z_trace.h"
 
 
 //
@@ -68,6 +70,53 @@ static memzone_t *mainzone;
 static boolean zero_on_free;
 static boolean scan_on_free;
 
+// If false, Z_Malloc leaves purgable blocks alone; see Z_EnablePurging.
+static boolean purge_enabled = true;
+
+// If true, all calls are passed on to the size class allocator.
+static boolean sizeclass_zone = false;
+
+
+//
+// LEVEL ARENAS
+//
+// Blocks with a level tag and no user do not get a zone block of
+// their own.  They are cut one after another from large chunks,
+// which are zone blocks with the same tag, so Z_FreeTags only has
+// to free the chunks and forget the arena.  Blocks freed during the
+// level are kept to be reused for blocks of the same size.
+//
+// If the zone has no room for another chunk, the rest of the level
+// blocks with that tag get zone blocks of their own.
+//
+// A freed block is handed out again by the next allocation of the
+// same size, much sooner than the zone would reuse it.  Vanilla demos
+// depend on what stale pointers to freed mobjs read, so the arenas
+// are only used with -levelarenas.
+//
+
+#define ARENAID		0x1d4a12
+#define ARENA_CHUNK	(32 * 1024)
+
+// Larger blocks get zone blocks of their own.
+#define ARENA_MAX_BLOCK	(ARENA_CHUNK / 8)
+
+// Freed blocks up to this size are kept in a list for each size.
+#define ARENA_SMALL	1024
+#define ARENA_BINS	(ARENA_SMALL / MEM_ALIGN + 1)
+
+typedef struct
+{
+    byte*		pos;		// free space in the current chunk
+    byte*		end;
+    memblock_t*		bins[ARENA_BINS];
+    memblock_t*		large;		// freed blocks over ARENA_SMALL
+    boolean		full;		// no room for another chunk
+} arena_t;
+
+static arena_t arenas[PU_PURGELEVEL - PU_LEVEL];
+static boolean use_arenas;
+
 
 //
 // Z_ClearZone
@@ -103,6 +152,23 @@ void Z_Init (void)
     memblock_t*	block;
     int		size;
 
+    Z_InitTrace();
+
+    //!
+    // @category obscure
+    //
+    // Use a zone allocator that keeps free blocks in lists by size
+    // and in a tree, rather than searching the whole heap for a
+    // free block on each allocation.
+    //
+
+    if (M_ParmExists("-zonesizeclass"))
+    {
+        sizeclass_zone = true;
+        ZS_Init();
+        return;
+    }
+
     mainzone = (memzone_t *)I_ZoneBase (&size);
     mainzone->size = size;
 
@@ -122,6 +188,8 @@ void Z_Init (void)
 
     block->size = mainzone->size - sizeof(memzone_t);
 
+    Z_TraceZone(mainzone, mainzone->size, sizeof(memblock_t));
+
     // [Deliberately undocumented]
     // Zone memory debugging flag. If set, memory is zeroed after it is freed
     // to deliberately break any code that attempts to use it after free.
@@ -133,6 +201,19 @@ void Z_Init (void)
     // heap is scanned to look for remaining pointers to the freed block.
     //
     scan_on_free = M_ParmExists("-zonescan");
+
+    //!
+    // @category obscure
+    //
+    // Allocate level blocks from a chunk of memory for each level
+    // tag, rather than giving each its own zone block.  Freed blocks
+    // are reused sooner than in vanilla, which can break demo sync.
+    //
+
+    // -zonescan would find stale pointers in freed blocks in the
+    // chunks, so it turns the arenas off.
+    use_arenas = M_ParmExists("-levelarenas") && !scan_on_free;
+    memset(arenas, 0, sizeof(arenas));
 }
 
 // Scan the zone heap for pointers within the specified range, and warn about
@@ -173,9 +254,10 @@ static void ScanForBlock(void *start, void *end)
 }
 
 //
-// Z_Free
+// FreeBlock
+// Frees a block, whether by Z_Free or by purging it.
 //
-void Z_Free (void* ptr)
+static void FreeBlock (void* ptr)
 {
     memblock_t*		block;
     memblock_t*		other;
@@ -237,19 +319,24 @@ void Z_Free (void* ptr)
 }
 
 
-
 //
-// Z_Malloc
-// You can pass a NULL user if the tag is < PU_PURGELEVEL.
+// ZoneMalloc
+// Allocates a zone block.  Arena chunks are allocated with is_chunk
+// set: if there is no room, NULL is returned rather than exiting with
+// an error, and the chunk is not traced, as the blocks cut from it
+// are traced instead.
 //
 #define MINFRAGMENT		64
 
 
-void*
-Z_Malloc
+static void*
+ZoneMalloc
 ( int		size,
   int		tag,
-  void*		user )
+  void*		user,
+  const char*	file,
+  int		line,
+  boolean	is_chunk )
 {
     int		extra;
     memblock_t*	start;
@@ -257,7 +344,9 @@ Z_Malloc
     memblock_t* newblock;
     memblock_t*	base;
     void *result;
+    int requested;
 
+    requested = size;
     size = (size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
     
     // scan through the block list,
@@ -283,12 +372,16 @@ Z_Malloc
         if (rover == start)
         {
             // scanned all the way around the list
+            if (is_chunk)
+                return NULL;
+
+            Z_TraceFailed (requested, tag, file, line);
             I_Error ("Z_Malloc: failed on allocation of %i bytes", size);
         }
 	
         if (rover->tag != PU_FREE)
         {
-            if (rover->tag < PU_PURGELEVEL)
+            if (rover->tag < PU_PURGELEVEL || !purge_enabled)
             {
                 // hit a block that can't be purged,
                 // so move base past it
@@ -300,7 +393,8 @@ Z_Malloc
 
                 // the rover can be the base block
                 base = base->prev;
-                Z_Free ((byte *)rover+sizeof(memblock_t));
+                Z_TracePurge ((byte *)rover+sizeof(memblock_t));
+                FreeBlock ((byte *)rover+sizeof(memblock_t));
                 base = base->next;
                 rover = base->next;
             }
@@ -349,11 +443,194 @@ Z_Malloc
     mainzone->rover = base->next;	
 	
     base->id = ZONEID;
+
+    if (!is_chunk)
+        Z_TraceMalloc(result, requested, base->size, tag, file, line);
    
     return result;
 }
 
 
+//
+// ArenaMalloc
+// Allocates a block in the arena for a level tag.
+//
+static void *ArenaMalloc (int size, int tag, const char *file, int line)
+{
+    arena_t*	arena;
+    memblock_t*	block;
+    memblock_t**	prev;
+    byte*	chunk;
+    int		requested;
+
+    arena = &arenas[tag - PU_LEVEL];
+    requested = size;
+    size = ((size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1)) + sizeof(memblock_t);
+    block = NULL;
+
+    if (size <= ARENA_SMALL)
+    {
+        block = arena->bins[size / MEM_ALIGN];
+
+        if (block != NULL)
+            arena->bins[size / MEM_ALIGN] = block->next;
+    }
+    else
+    {
+        // reuse a freed block if one fits without wasting too much
+        for (prev = &arena->large; *prev != NULL; prev = &(*prev)->next)
+        {
+            if ((*prev)->size >= size && (*prev)->size <= size * 2)
+            {
+                block = *prev;
+                *prev = block->next;
+                break;
+            }
+        }
+    }
+
+    if (block == NULL)
+    {
+        if (arena->end - arena->pos < size)
+        {
+            chunk = NULL;
+
+            if (!arena->full)
+            {
+                chunk = ZoneMalloc (ARENA_CHUNK, tag, NULL, file, line, true);
+                arena->full = chunk == NULL;
+            }
+
+            if (chunk == NULL)
+                return ZoneMalloc (requested, tag, NULL, file, line, false);
+
+            arena->pos = chunk;
+            arena->end = chunk + ARENA_CHUNK;
+        }
+
+        block = (memblock_t *) arena->pos;
+        block->size = size;
+        arena->pos += size;
+    }
+
+    block->user = NULL;
+    block->tag = tag;
+    block->id = ARENAID;
+    block->next = NULL;
+    block->prev = NULL;
+
+    Z_TraceMalloc((byte *)block + sizeof(memblock_t), requested, size,
+                  tag, file, line);
+
+    return (byte *)block + sizeof(memblock_t);
+}
+
+
+//
+// ArenaFree
+// Keeps a block from a level arena to be reused.
+//
+static void ArenaFree (memblock_t* block, const char *file, int line)
+{
+    arena_t*	arena;
+
+    Z_TraceFree((byte *)block + sizeof(memblock_t), file, line);
+
+    arena = &arenas[block->tag - PU_LEVEL];
+
+    block->tag = PU_FREE;
+    block->id = 0;
+
+    if (zero_on_free)
+    {
+        memset((byte *)block + sizeof(memblock_t), 0,
+               block->size - sizeof(memblock_t));
+    }
+
+    if (block->size <= ARENA_SMALL)
+    {
+        block->next = arena->bins[block->size / MEM_ALIGN];
+        arena->bins[block->size / MEM_ALIGN] = block;
+    }
+    else
+    {
+        block->next = arena->large;
+        arena->large = block;
+    }
+}
+
+
+//
+// Z_Free
+//
+void Z_Free2 (void* ptr, const char *file, int line)
+{
+    memblock_t*	block;
+
+    if (sizeclass_zone)
+    {
+        ZS_Free(ptr, file, line);
+        return;
+    }
+
+    block = (memblock_t *) ((byte *)ptr - sizeof(memblock_t));
+
+    if (block->id == ARENAID)
+    {
+        ArenaFree(block, file, line);
+        return;
+    }
+
+    Z_TraceFree(ptr, file, line);
+    FreeBlock(ptr);
+}
+
+
+
+//
+// Z_Malloc
+// You can pass a NULL user if the tag is < PU_PURGELEVEL.
+//
+void*
+Z_Malloc2
+( int		size,
+  int		tag,
+  void*		user,
+  const char*	file,
+  int		line )
+{
+    if (sizeclass_zone)
+    {
+        return ZS_Malloc(size, tag, user, file, line);
+    }
+
+    if (use_arenas && user == NULL && tag >= PU_LEVEL && tag < PU_PURGELEVEL
+     && size <= ARENA_MAX_BLOCK)
+    {
+        return ArenaMalloc(size, tag, file, line);
+    }
+
+    return ZoneMalloc(size, tag, user, file, line, false);
+}
+
+
+
+//
+// Z_EnablePurging
+// Purging is disabled while other threads may be reading from
+// purgable blocks, so that an allocation cannot free them.
+//
+void Z_EnablePurging(boolean enable)
+{
+    if (sizeclass_zone)
+    {
+        ZS_EnablePurging(enable);
+        return;
+    }
+
+    purge_enabled = enable;
+}
+
 
 //
 // Z_FreeTags
@@ -365,6 +642,22 @@ Z_FreeTags
 {
     memblock_t*	block;
     memblock_t*	next;
+    int		i;
+
+    if (sizeclass_zone)
+    {
+        ZS_FreeTags(lowtag, hightag);
+        return;
+    }
+
+    Z_TraceFreeTags(lowtag, hightag);
+
+    // The arena chunks are freed below, with the other blocks.
+    for (i = PU_LEVEL; i < PU_PURGELEVEL; ++i)
+    {
+        if (i >= lowtag && i <= hightag)
+            memset(&arenas[i - PU_LEVEL], 0, sizeof(arena_t));
+    }
 	
     for (block = mainzone->blocklist.next ;
 	 block != &mainzone->blocklist ;
@@ -378,7 +671,7 @@ Z_FreeTags
 	    continue;
 	
 	if (block->tag >= lowtag && block->tag <= hightag)
-	    Z_Free ( (byte *)block+sizeof(memblock_t));
+	    FreeBlock ( (byte *)block+sizeof(memblock_t));
     }
 }
 
@@ -394,6 +687,12 @@ Z_DumpHeap
   int		hightag )
 {
     memblock_t*	block;
+
+    if (sizeclass_zone)
+    {
+        ZS_DumpHeap(lowtag, hightag);
+        return;
+    }
 	
     printf ("zone size: %i  location: %p\n",
 	    mainzone->size,mainzone);
@@ -431,6 +730,12 @@ Z_DumpHeap
 void Z_FileDumpHeap (FILE* f)
 {
     memblock_t*	block;
+
+    if (sizeclass_zone)
+    {
+        ZS_FileDumpHeap(f);
+        return;
+    }
 	
     fprintf (f,"zone size: %i  location: %p\n",mainzone->size,mainzone);
 	
@@ -464,6 +769,12 @@ void Z_FileDumpHeap (FILE* f)
 void Z_CheckHeap (void)
 {
     memblock_t*	block;
+
+    if (sizeclass_zone)
+    {
+        ZS_CheckHeap();
+        return;
+    }
 	
     for (block = mainzone->blocklist.next ; ; block = block->next)
     {
@@ -493,9 +804,24 @@ void Z_CheckHeap (void)
 void Z_ChangeTag2(void *ptr, int tag, const char *file, int line)
 {
     memblock_t*	block;
+
+    if (sizeclass_zone)
+    {
+        ZS_ChangeTag2(ptr, tag, file, line);
+        return;
+    }
 	
     block = (memblock_t *) ((byte *)ptr - sizeof(memblock_t));
 
+    if (block->id == ARENAID)
+    {
+        // the block lives as long as its arena
+        if (tag != block->tag)
+            I_Error("%s:%i: Z_ChangeTag: can't change the tag of a "
+                    "block in a level arena", file, line);
+        return;
+    }
+
     if (block->id != ZONEID)
         I_Error("%s:%i: Z_ChangeTag: block without a ZONEID!",
                 file, line);
@@ -504,6 +830,7 @@ void Z_ChangeTag2(void *ptr, int tag, const char *file, int line)
         I_Error("%s:%i: Z_ChangeTag: an owner is required "
                 "for purgable blocks", file, line);
 
+    Z_TraceChangeTag(ptr, tag, file, line);
     block->tag = tag;
 }
 
@@ -511,6 +838,12 @@ void Z_ChangeUser(void *ptr, void **user)
 {
     memblock_t*	block;
 
+    if (sizeclass_zone)
+    {
+        ZS_ChangeUser(ptr, user);
+        return;
+    }
+
     block = (memblock_t *) ((byte *)ptr - sizeof(memblock_t));
 
     if (block->id != ZONEID)
@@ -531,6 +864,11 @@ int Z_FreeMemory (void)
 {
     memblock_t*		block;
     int			free;
+
+    if (sizeclass_zone)
+    {
+        return ZS_FreeMemory();
+    }
 	
     free = 0;
     
@@ -547,6 +885,11 @@ int Z_FreeMemory (void)
 
 unsigned int Z_ZoneSize(void)
 {
+    if (sizeclass_zone)
+    {
+        return ZS_ZoneSize();
+    }
+
     return mainzone->size;
 }
 
@@ -26,6 +26,8 @@
 
 #include <stdio.h>
 
+#include "doomtype.h"
+
 //
 // ZONE MEMORY
 // PU - purge tags.
@@ -51,9 +53,10 @@ enum
         
 
 void	Z_Init (void);
-void*	Z_Malloc (int size, int tag, void *ptr);
-void    Z_Free (void *ptr);
+void*	Z_Malloc2 (int size, int tag, void *ptr, const char *file, int line);
+void    Z_Free2 (void *ptr, const char *file, int line);
 void    Z_FreeTags (int lowtag, int hightag);
+void    Z_EnablePurging (boolean enable);
 void    Z_DumpHeap (int lowtag, int hightag);
 void    Z_FileDumpHeap (FILE *f);
 void    Z_CheckHeap (void);
@@ -66,6 +69,12 @@ unsigned int Z_ZoneSize(void);
 // This is used to get the local FILE:LINE info from CPP
 // prior to really call the function in question.
 //
+#define Z_Malloc(s,t,p)                                        \
+    Z_Malloc2((s), (t), (p), __FILE__, __LINE__)
+
+#define Z_Free(p)                                              \
+    Z_Free2((p), __FILE__, __LINE__)
+
 #define Z_ChangeTag(p,t)                                       \
     Z_ChangeTag2((p), (t), __FILE__, __LINE__)
 
@@ -0,0 +1,342 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Zone allocator benchmark.  Replays a trace recorded with
+//      -zonetrace against the default zone allocator and the size
+//      class allocator, and reports how long allocations took.
+//
+//      Purges in the trace are not replayed: each allocator purges
+//      blocks when it needs to.  If a block was purged in the replay
+//      but not in the recorded game, it is allocated again the next
+//      time its tag is changed, as the game would when loading a lump
+//      that is no longer in the cache.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SDL.h"
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "m_argv.h"
+
+#include "z_zone.h"
+#include "z_sizeclass.h"
+#include "z_trace.h"
+
+// A trace event, with blocks numbered in the order they were
+// allocated rather than by address.
+
+typedef struct
+{
+    ztraceop_t op;
+    int block;
+    int size;
+    int tag;
+    int hightag;
+} benchop_t;
+
+typedef struct
+{
+    const char *name;
+    void (*init)(void);
+    void *(*zmalloc)(int size, int tag, void *user,
+                     const char *file, int line);
+    void (*zfree)(void *ptr, const char *file, int line);
+    void (*freetags)(int lowtag, int hightag);
+    void (*changetag)(void *ptr, int tag, const char *file, int line);
+    int (*freememory)(void);
+} backend_t;
+
+static const backend_t backends[] =
+{
+    { "zone", Z_Init, Z_Malloc2, Z_Free2, Z_FreeTags, Z_ChangeTag2,
+      Z_FreeMemory },
+    { "sizeclass", ZS_Init, ZS_Malloc, ZS_Free, ZS_FreeTags, ZS_ChangeTag2,
+      ZS_FreeMemory },
+};
+
+static benchop_t *ops = NULL;
+static int num_ops = 0;
+static int num_blocks = 0;
+static int num_mallocs = 0;
+
+// Size of each block, for allocating it again.
+static int *block_sizes = NULL;
+
+// Hash table from recorded address to the block last allocated there.
+
+static uint64_t *hash_keys = NULL;
+static int *hash_blocks = NULL;
+static int hash_size = 0;
+static int hash_count = 0;
+
+static int *HashEntry(uint64_t key)
+{
+    unsigned int i;
+
+    i = (unsigned int) ((key >> 4) * 2654435761u) & (hash_size - 1);
+
+    while (hash_blocks[i] >= 0 && hash_keys[i] != key)
+    {
+        i = (i + 1) & (hash_size - 1);
+    }
+
+    hash_keys[i] = key;
+
+    return &hash_blocks[i];
+}
+
+static void ResizeHash(void)
+{
+    uint64_t *old_keys = hash_keys;
+    int *old_blocks = hash_blocks;
+    int old_size = hash_size;
+    int i;
+
+    hash_size = hash_size == 0 ? 4096 : hash_size * 2;
+    hash_keys = malloc(hash_size * sizeof(uint64_t));
+    hash_blocks = malloc(hash_size * sizeof(int));
+
+    if (hash_keys == NULL || hash_blocks == NULL)
+    {
+        I_Error("ResizeHash: Out of memory");
+    }
+
+    for (i = 0; i < hash_size; ++i)
+    {
+        hash_blocks[i] = -1;
+    }
+
+    for (i = 0; i < old_size; ++i)
+    {
+        if (old_blocks[i] >= 0)
+        {
+            *HashEntry(old_keys[i]) = old_blocks[i];
+        }
+    }
+
+    free(old_keys);
+    free(old_blocks);
+}
+
+// Returns -1 if nothing was allocated at the given address.
+
+static int LookupBlock(uint64_t ptr)
+{
+    return *HashEntry(ptr);
+}
+
+static void LoadTrace(const char *filename)
+{
+    FILE *stream;
+    ztracerecord_t record;
+    benchop_t *op;
+    int max_ops = 0;
+    int max_blocks = 0;
+    int *entry;
+
+    stream = Z_OpenTrace(filename);
+    ResizeHash();
+
+    while (Z_ReadTraceRecord(stream, &record))
+    {
+        if (num_ops == max_ops)
+        {
+            max_ops = max_ops == 0 ? 65536 : max_ops * 2;
+            ops = I_Realloc(ops, max_ops * sizeof(benchop_t));
+        }
+
+        // Only events that change the heap are replayed.
+        if (record.op == ZT_ZONE || record.op == ZT_FAILED)
+        {
+            continue;
+        }
+
+        op = &ops[num_ops];
+        op->op = record.op;
+        op->size = record.size;
+        op->tag = record.tag;
+        op->hightag = record.hightag;
+        op->block = -1;
+
+        if (record.op == ZT_MALLOC)
+        {
+            if (hash_count * 2 >= hash_size)
+            {
+                ResizeHash();
+            }
+
+            entry = HashEntry(record.ptr);
+
+            if (*entry < 0)
+            {
+                ++hash_count;
+            }
+
+            if (num_blocks == max_blocks)
+            {
+                max_blocks = max_blocks == 0 ? 65536 : max_blocks * 2;
+                block_sizes = I_Realloc(block_sizes, max_blocks * sizeof(int));
+            }
+
+            *entry = num_blocks;
+            block_sizes[num_blocks] = record.size;
+            op->block = num_blocks;
+            ++num_blocks;
+            ++num_mallocs;
+        }
+        else if (record.op != ZT_FREETAGS)
+        {
+            op->block = LookupBlock(record.ptr);
+
+            if (op->block < 0)
+            {
+                continue;
+            }
+        }
+
+        ++num_ops;
+    }
+
+    fclose(stream);
+}
+
+static int CompareTimes(const void *a, const void *b)
+{
+    uint64_t ta = *(const uint64_t *) a;
+    uint64_t tb = *(const uint64_t *) b;
+
+    return ta < tb ? -1 : ta > tb;
+}
+
+static void Replay(const backend_t *backend)
+{
+    void **users;
+    uint64_t *times;
+    uint64_t start, end, t;
+    double ns_per_tick;
+    int reloaded = 0;
+    int n = 0;
+    benchop_t *op;
+    int i;
+
+    users = calloc(num_blocks, sizeof(void *));
+    times = malloc(num_ops * sizeof(uint64_t) + 1);
+
+    if (users == NULL || times == NULL)
+    {
+        I_Error("Replay: Out of memory");
+    }
+
+    ns_per_tick = 1e9 / SDL_GetPerformanceFrequency();
+
+    backend->init();
+
+    start = SDL_GetPerformanceCounter();
+
+    for (i = 0; i < num_ops; ++i)
+    {
+        op = &ops[i];
+
+        switch (op->op)
+        {
+            case ZT_MALLOC:
+                t = SDL_GetPerformanceCounter();
+                backend->zmalloc(op->size, op->tag, &users[op->block],
+                                 __FILE__, __LINE__);
+                times[n++] = SDL_GetPerformanceCounter() - t;
+                break;
+
+            case ZT_FREE:
+                if (users[op->block] != NULL)
+                {
+                    backend->zfree(users[op->block], __FILE__, __LINE__);
+                }
+                break;
+
+            case ZT_CHANGETAG:
+                if (users[op->block] != NULL)
+                {
+                    backend->changetag(users[op->block], op->tag,
+                                       __FILE__, __LINE__);
+                }
+                else
+                {
+                    t = SDL_GetPerformanceCounter();
+                    backend->zmalloc(block_sizes[op->block], op->tag,
+                                     &users[op->block], __FILE__, __LINE__);
+                    times[n++] = SDL_GetPerformanceCounter() - t;
+                    ++reloaded;
+                }
+                break;
+
+            case ZT_FREETAGS:
+                backend->freetags(op->tag, op->hightag);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    end = SDL_GetPerformanceCounter();
+
+    qsort(times, n, sizeof(uint64_t), CompareTimes);
+
+    t = 0;
+
+    for (i = 0; i < n; ++i)
+    {
+        t += times[i];
+    }
+
+    printf("%-10s %9.2f ms total, Z_Malloc mean %7.0f ns, "
+           "99%% %7.0f ns, max %9.0f ns\n",
+           backend->name, (end - start) * ns_per_tick / 1e6,
+           n > 0 ? (double) t / n * ns_per_tick : 0,
+           n > 0 ? times[(n * 99) / 100] * ns_per_tick : 0,
+           n > 0 ? times[n - 1] * ns_per_tick : 0);
+    printf("%-10s %i purged blocks allocated again, %i bytes free or "
+           "purgable at end\n", "", reloaded, backend->freememory());
+
+    free(users);
+    free(times);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int i;
+
+    myargc = argc;
+    myargv = argv;
+
+    if (argc < 2)
+    {
+        printf("Usage: %s [-mb <mb>] <trace file>\n", argv[0]);
+        exit(-1);
+    }
+
+    LoadTrace(argv[argc - 1]);
+
+    printf("%i operations, %i allocations\n", num_ops, num_mallocs);
+
+    for (i = 0; i < arrlen(backends); ++i)
+    {
+        Replay(&backends[i]);
+    }
+
+    return 0;
+}
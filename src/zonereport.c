@@ -0,0 +1,613 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Zone trace report.  Reads a trace recorded with -zonetrace
+//      and prints the peak memory used by each tag, how fragmented
+//      the zone was over time, and which source lines allocated the
+//      most memory.
+//
+//      The heap is rebuilt from the addresses and sizes in the trace,
+//      so the report describes the allocator the trace was recorded
+//      with.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_misc.h"
+
+#include "z_zone.h"
+#include "z_trace.h"
+
+// A block that is currently allocated.
+
+typedef struct
+{
+    uint64_t ptr;
+    int blocksize;
+    int tag;
+    int site;
+} liveblock_t;
+
+// A source line that allocates memory.
+
+typedef struct
+{
+    const char *file;
+    int line;
+    int count;
+    int64_t bytes;
+    int64_t live;
+    int64_t peak;
+} site_t;
+
+static const char *tag_names[PU_NUM_TAGS] =
+{
+    "?", "PU_STATIC", "PU_SOUND", "PU_MUSIC", "PU_FREE", "PU_LEVEL",
+    "PU_LEVSPEC", "PU_PURGELEVEL", "PU_CACHE",
+};
+
+static uint64_t zone_base = 0;
+static int zone_size = 0;
+static int header_size = 0;
+
+static liveblock_t *blocks = NULL;
+static int num_blocks = 0;
+static int max_blocks = 0;
+
+// Hash table from address to index in blocks[], or -1.
+static uint64_t *hash_keys = NULL;
+static int *hash_values = NULL;
+static int hash_size = 0;
+
+static site_t *sites = NULL;
+static int num_sites = 0;
+static int max_sites = 0;
+
+static int64_t live_bytes[PU_NUM_TAGS];
+static int64_t peak_bytes[PU_NUM_TAGS];
+static int64_t peak_total = 0;
+
+static long num_events = 0;
+static long num_purges = 0;
+static int min_largest_free = -1;
+
+static unsigned int HashIndex(uint64_t key)
+{
+    return (unsigned int) ((key >> 4) * 2654435761u) & (hash_size - 1);
+}
+
+// Returns the slot holding the key, or the empty slot where it would go.
+
+static unsigned int HashFind(uint64_t key)
+{
+    unsigned int i = HashIndex(key);
+
+    while (hash_values[i] >= 0 && hash_keys[i] != key)
+    {
+        i = (i + 1) & (hash_size - 1);
+    }
+
+    return i;
+}
+
+static void HashRemove(uint64_t key)
+{
+    unsigned int i, j, k;
+
+    i = HashFind(key);
+
+    if (hash_values[i] < 0)
+    {
+        return;
+    }
+
+    // Move later entries back into the gap, so that searches through
+    // the slot still find them.
+    j = i;
+
+    for (;;)
+    {
+        hash_values[i] = -1;
+
+        do
+        {
+            j = (j + 1) & (hash_size - 1);
+
+            if (hash_values[j] < 0)
+            {
+                return;
+            }
+
+            k = HashIndex(hash_keys[j]);
+        } while (i <= j ? (i < k && k <= j) : (i < k || k <= j));
+
+        hash_keys[i] = hash_keys[j];
+        hash_values[i] = hash_values[j];
+        i = j;
+    }
+}
+
+static void RebuildHash(int size)
+{
+    int i;
+
+    hash_size = size;
+    free(hash_keys);
+    free(hash_values);
+    hash_keys = malloc(hash_size * sizeof(uint64_t));
+    hash_values = malloc(hash_size * sizeof(int));
+
+    if (hash_keys == NULL || hash_values == NULL)
+    {
+        I_Error("RebuildHash: Out of memory");
+    }
+
+    for (i = 0; i < hash_size; ++i)
+    {
+        hash_values[i] = -1;
+    }
+
+    for (i = 0; i < num_blocks; ++i)
+    {
+        unsigned int slot = HashFind(blocks[i].ptr);
+
+        hash_keys[slot] = blocks[i].ptr;
+        hash_values[slot] = i;
+    }
+}
+
+static liveblock_t *FindBlock(uint64_t ptr)
+{
+    int i = hash_values[HashFind(ptr)];
+
+    return i < 0 ? NULL : &blocks[i];
+}
+
+static int FindSite(const char *file, int line)
+{
+    int i;
+
+    // Most allocations come from the same few lines as the last one,
+    // so search backwards.
+    for (i = num_sites - 1; i >= 0; --i)
+    {
+        if (sites[i].line == line && sites[i].file == file)
+        {
+            return i;
+        }
+    }
+
+    if (num_sites == max_sites)
+    {
+        max_sites = max_sites == 0 ? 256 : max_sites * 2;
+        sites = I_Realloc(sites, max_sites * sizeof(site_t));
+    }
+
+    sites[num_sites].file = file;
+    sites[num_sites].line = line;
+    sites[num_sites].count = 0;
+    sites[num_sites].bytes = 0;
+    sites[num_sites].live = 0;
+    sites[num_sites].peak = 0;
+
+    return num_sites++;
+}
+
+static int ValidTag(int tag)
+{
+    return tag > 0 && tag < PU_NUM_TAGS ? tag : 0;
+}
+
+static void UpdatePeaks(liveblock_t *block)
+{
+    int64_t total = 0;
+    int i;
+
+    for (i = 0; i < PU_NUM_TAGS; ++i)
+    {
+        if (live_bytes[i] > peak_bytes[i])
+        {
+            peak_bytes[i] = live_bytes[i];
+        }
+
+        total += live_bytes[i];
+    }
+
+    if (total > peak_total)
+    {
+        peak_total = total;
+    }
+
+    if (block != NULL && sites[block->site].live > sites[block->site].peak)
+    {
+        sites[block->site].peak = sites[block->site].live;
+    }
+}
+
+static void AddBlock(ztracerecord_t *record)
+{
+    liveblock_t *block;
+    unsigned int slot;
+
+    // A block at the same address must have been freed by an event
+    // missing from the trace; forget it.
+    if (FindBlock(record->ptr) != NULL)
+    {
+        fprintf(stderr, "Block at %#llx allocated twice\n",
+                (unsigned long long) record->ptr);
+        return;
+    }
+
+    if (num_blocks == max_blocks)
+    {
+        max_blocks = max_blocks == 0 ? 4096 : max_blocks * 2;
+        blocks = I_Realloc(blocks, max_blocks * sizeof(liveblock_t));
+    }
+
+    if (num_blocks * 2 >= hash_size)
+    {
+        RebuildHash(hash_size * 2);
+    }
+
+    block = &blocks[num_blocks];
+    block->ptr = record->ptr;
+    block->blocksize = record->blocksize;
+    block->tag = ValidTag(record->tag);
+    block->site = FindSite(record->file, record->line);
+
+    slot = HashFind(record->ptr);
+    hash_keys[slot] = record->ptr;
+    hash_values[slot] = num_blocks;
+    ++num_blocks;
+
+    sites[block->site].count++;
+    sites[block->site].bytes += block->blocksize;
+    sites[block->site].live += block->blocksize;
+    live_bytes[block->tag] += block->blocksize;
+
+    UpdatePeaks(block);
+}
+
+static void RemoveBlock(liveblock_t *block)
+{
+    liveblock_t *last;
+    int i;
+
+    live_bytes[block->tag] -= block->blocksize;
+    sites[block->site].live -= block->blocksize;
+
+    HashRemove(block->ptr);
+
+    // Move the last block into the gap.
+    last = &blocks[num_blocks - 1];
+
+    if (block != last)
+    {
+        *block = *last;
+        i = HashFind(block->ptr);
+        hash_values[i] = block - blocks;
+    }
+
+    --num_blocks;
+}
+
+static void FreeTags(int lowtag, int hightag)
+{
+    int i = 0;
+
+    while (i < num_blocks)
+    {
+        if (blocks[i].tag >= lowtag && blocks[i].tag <= hightag)
+        {
+            RemoveBlock(&blocks[i]);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+static int CompareBlocks(const void *a, const void *b)
+{
+    const liveblock_t *ba = a, *bb = b;
+
+    return ba->ptr < bb->ptr ? -1 : ba->ptr > bb->ptr;
+}
+
+// Walk the heap in address order and find the free space, and the
+// largest run of memory that is free or could be made free by purging.
+
+static void MeasureHeap(int *largest_free, int *largest_purgable)
+{
+    uint64_t pos, start, run_start;
+    int i;
+
+    qsort(blocks, num_blocks, sizeof(liveblock_t), CompareBlocks);
+    RebuildHash(hash_size);
+
+    *largest_free = 0;
+    *largest_purgable = 0;
+
+    pos = zone_base;
+    run_start = zone_base;
+
+    for (i = 0; i <= num_blocks; ++i)
+    {
+        if (i < num_blocks)
+        {
+            start = blocks[i].ptr - header_size;
+        }
+        else
+        {
+            start = zone_base + zone_size;
+        }
+
+        if (start > pos && start - pos > *largest_free)
+        {
+            *largest_free = start - pos;
+        }
+
+        if (i < num_blocks && blocks[i].tag < PU_PURGELEVEL)
+        {
+            if (start > run_start && start - run_start > *largest_purgable)
+            {
+                *largest_purgable = start - run_start;
+            }
+
+            run_start = start + blocks[i].blocksize;
+        }
+        else if (i == num_blocks && start - run_start > *largest_purgable)
+        {
+            *largest_purgable = start - run_start;
+        }
+
+        if (i < num_blocks)
+        {
+            pos = start + blocks[i].blocksize;
+        }
+    }
+}
+
+static void PrintSampleHeader(void)
+{
+    printf("%10s %10s %10s %10s %12s %12s %6s\n",
+           "event", "live", "purgable", "free", "largest free",
+           "+ purgable", "frag");
+}
+
+static void PrintSample(void)
+{
+    int64_t live = 0, purgable = 0, free_bytes;
+    int largest_free, largest_purgable;
+    int i;
+
+    if (zone_size == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < PU_NUM_TAGS; ++i)
+    {
+        if (i >= PU_PURGELEVEL)
+        {
+            purgable += live_bytes[i];
+        }
+        else
+        {
+            live += live_bytes[i];
+        }
+    }
+
+    free_bytes = zone_size - live - purgable;
+
+    MeasureHeap(&largest_free, &largest_purgable);
+
+    if (min_largest_free < 0 || largest_free < min_largest_free)
+    {
+        min_largest_free = largest_free;
+    }
+
+    // Fragmentation is the share of free memory that is not in the
+    // largest free block.
+    printf("%10li %10lli %10lli %10lli %12i %12i %5.1f%%\n",
+           num_events, (long long) live, (long long) purgable,
+           (long long) free_bytes, largest_free, largest_purgable,
+           free_bytes > 0 ? 100.0 * (free_bytes - largest_free) / free_bytes
+                          : 0.0);
+}
+
+static int CompareSites(const void *a, const void *b)
+{
+    const site_t *sa = a, *sb = b;
+
+    return sa->peak < sb->peak ? 1 : sa->peak > sb->peak ? -1 : 0;
+}
+
+static void PrintSummary(int max_sites_shown)
+{
+    int i;
+
+    printf("\nPeak bytes by tag:\n");
+    printf("%-14s %12s %12s\n", "tag", "peak", "at end");
+
+    for (i = 1; i < PU_NUM_TAGS; ++i)
+    {
+        if (i != PU_FREE)
+        {
+            printf("%-14s %12lli %12lli\n", tag_names[i],
+                   (long long) peak_bytes[i], (long long) live_bytes[i]);
+        }
+    }
+
+    printf("%-14s %12lli\n", "total", (long long) peak_total);
+
+    if (zone_size > 0)
+    {
+        printf("\nZone size %i bytes, %li blocks purged, smallest largest "
+               "free block %i bytes\n", zone_size, num_purges,
+               min_largest_free);
+    }
+
+    qsort(sites, num_sites, sizeof(site_t), CompareSites);
+
+    printf("\nSource lines by peak live bytes:\n");
+    printf("%-32s %10s %12s %12s %12s\n",
+           "caller", "count", "total bytes", "peak live", "live at end");
+
+    for (i = 0; i < num_sites && i < max_sites_shown; ++i)
+    {
+        char caller[64];
+
+        M_snprintf(caller, sizeof(caller), "%s:%i",
+                   sites[i].file, sites[i].line);
+        printf("%-32s %10i %12lli %12lli %12lli\n", caller,
+               sites[i].count, (long long) sites[i].bytes,
+               (long long) sites[i].peak, (long long) sites[i].live);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ztracerecord_t record;
+    liveblock_t *block;
+    FILE *stream;
+    long interval;
+    int max_sites_shown;
+    int p;
+
+    myargc = argc;
+    myargv = argv;
+
+    if (argc < 2)
+    {
+        printf("Usage: %s [-interval <events>] [-sites <n>] "
+               "<trace file>\n", argv[0]);
+        exit(-1);
+    }
+
+    //!
+    // @arg <events>
+    //
+    // Print the state of the heap every this many events, as well as
+    // at each Z_FreeTags call.
+    //
+
+    interval = 100000;
+    p = M_CheckParmWithArgs("-interval", 1);
+
+    if (p > 0)
+    {
+        interval = atol(myargv[p + 1]);
+    }
+
+    //!
+    // @arg <n>
+    //
+    // Show this many source lines in the list of allocating lines.
+    //
+
+    max_sites_shown = 30;
+    p = M_CheckParmWithArgs("-sites", 1);
+
+    if (p > 0)
+    {
+        max_sites_shown = atoi(myargv[p + 1]);
+    }
+
+    stream = Z_OpenTrace(argv[argc - 1]);
+    RebuildHash(4096);
+
+    PrintSampleHeader();
+
+    while (Z_ReadTraceRecord(stream, &record))
+    {
+        ++num_events;
+
+        switch (record.op)
+        {
+            case ZT_ZONE:
+                // The zone was set up again: start from an empty heap.
+                FreeTags(0, PU_NUM_TAGS);
+                zone_base = record.ptr;
+                zone_size = record.size;
+                header_size = record.headersize;
+                break;
+
+            case ZT_MALLOC:
+                AddBlock(&record);
+                break;
+
+            case ZT_FREE:
+            case ZT_PURGE:
+                block = FindBlock(record.ptr);
+
+                if (block != NULL)
+                {
+                    RemoveBlock(block);
+                }
+
+                if (record.op == ZT_PURGE)
+                {
+                    ++num_purges;
+                }
+                break;
+
+            case ZT_CHANGETAG:
+                block = FindBlock(record.ptr);
+
+                if (block != NULL)
+                {
+                    live_bytes[block->tag] -= block->blocksize;
+                    block->tag = ValidTag(record.tag);
+                    live_bytes[block->tag] += block->blocksize;
+                    UpdatePeaks(NULL);
+                }
+                break;
+
+            case ZT_FREETAGS:
+                // Sample before a level's memory is freed, when the
+                // heap is at its fullest.
+                PrintSample();
+                FreeTags(record.tag, record.hightag);
+                break;
+
+            case ZT_FAILED:
+                PrintSample();
+                printf("\n%s:%i: allocation of %i bytes with tag %s "
+                       "failed\n", record.file, record.line, record.size,
+                       tag_names[ValidTag(record.tag)]);
+                break;
+
+            default:
+                break;
+        }
+
+        if (interval > 0 && num_events % interval == 0)
+        {
+            PrintSample();
+        }
+    }
+
+    fclose(stream);
+
+    PrintSample();
+    PrintSummary(max_sites_shown);
+
+    return 0;
+}
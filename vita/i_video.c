@@ -35,6 +35,7 @@
 #include "m_argv.h"
 #include "m_config.h"
 #include "m_misc.h"
+#include "m_profile.h"
 #include "tables.h"
 #include "v_diskicon.h"
 #include "v_video.h"
@@ -185,6 +186,11 @@ pixel_t *I_VideoBuffer = NULL;
 
 boolean screensaver_mode = false;
 
+// Offscreen rendering (-offscreen) is not supported here, but the
+// flag is shared with i_endoom.c.
+
+boolean offscreen_mode = false;
+
 // Flag indicating whether the screen is currently visible:
 // when the screen isnt visible, don't render the screen
 
@@ -688,6 +694,7 @@ void I_FinishUpdate (void)
 
     // Draw disk icon before blit, if necessary.
     V_DrawDiskIcon();
+    M_DrawProfileGraph();
 
     if (palette_to_set)
     {
@@ -725,6 +732,7 @@ void I_FinishUpdate (void)
 
     // Restore background and undo the disk indicator, if it was drawn.
     V_RestoreDiskBackground();
+    M_RestoreProfileBackground();
 }
 
 